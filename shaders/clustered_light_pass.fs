@@ -0,0 +1,105 @@
+#version 330
+
+#include "g_buffer_read.glsl"
+
+uniform vec2 u_screen_size;
+uniform vec3 u_cam_pos;
+uniform vec3 u_cam_direction;
+
+//clusters, screen tiles x exponential depth slices
+uniform ivec3 u_cluster_grid;
+uniform vec2 u_cluster_depth; // x : near clip, y : slices per log unit of depth
+uniform usamplerBuffer u_cluster_lists; // offset and count into u_light_indices for every cluster
+uniform usamplerBuffer u_light_indices;
+
+//9 texels per light : position & radius, color & type, attenuation & correction, spot direction & cos angle, shadow tile, shadow matrix
+uniform samplerBuffer u_light_data;
+
+#include "spot_shadow.glsl"
+
+layout (location = 5) out vec4 o_light_color;
+
+float calc_spot_shadow(int base, vec3 position)
+{
+	vec4 shadow_tile = texelFetch(u_light_data, base + 4);
+	if(shadow_tile.z <= 0.0)
+	{
+		return 1.0;
+	}
+
+	mat4 light_pv = mat4(texelFetch(u_light_data, base + 5), texelFetch(u_light_data, base + 6), texelFetch(u_light_data, base + 7), texelFetch(u_light_data, base + 8));
+	return calc_spot_shadow_factor(position, light_pv, shadow_tile);
+}
+
+void main()
+{	
+#ifdef RESOLUTION_SCALE
+	//a low resolution pixel is shaded for the first pixel of its block, see LowResolutionLightBuffer
+	vec2 geo_texcoord = (floor(gl_FragCoord.xy) * float(RESOLUTION_SCALE) + 0.5) / u_screen_size;
+#else
+	vec2 geo_texcoord = gl_FragCoord.xy / u_screen_size;
+#endif
+
+	//nothing was drawn on the background
+	if(texture(u_g_depth, geo_texcoord).x == 1.0)
+	{
+		discard;
+	}
+
+	vec3 position = read_position(geo_texcoord);	
+	vec3 normal = read_normal(geo_texcoord);
+	vec3 albedo = texture2D(u_g_diffuse, geo_texcoord).rgb;
+	vec3 specular = texture(u_g_specular, geo_texcoord).rgb;
+	float specular_power = read_specular_power(geo_texcoord);
+	vec3 to_eye = normalize(u_cam_pos - position);
+
+	//find the cluster of this pixel
+	float view_depth = dot(position - u_cam_pos, u_cam_direction);
+	int slice = int(log(max(view_depth, u_cluster_depth.x) / u_cluster_depth.x) * u_cluster_depth.y);
+	ivec2 tile = ivec2(geo_texcoord * vec2(u_cluster_grid.xy));
+	if(slice >= u_cluster_grid.z)
+	{
+		discard;
+	}
+	int cluster = (slice * u_cluster_grid.y + tile.y) * u_cluster_grid.x + tile.x;
+	uvec2 cluster_list = texelFetch(u_cluster_lists, cluster).xy;
+
+	vec3 light_color = vec3(0.0);
+	for(uint i = 0u; i < cluster_list.y; i++)
+	{
+		int base = int(texelFetch(u_light_indices, int(cluster_list.x + i)).x) * 9;
+		vec4 position_radius = texelFetch(u_light_data, base);
+		vec4 color_type = texelFetch(u_light_data, base + 1);
+		vec4 attenuation_correction = texelFetch(u_light_data, base + 2);
+
+		vec3 light_dir = position - position_radius.xyz;
+		float distance = length(light_dir);
+		if(distance > position_radius.w)
+		{
+			continue;
+		}
+
+		float attenuation = max(1.0, attenuation_correction.x + attenuation_correction.y * distance + attenuation_correction.z * distance * distance);
+		vec3 reflection = normalize(reflect(light_dir, normal));
+		float diffuse_factor = max(dot(-normalize(light_dir), normal), 0.0);
+		float specular_factor = pow(max(dot(to_eye, reflection), 0.0001), specular_power); // pow(0, 0) is undefined
+
+		if(color_type.w == 0.0)
+		{
+			//point light, same as point_light_pass.fs
+			light_color += (albedo * diffuse_factor + specular * specular_factor) * color_type.rgb / attenuation;
+		}
+		else
+		{
+			//spot light, same as spot_light_pass.fs. there is no cone volume here, so the pixel has to be tested against the cone
+			vec4 direction_angle = texelFetch(u_light_data, base + 3);
+			if(dot(light_dir / distance, direction_angle.xyz) < direction_angle.w)
+			{
+				continue;
+			}
+			light_color += (diffuse_factor + specular_factor) * color_type.rgb * attenuation_correction.w * calc_spot_shadow(base, position) / attenuation;
+		}
+	}
+
+	o_light_color = vec4(light_color, 1.0);
+}
@@ -15,6 +15,5 @@ uniform mat4 u_proj_view;
 
 void main()
 {
-	v_posW = (u_world * vec4(a_posL, 1.0)).xyz;
-	gl_Position = (u_proj_view * vec4(v_posW, 1.0));
+	gl_Position = vec4(a_posL, 1.0);
 }
\ No newline at end of file
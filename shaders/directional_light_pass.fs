@@ -1,10 +1,6 @@
 #version 330
 
-//geometry buffer
-uniform sampler2D u_g_position;
-uniform sampler2D u_g_diffuse;
-uniform sampler2D u_g_normal;
-uniform sampler2D u_g_specular;
+#include "g_buffer_read.glsl"
 
 uniform vec2 u_screen_size;
 uniform vec3 u_cam_pos;
@@ -15,18 +11,22 @@ uniform vec3 u_light_color;
 
 layout (location = 5) out vec4 o_light_color;
 
-//shadow calculation
+//shadow calculation, the sun shadow is split into cascades that share one texture
 uniform sampler2D u_shadow_map;
-uniform mat4 u_light_pv; // light projection matrix
+uniform int u_num_cascades;
+uniform mat4 u_cascade_pv[4]; // light projection matrix of each cascade
+uniform vec4 u_cascade_tiles[4]; // xy : uv offset, zw : uv scale of each cascade's tile
+uniform vec4 u_cascade_splits; // view depth where each cascade ends
+uniform vec3 u_cam_direction;
 
 void main()
 {	
 	vec2 geo_texcoord = gl_FragCoord.xy / u_screen_size;	
-	vec3 position = texture2D(u_g_position, geo_texcoord).rgb;
-	vec3 normal = texture(u_g_normal, geo_texcoord).rgb;
+	vec3 position = read_position(geo_texcoord);
+	vec3 normal = read_normal(geo_texcoord);
 	vec3 diffuse_color = texture2D(u_g_diffuse, geo_texcoord).rgb;
 	vec3 specular_color = texture(u_g_specular, geo_texcoord).rgb;
-	float specular_power = texture(u_g_specular, geo_texcoord).a;
+	float specular_power = read_specular_power(geo_texcoord);
 	
 	vec3 to_eye = normalize(u_cam_pos - position);
 	vec3 reflection = normalize(reflect(u_light_direction, normal));	
@@ -35,27 +35,39 @@ void main()
 	diffuse_color = diffuse_color * u_light_color * max(dot(-normalize(u_light_direction), normal), 0.0);
 	
 	//specular
-	float specular_factor = max(dot(to_eye, reflection), 0.0);
+	float specular_factor = max(dot(to_eye, reflection), 0.0001); // pow(0, 0) is undefined, and gives NaN on pixels with a specular power of 0 (e.g. the background)
 	specular_factor = pow(specular_factor, specular_power);
 	specular_color = specular_color * u_light_color * specular_factor;
 	
-	//convert v_light_space_pos to NDC
-	vec4 v_light_space_pos = u_light_pv * vec4(position, 1.0);
-	vec3 ndc_pos = v_light_space_pos.xyz / v_light_space_pos.w;
-	
-	//convert ndc pos [-1, 1] to texcoord space [0, 1]
-	vec2 shadow_map_uv;
-	shadow_map_uv.x = 0.5 * ndc_pos.x + 0.5;
-	shadow_map_uv.y = 0.5 * ndc_pos.y + 0.5;
-	float z = 0.5 * ndc_pos.z + 0.5;
-	float shadow_map_depth = texture(u_shadow_map, shadow_map_uv).x;
+	//pick the first cascade that reaches this pixel's view depth, pixels past the last one are not shadowed
+	float view_depth = dot(position - u_cam_pos, u_cam_direction);
+	int cascade = 0;
+	while(cascade < u_num_cascades && view_depth > u_cascade_splits[cascade])
+	{
+		cascade++;
+	}
 	
-	//compare z and shadow_map_depth, z is the actual pixel depth, and shadow_map_depth contains the nearest depth to the light source
 	float shadow_factor = 1.0;
-	float bias = 0.001;
-	if(shadow_map_depth < z - bias )
+	if(cascade < u_num_cascades)
 	{
-		shadow_factor = 0.1;
+		//convert v_light_space_pos to NDC
+		vec4 v_light_space_pos = u_cascade_pv[cascade] * vec4(position, 1.0);
+		vec3 ndc_pos = v_light_space_pos.xyz / v_light_space_pos.w;
+		
+		//convert ndc pos [-1, 1] to texcoord space [0, 1], then into the cascade's tile
+		vec2 shadow_map_uv;
+		shadow_map_uv.x = 0.5 * ndc_pos.x + 0.5;
+		shadow_map_uv.y = 0.5 * ndc_pos.y + 0.5;
+		shadow_map_uv = u_cascade_tiles[cascade].xy + clamp(shadow_map_uv, 0.0, 1.0) * u_cascade_tiles[cascade].zw;
+		float z = 0.5 * ndc_pos.z + 0.5;
+		float shadow_map_depth = texture(u_shadow_map, shadow_map_uv).x;
+		
+		//compare z and shadow_map_depth, z is the actual pixel depth, and shadow_map_depth contains the nearest depth to the light source
+		float bias = 0.001;
+		if(shadow_map_depth < z - bias )
+		{
+			shadow_factor = 0.1;
+		}
 	}
 	
 	//o_light_color = vec4(specular_color + diffuse_color, 1.0);
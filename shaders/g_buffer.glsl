@@ -0,0 +1,32 @@
+//how the compact geometry buffer packs the normal and the specular power, for the shaders that write it and the ones that read it
+
+//octahedral normal encoding, the unit sphere is folded onto a square in [0, 1]
+vec2 encode_normal(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	if(n.z < 0.0)
+	{
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return n.xy * 0.5 + 0.5;
+}
+
+vec3 decode_normal(vec2 encoded_normal)
+{
+	vec2 f = encoded_normal * 2.0 - 1.0;
+	vec3 n = vec3(f, 1.0 - abs(f.x) - abs(f.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+//specular power in 8 bits, log encoded. 0 stays 0, [1, 1024] is mapped to (0, 1]
+float encode_specular_power(float specular_power)
+{
+	return specular_power <= 0.0 ? 0.0 : (log2(clamp(specular_power, 1.0, 1024.0)) + 1.0) / 11.0;
+}
+
+float decode_specular_power(float encoded_specular_power)
+{
+	return encoded_specular_power == 0.0 ? 0.0 : exp2(encoded_specular_power * 11.0 - 1.0);
+}
@@ -0,0 +1,55 @@
+//reads the geometry buffer back in the light passes, in either layout. the compact one has no position target, it is reconstructed
+//from depth
+
+#include "g_buffer.glsl"
+
+uniform sampler2D u_g_position;
+uniform sampler2D u_g_diffuse;
+uniform sampler2D u_g_normal;
+uniform sampler2D u_g_specular;
+uniform sampler2D u_g_depth;
+uniform mat4 u_inv_proj_view;
+
+//the local light shaders are compiled for one layout, with COMPACT_G_BUFFER 1 or 0. the others read it from u_compact_g_buffer
+#ifdef COMPACT_G_BUFFER
+bool is_compact_g_buffer()
+{
+	return COMPACT_G_BUFFER != 0;
+}
+#else
+uniform bool u_compact_g_buffer;
+
+bool is_compact_g_buffer()
+{
+	return u_compact_g_buffer;
+}
+#endif
+
+vec3 read_position(vec2 uv)
+{
+	if(!is_compact_g_buffer())
+	{
+		return texture(u_g_position, uv).rgb;
+	}
+	vec4 ndc_pos = vec4(uv, texture(u_g_depth, uv).x, 1.0) * 2.0 - 1.0;
+	vec4 position = u_inv_proj_view * ndc_pos;
+	return position.xyz / position.w;
+}
+
+vec3 read_normal(vec2 uv)
+{
+	vec4 normal = texture(u_g_normal, uv);
+	return is_compact_g_buffer() ? decode_normal(normal.rg) : normal.rgb;
+}
+
+vec3 read_normal(ivec2 pixel)
+{
+	vec4 normal = texelFetch(u_g_normal, pixel, 0);
+	return is_compact_g_buffer() ? decode_normal(normal.rg) : normal.rgb;
+}
+
+float read_specular_power(vec2 uv)
+{
+	float specular_power = texture(u_g_specular, uv).a;
+	return is_compact_g_buffer() ? decode_specular_power(specular_power) : specular_power;
+}
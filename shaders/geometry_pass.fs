@@ -11,6 +11,7 @@ uniform float u_specular_power;
 uniform vec3 u_ambient;
 uniform vec3 u_diffuse;
 uniform vec3 u_specular;
+uniform bool u_compact_g_buffer;
 
 //geometry buffer
 layout (location = 0) out vec3 o_posW;
@@ -20,13 +21,89 @@ layout (location = 3) out vec3 o_uv;
 layout (location = 4) out vec4 o_specular;
 layout (location = 5) out vec4 o_lighting;
 
+#include "g_buffer.glsl"
+
+#ifdef SUN_LIGHT
+//the sun is lit here instead of in directional_light_pass, the same terms without reading the geometry buffer back
+uniform vec3 u_cam_pos;
+uniform vec3 u_light_direction;
+uniform vec3 u_light_color;
+
+//shadow calculation, the sun shadow is split into cascades that share one texture
+uniform sampler2D u_shadow_map;
+uniform int u_num_cascades;
+uniform mat4 u_cascade_pv[4]; // light projection matrix of each cascade
+uniform vec4 u_cascade_tiles[4]; // xy : uv offset, zw : uv scale of each cascade's tile
+uniform vec4 u_cascade_splits; // view depth where each cascade ends
+uniform vec3 u_cam_direction;
+
+vec3 calc_sun_light(vec3 position, vec3 normal, vec3 diffuse_color, vec3 specular_color, float specular_power)
+{
+	vec3 to_eye = normalize(u_cam_pos - position);
+	vec3 reflection = normalize(reflect(u_light_direction, normal));
+
+	//diffuse
+	diffuse_color = diffuse_color * u_light_color * max(dot(-normalize(u_light_direction), normal), 0.0);
+
+	//specular
+	float specular_factor = max(dot(to_eye, reflection), 0.0001); // pow(0, 0) is undefined
+	specular_factor = pow(specular_factor, specular_power);
+	specular_color = specular_color * u_light_color * specular_factor;
+
+	//pick the first cascade that reaches this pixel's view depth, pixels past the last one are not shadowed
+	float view_depth = dot(position - u_cam_pos, u_cam_direction);
+	int cascade = 0;
+	while(cascade < u_num_cascades && view_depth > u_cascade_splits[cascade])
+	{
+		cascade++;
+	}
+
+	float shadow_factor = 1.0;
+	if(cascade < u_num_cascades)
+	{
+		vec4 light_space_pos = u_cascade_pv[cascade] * vec4(position, 1.0);
+		vec3 ndc_pos = light_space_pos.xyz / light_space_pos.w;
+		vec2 shadow_map_uv = u_cascade_tiles[cascade].xy + clamp(0.5 * ndc_pos.xy + 0.5, 0.0, 1.0) * u_cascade_tiles[cascade].zw;
+		float z = 0.5 * ndc_pos.z + 0.5;
+		float bias = 0.001;
+		if(texture(u_shadow_map, shadow_map_uv).x < z - bias)
+		{
+			shadow_factor = 0.1;
+		}
+	}
+
+	return (specular_color + diffuse_color) * shadow_factor;
+}
+#endif
+
 void main()
 {		
 	vec4 texture_color = texture2D(u_diffuse_texture, v_uv);
 	o_diffuse = u_diffuse * texture_color.xyz; // display texture color multiplied with material diffuse color
 	o_uv = vec3(v_uv, 0.0); // display uv
-	o_normalW = normalize(v_normalW); // display world normal
 	o_posW = v_posW; // display world position	
-	o_specular = vec4(u_specular * texture_color.xyz, u_specular_power);
+#ifdef SUN_LIGHT
+	vec3 specular_color = u_specular * texture_color.xyz;
+	float specular_power = u_specular_power;
+	if(u_compact_g_buffer)
+	{
+		//the light passes read the power back from 8 bits, so the sun uses the same value
+		specular_power = decode_specular_power(floor(encode_specular_power(specular_power) * 255.0 + 0.5) / 255.0);
+	}
+	o_lighting = vec4(calc_sun_light(v_posW, normalize(v_normalW), o_diffuse, specular_color, specular_power), 1.0);
+#else
 	o_lighting = vec4(0, 0, 0, 1);
+#endif
+
+	//the compact layout has no position nor uv target, those outputs are dropped
+	if(u_compact_g_buffer)
+	{
+		o_normalW = vec3(encode_normal(normalize(v_normalW)), 0.0);
+		o_specular = vec4(u_specular * texture_color.xyz, encode_specular_power(u_specular_power));
+	}
+	else
+	{
+		o_normalW = normalize(v_normalW); // display world normal
+		o_specular = vec4(u_specular * texture_color.xyz, u_specular_power);
+	}
 }
\ No newline at end of file
@@ -13,6 +13,9 @@ out vec3 v_posW;
 uniform mat4 u_world;
 uniform mat4 u_proj_view;
 
+//the depth pre-pass draws with this shader too, and the geometry pass tests against its depth with GL_EQUAL
+invariant gl_Position;
+
 void main()
 {
 	v_uv = a_uv;	
@@ -0,0 +1,11 @@
+#version 330
+
+// depth of the low resolution light buffer, copied from the first pixel of every block of the geometry buffer
+
+uniform sampler2D u_g_depth;
+uniform int u_resolution_scale;
+
+void main()
+{
+	gl_FragDepth = texelFetch(u_g_depth, ivec2(gl_FragCoord.xy) * u_resolution_scale, 0).x;
+}
@@ -0,0 +1,69 @@
+#version 330
+
+// adds the low resolution light buffer to the light accumulation. every pixel blends the 4 closest low resolution pixels
+// bilinearly, weighted down by how much their depth and normal differ from its own, so light does not bleed across edges
+
+uniform sampler2D u_low_resolution_light;
+uniform int u_resolution_scale;
+
+#include "g_buffer_read.glsl"
+
+uniform mat4 u_proj;
+
+layout (location = 5) out vec4 o_light_color;
+
+//distance from the camera plane
+float read_view_depth(ivec2 pixel)
+{
+	float ndc_z = texelFetch(u_g_depth, pixel, 0).x * 2.0 - 1.0;
+	return u_proj[3][2] / (ndc_z + u_proj[2][2]);
+}
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+
+	//nothing was drawn on the background
+	if(texelFetch(u_g_depth, pixel, 0).x == 1.0)
+	{
+		discard;
+	}
+
+	float view_depth = read_view_depth(pixel);
+	vec3 normal = read_normal(pixel);
+
+	//low resolution pixel i was shaded for pixel i * scale
+	vec2 grid = vec2(pixel) / float(u_resolution_scale);
+	ivec2 base = ivec2(floor(grid));
+	vec2 f = grid - vec2(base);
+	ivec2 max_sample = textureSize(u_low_resolution_light, 0) - 1;
+
+	vec3 light = vec3(0.0);
+	float total_weight = 0.0;
+	vec3 closest_light = vec3(0.0);
+	float closest_difference = 1e30;
+	for(int i = 0; i < 4; i++)
+	{
+		ivec2 offset = ivec2(i & 1, i >> 1);
+		ivec2 sample_pixel = min(base + offset, max_sample);
+		ivec2 source_pixel = sample_pixel * u_resolution_scale;
+		vec3 sample_light = texelFetch(u_low_resolution_light, sample_pixel, 0).rgb;
+
+		float depth_difference = abs(read_view_depth(source_pixel) - view_depth) / view_depth;
+		float bilinear_weight = (offset.x == 1 ? f.x : 1.0 - f.x) * (offset.y == 1 ? f.y : 1.0 - f.y);
+		float depth_weight = exp(-depth_difference * 50.0);
+		float normal_weight = pow(max(dot(read_normal(source_pixel), normal), 0.0), 16.0);
+		float weight = bilinear_weight * depth_weight * normal_weight;
+
+		light += sample_light * weight;
+		total_weight += weight;
+		if(depth_difference < closest_difference)
+		{
+			closest_difference = depth_difference;
+			closest_light = sample_light;
+		}
+	}
+
+	//no sample is on the same surface, the closest one in depth is the best guess
+	o_light_color = vec4(total_weight > 1e-4 ? light / total_weight : closest_light, 0.0);
+}
@@ -0,0 +1,109 @@
+#version 330
+
+//compiled with either POINT_LIGHT or SPOT_LIGHT defined. SHADOWS adds the shadow atlas lookup of a spot light, filtered over
+//PCF_SIZE x PCF_SIZE texels, and COMPACT_G_BUFFER, 1 or 0, is the geometry buffer layout. RESOLUTION_SCALE draws into the
+//low resolution light buffer. see Renderer::get_local_light_shader
+
+#include "g_buffer_read.glsl"
+
+uniform vec2 u_screen_size;
+uniform vec3 u_cam_pos;
+
+#ifdef POINT_LIGHT
+//point light properties, 3 texels each : position & cutoff, color & constant attenuation, linear & quadratic attenuation
+uniform samplerBuffer u_point_lights;
+flat in int v_light_index;
+#else
+//spot light properties
+uniform vec3 u_light_color;
+uniform vec3 u_light_position;
+uniform float u_light_const_attenuation;
+uniform float u_light_linear_attenuation;
+uniform float u_light_quadratic_attenuation;
+uniform float u_light_correction_factor;
+uniform vec3 u_light_direction;
+uniform float u_light_cutoff; // distance the light reaches
+uniform float u_light_cos_angle; // cosine of the light's half angle
+#endif
+
+#ifdef SHADOWS
+#include "spot_shadow.glsl"
+
+uniform mat4 u_light_pv; // light projection matrix
+uniform vec4 u_shadow_tile; // this light's tile in the atlas. xy : uv offset, zw : uv scale
+#endif
+
+layout (location = 5) out vec4 o_light_color;
+
+void main()
+{	
+#ifdef POINT_LIGHT
+	vec4 light_position_cutoff = texelFetch(u_point_lights, v_light_index * 3);
+	vec4 light_color_const = texelFetch(u_point_lights, v_light_index * 3 + 1);
+	vec4 light_attenuation = texelFetch(u_point_lights, v_light_index * 3 + 2);
+	vec3 light_position = light_position_cutoff.xyz;
+	float light_cutoff = light_position_cutoff.w; // radius of the light volume
+	vec3 light_color = light_color_const.rgb;
+	float light_const_attenuation = light_color_const.a;
+	float light_linear_attenuation = light_attenuation.x;
+	float light_quadratic_attenuation = light_attenuation.y;
+#else
+	vec3 light_position = u_light_position;
+	float light_cutoff = u_light_cutoff;
+	vec3 light_color = u_light_color;
+	float light_const_attenuation = u_light_const_attenuation;
+	float light_linear_attenuation = u_light_linear_attenuation;
+	float light_quadratic_attenuation = u_light_quadratic_attenuation;
+#endif
+
+#ifdef RESOLUTION_SCALE
+	//a low resolution pixel is shaded for the first pixel of its block, see LowResolutionLightBuffer
+	vec2 geo_texcoord = (floor(gl_FragCoord.xy) * float(RESOLUTION_SCALE) + 0.5) / u_screen_size;
+#else
+	vec2 geo_texcoord = gl_FragCoord.xy / u_screen_size;
+#endif
+	vec3 position = read_position(geo_texcoord);	
+	vec3 normal = read_normal(geo_texcoord);
+	vec3 diffuse_color = texture(u_g_diffuse, geo_texcoord).rgb;
+	vec3 specular_color = texture(u_g_specular, geo_texcoord).rgb;
+	float specular_power = read_specular_power(geo_texcoord);
+	
+	vec3 to_eye = normalize(u_cam_pos - position);	
+	vec3 light_dir = position - light_position;
+	vec3 reflection = normalize(reflect(light_dir, normal));
+	float distance = length(light_dir);
+	
+	//without the stencil pass, the pixels in front of the light volume are drawn as well
+#ifdef POINT_LIGHT
+	if(distance > light_cutoff)
+	{
+		discard;
+	}
+#else
+	float axial_distance = dot(light_dir, u_light_direction);
+	if(distance > light_cutoff || axial_distance < distance * u_light_cos_angle)
+	{
+		discard;
+	}
+#endif
+
+	float attenuation = max(1.0, light_const_attenuation + light_linear_attenuation * distance + light_quadratic_attenuation * distance * distance);
+	
+	//diffuse
+	float diffuse_factor = max(dot(-normalize(light_dir), normal), 0.0);
+	
+	//specular
+	float specular_factor = max(dot(to_eye, reflection), 0.0001); // pow(0, 0) is undefined, and gives NaN on pixels with a specular power of 0 (e.g. the background)
+	specular_factor = pow(specular_factor, specular_power);
+
+#ifdef POINT_LIGHT
+	o_light_color = vec4((diffuse_color * diffuse_factor + specular_color * specular_factor) * light_color / attenuation, 1.0);
+#else
+	//spot lights are not modulated by the material colors, they are scaled by their correction factor instead
+	float light_factor = u_light_correction_factor / attenuation;
+#ifdef SHADOWS
+	light_factor *= calc_spot_shadow_factor(position, u_light_pv, u_shadow_tile);
+#endif
+	o_light_color = vec4((diffuse_factor + specular_factor) * light_color * light_factor, 1.0);
+#endif
+}
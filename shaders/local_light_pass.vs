@@ -0,0 +1,38 @@
+#version 330
+
+//compiled with either POINT_LIGHT or SPOT_LIGHT defined, see Renderer::get_local_light_shader
+
+in vec3 a_posL; // local pos
+in vec2 a_uv;
+in vec3 a_normalL;
+
+out vec3 v_posP;
+out vec2 v_uv;
+out vec3 v_normalL;
+out vec3 v_normalW;
+out vec3 v_posW;
+
+uniform mat4 u_proj_view;
+
+#ifdef POINT_LIGHT
+flat out int v_light_index;
+
+//point lights, 3 texels each : position & cutoff, color & constant attenuation, linear & quadratic attenuation
+uniform samplerBuffer u_point_lights;
+uniform int u_first_light;
+#else
+uniform mat4 u_world;
+#endif
+
+void main()
+{
+#ifdef POINT_LIGHT
+	//the unit sphere scaled to the light's cutoff, on the light's position
+	v_light_index = u_first_light + gl_InstanceID;
+	vec4 light_position_cutoff = texelFetch(u_point_lights, v_light_index * 3);
+	v_posW = a_posL * light_position_cutoff.w + light_position_cutoff.xyz;
+#else
+	v_posW = (u_world * vec4(a_posL, 1.0)).xyz;
+#endif
+	gl_Position = (u_proj_view * vec4(v_posW, 1.0));
+}
@@ -0,0 +1,7 @@
+#version 330
+
+// depth only shadow pass and depth pre-pass, the depth is written by the fixed function pipeline
+
+void main()
+{
+}
\ No newline at end of file
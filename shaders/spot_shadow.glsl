@@ -0,0 +1,33 @@
+//spot light shadow lookup in the shadow atlas, filtered over PCF_SIZE x PCF_SIZE texels
+
+#ifndef PCF_SIZE
+#define PCF_SIZE 1
+#endif
+
+uniform sampler2D u_shadow_map; // the shadow atlas shared by all spot lights
+
+//light_pv is the light projection matrix, shadow_tile the light's tile in the atlas. xy : uv offset, zw : uv scale
+float calc_spot_shadow_factor(vec3 position, mat4 light_pv, vec4 shadow_tile)
+{
+	//convert the position to the light's NDC, then to texcoord space [0, 1]
+	vec4 light_space_pos = light_pv * vec4(position, 1.0);
+	vec3 ndc_pos = light_space_pos.xyz / light_space_pos.w;
+	vec2 shadow_map_uv = 0.5 * ndc_pos.xy + 0.5;
+	float z = 0.5 * ndc_pos.z + 0.5;
+	float bias = 0.001;
+
+	//compare z and the shadow map depth, z is the actual pixel depth, and the shadow map contains the nearest depth to the light source
+	vec2 texel_size = 1.0 / (vec2(textureSize(u_shadow_map, 0)) * shadow_tile.zw); // one atlas texel in tile uv
+	float lit = 0.0;
+	for(int y = 0; y < PCF_SIZE; y++)
+	{
+		for(int x = 0; x < PCF_SIZE; x++)
+		{
+			vec2 offset = vec2(x, y) - 0.5 * float(PCF_SIZE - 1);
+			vec2 tile_uv = clamp(shadow_map_uv + offset * texel_size, 0.0, 1.0); // never sample a neighbour tile
+			float shadow_map_depth = texture(u_shadow_map, shadow_tile.xy + tile_uv * shadow_tile.zw).x;
+			lit += shadow_map_depth < z - bias ? 0.1 : 1.0;
+		}
+	}
+	return lit / float(PCF_SIZE * PCF_SIZE);
+}
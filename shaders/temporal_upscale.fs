@@ -0,0 +1,116 @@
+#version 330
+
+// accumulates the light accumulation, rendered at the render resolution with a sub-pixel jitter, into the history at the window's
+// resolution. every window pixel filters the 3x3 render pixels around it by how close their jittered samples are, reprojects the
+// history with the closest depth among them, clamps it to their colors, and blends the two
+
+uniform sampler2D u_light; // light accumulation
+uniform sampler2D u_g_depth;
+uniform sampler2D u_history;
+uniform bool u_history_valid;
+uniform mat4 u_inv_proj_view; // of this frame, with the jitter
+uniform mat4 u_prev_proj_view; // of the history, without the jitter
+uniform vec2 u_jitter; // in render pixels, how far the jitter moved this frame's image
+
+layout (location = 0) out vec4 o_color;
+
+//catmull-rom filtered history, in 5 bilinear taps. bilinear alone blurs the history a little more on every frame
+vec3 read_history(vec2 uv)
+{
+	vec2 size = vec2(textureSize(u_history, 0));
+	vec2 position = uv * size;
+	vec2 center = floor(position - 0.5) + 0.5;
+	vec2 f = position - center;
+
+	vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+	vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+	vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+	vec2 w3 = f * f * (-0.5 + 0.5 * f);
+	vec2 w12 = w1 + w2;
+
+	vec2 uv0 = (center - 1.0) / size;
+	vec2 uv3 = (center + 2.0) / size;
+	vec2 uv12 = (center + w2 / w12) / size;
+
+	vec3 color = texture(u_history, vec2(uv12.x, uv0.y)).rgb * (w12.x * w0.y)
+		+ texture(u_history, vec2(uv0.x, uv12.y)).rgb * (w0.x * w12.y)
+		+ texture(u_history, uv12).rgb * (w12.x * w12.y)
+		+ texture(u_history, vec2(uv3.x, uv12.y)).rgb * (w3.x * w12.y)
+		+ texture(u_history, vec2(uv12.x, uv3.y)).rgb * (w12.x * w3.y);
+	float weight = w12.x * w0.y + w0.x * w12.y + w12.x * w12.y + w3.x * w12.y + w12.x * w3.y;
+	return max(color / weight, vec3(0.0));
+}
+
+void main()
+{
+	vec2 render_size = vec2(textureSize(u_light, 0));
+	vec2 uv = gl_FragCoord.xy / vec2(textureSize(u_history, 0));
+
+	//this pixel's center in render pixels. render pixel i was shaded for i + 0.5 - u_jitter, the closest one is floor(position + u_jitter)
+	vec2 position = uv * render_size;
+	ivec2 center = ivec2(floor(position + u_jitter));
+	ivec2 max_pixel = ivec2(render_size) - 1;
+
+	vec3 color = vec3(0.0);
+	float total_weight = 0.0;
+	float max_weight = 0.0;
+	vec3 moment1 = vec3(0.0);
+	vec3 moment2 = vec3(0.0);
+	float closest_depth = 1.0;
+	ivec2 closest_pixel = clamp(center, ivec2(0), max_pixel);
+	for(int y = -1; y <= 1; y++)
+	{
+		for(int x = -1; x <= 1; x++)
+		{
+			ivec2 pixel = clamp(center + ivec2(x, y), ivec2(0), max_pixel);
+			//the window only shows [0, 1], brighter samples would flicker through the blend
+			vec3 sample_color = min(texelFetch(u_light, pixel, 0).rgb, vec3(1.0));
+
+			//gaussian of the distance between the sample and this pixel
+			vec2 offset = vec2(pixel) + 0.5 - u_jitter - position;
+			float weight = exp(-2.29 * dot(offset, offset));
+			color += sample_color * weight;
+			total_weight += weight;
+			max_weight = max(max_weight, weight);
+			moment1 += sample_color;
+			moment2 += sample_color * sample_color;
+
+			float depth = texelFetch(u_g_depth, pixel, 0).x;
+			if(depth < closest_depth)
+			{
+				closest_depth = depth;
+				closest_pixel = pixel;
+			}
+		}
+	}
+	color /= total_weight;
+
+	if(!u_history_valid)
+	{
+		o_color = vec4(color, 1.0);
+		return;
+	}
+
+	//the closest surface around the pixel decides the motion, so the edges of moving objects keep their own history
+	vec2 closest_uv = (vec2(closest_pixel) + 0.5) / render_size;
+	vec4 world_position = u_inv_proj_view * vec4(vec3(closest_uv, closest_depth) * 2.0 - 1.0, 1.0);
+	world_position /= world_position.w;
+	vec4 prev_clip = u_prev_proj_view * world_position;
+	vec2 prev_uv = prev_clip.xy / prev_clip.w * 0.5 + 0.5;
+	vec2 history_uv = uv + prev_uv - (closest_uv - u_jitter / render_size);
+
+	if(any(lessThan(history_uv, vec2(0.0))) || any(greaterThan(history_uv, vec2(1.0))))
+	{
+		o_color = vec4(color, 1.0);
+		return;
+	}
+
+	//history far from what the neighborhood shows now belongs to a surface that is gone
+	vec3 mean = moment1 / 9.0;
+	vec3 deviation = sqrt(max(moment2 / 9.0 - mean * mean, vec3(0.0)));
+	vec3 history = clamp(read_history(history_uv), mean - 1.25 * deviation, mean + 1.25 * deviation);
+
+	//a sample right on this pixel counts more than one half a render pixel away
+	float blend = 0.1 * max_weight;
+	o_color = vec4(mix(history, color, blend), 1.0);
+}
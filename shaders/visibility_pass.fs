@@ -0,0 +1,12 @@
+#version 330
+
+// visibility buffer pass, every pixel only keeps which triangle of which draw covers it. see VisibilityBuffer
+
+uniform uint u_draw_id;
+
+layout (location = 0) out uint o_visibility;
+
+void main()
+{
+	o_visibility = (u_draw_id << 22) | uint(gl_PrimitiveID);
+}
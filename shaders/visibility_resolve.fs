@@ -0,0 +1,123 @@
+#version 330
+
+// rebuilds the geometry buffer from the visibility buffer, in one full screen pass per batch of diffuse textures. every pixel fetches
+// its draw's transform and material and its triangle, intersects the triangle with the pixel's ray for the barycentrics, and writes
+// the same targets as geometry_pass.fs
+
+#define NUM_BATCH_TEXTURES 8 // VisibilityBuffer::NUM_BATCH_TEXTURES
+
+uniform usampler2D u_visibility;
+uniform samplerBuffer u_vertices; // 2 texels per vertex : position and u, normal and v
+uniform usamplerBuffer u_indices;
+uniform samplerBuffer u_draws; // 6 texels per draw : the world matrix's columns, diffuse and specular power, specular
+uniform usamplerBuffer u_draw_indices; // first index and diffuse texture of every draw
+
+uniform mat4 u_inv_proj_view;
+uniform vec3 u_cam_pos;
+uniform vec2 u_screen_size;
+
+uniform sampler2D u_diffuse_textures[NUM_BATCH_TEXTURES];
+uniform int u_texture_batch;
+uniform bool u_compact_g_buffer;
+
+//geometry buffer
+layout (location = 0) out vec3 o_posW;
+layout (location = 1) out vec3 o_diffuse;
+layout (location = 2) out vec3 o_normalW;
+layout (location = 3) out vec3 o_uv;
+layout (location = 4) out vec4 o_specular;
+layout (location = 5) out vec4 o_lighting;
+
+#include "g_buffer.glsl"
+
+//glsl 3.30 only indexes sampler arrays with constants
+vec4 read_diffuse_texture(int texture_index, vec2 uv)
+{
+	//the diffuse textures have no mipmaps, so the base level is what the geometry pass samples too
+	switch(texture_index)
+	{
+		case 0: return textureLod(u_diffuse_textures[0], uv, 0.0);
+		case 1: return textureLod(u_diffuse_textures[1], uv, 0.0);
+		case 2: return textureLod(u_diffuse_textures[2], uv, 0.0);
+		case 3: return textureLod(u_diffuse_textures[3], uv, 0.0);
+		case 4: return textureLod(u_diffuse_textures[4], uv, 0.0);
+		case 5: return textureLod(u_diffuse_textures[5], uv, 0.0);
+		case 6: return textureLod(u_diffuse_textures[6], uv, 0.0);
+		default: return textureLod(u_diffuse_textures[7], uv, 0.0);
+	}
+}
+
+void main()
+{
+	//id 0 is the background
+	uint visibility = texelFetch(u_visibility, ivec2(gl_FragCoord.xy), 0).r;
+	int draw = int(visibility >> 22) - 1;
+	if(draw < 0)
+	{
+		discard;
+	}
+
+	//the pixels of the draws whose texture is in another batch are resolved by that batch's pass
+	uvec2 draw_indices = texelFetch(u_draw_indices, draw).rg;
+	int texture_index = int(draw_indices.y) - u_texture_batch * NUM_BATCH_TEXTURES;
+	if(texture_index < 0 || texture_index >= NUM_BATCH_TEXTURES)
+	{
+		discard;
+	}
+
+	mat4 world = mat4(texelFetch(u_draws, draw * 6), texelFetch(u_draws, draw * 6 + 1), texelFetch(u_draws, draw * 6 + 2), texelFetch(u_draws, draw * 6 + 3));
+	vec4 diffuse_specular_power = texelFetch(u_draws, draw * 6 + 4);
+	vec3 specular = texelFetch(u_draws, draw * 6 + 5).rgb;
+
+	int first_index = int(draw_indices.x) + int(visibility & 0x3FFFFFu) * 3;
+	int indices[3];
+	vec3 positions[3];
+	for(int i = 0; i < 3; i++)
+	{
+		indices[i] = int(texelFetch(u_indices, first_index + i).r);
+		positions[i] = (world * vec4(texelFetch(u_vertices, indices[i] * 2).xyz, 1.0)).xyz;
+	}
+
+	//ray through the pixel center against the triangle's plane, the barycentrics come out perspective correct
+	vec4 far_pos = u_inv_proj_view * vec4(gl_FragCoord.xy / u_screen_size * 2.0 - 1.0, 1.0, 1.0);
+	vec3 ray = far_pos.xyz / far_pos.w - u_cam_pos;
+	vec3 edge1 = positions[1] - positions[0];
+	vec3 edge2 = positions[2] - positions[0];
+	vec3 p = cross(ray, edge2);
+	float det = dot(edge1, p);
+	det = abs(det) < 1e-12 ? 1e-12 : det; // the ray grazes the triangle
+	vec3 to_origin = u_cam_pos - positions[0];
+	vec3 q = cross(to_origin, edge1);
+	float u = dot(to_origin, p) / det;
+	float v = dot(ray, q) / det;
+	vec3 barycentrics = vec3(1.0 - u - v, u, v);
+
+	vec3 position = u_cam_pos + ray * (dot(edge2, q) / det);
+	vec3 normal = vec3(0.0);
+	vec2 uv = vec2(0.0);
+	for(int i = 0; i < 3; i++)
+	{
+		vec4 normal_v = texelFetch(u_vertices, indices[i] * 2 + 1);
+		normal += normal_v.xyz * barycentrics[i];
+		uv += vec2(texelFetch(u_vertices, indices[i] * 2).w, normal_v.w) * barycentrics[i];
+	}
+	normal = normalize((world * vec4(normal, 0.0)).xyz);
+
+	vec4 texture_color = read_diffuse_texture(texture_index, uv);
+	o_diffuse = diffuse_specular_power.rgb * texture_color.xyz;
+	o_uv = vec3(uv, 0.0);
+	o_posW = position;
+	o_lighting = vec4(0, 0, 0, 1);
+
+	//the compact layout has no position nor uv target, those outputs are dropped
+	if(u_compact_g_buffer)
+	{
+		o_normalW = vec3(encode_normal(normal), 0.0);
+		o_specular = vec4(specular * texture_color.xyz, encode_specular_power(diffuse_specular_power.a));
+	}
+	else
+	{
+		o_normalW = normal;
+		o_specular = vec4(specular * texture_color.xyz, diffuse_specular_power.a);
+	}
+}
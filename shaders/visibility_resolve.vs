@@ -0,0 +1,8 @@
+#version 330
+
+in vec3 a_posL; // local pos
+
+void main()
+{
+	gl_Position = vec4(a_posL, 1.0);
+}
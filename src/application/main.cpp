@@ -11,12 +11,19 @@
 #include <SFML/OpenGL.hpp>
 #include <SFML/Window.hpp>
 #include <string>
+#include <iostream>
+#include <cstdlib>
 #include "../renderer/camera.hpp"
 #include "../renderer/renderer.hpp"
+#include "../renderer/GlStats.hpp"
 #include "../scene/scene.hpp"
+#include "../util/CpuProfiler.hpp"
 
 using namespace bey;
 
+static const int num_top_lights = 5; // most expensive lights in the gpu profiler's statistics
+static const char* default_cpu_trace_filename = "cpu_trace.json";
+
 int main( int argc, char ** argv )
 {
 	int screen_width = 1920;
@@ -36,7 +43,7 @@ int main( int argc, char ** argv )
 	contextSettings.minorVersion = 0;
 
 	// create the window - you can change resolution, title, etc. here
-	sf::Window window(sf::VideoMode(screen_width, screen_height), "P4 Deferred Renderer", sf::Style::Titlebar | sf::Style::Close, contextSettings);
+	sf::Window window(sf::VideoMode(screen_width, screen_height), "P4 Deferred Renderer", sf::Style::Default, contextSettings);
 	window.setVerticalSyncEnabled(true);
 
 #ifdef _WIN32
@@ -61,6 +68,18 @@ int main( int argc, char ** argv )
 		return EXIT_FAILURE;
 	}
 
+	// --cpu-trace <file> records the cpu zones from the start, loading included, and writes them to file as a chrome trace on exit
+	std::string cpu_trace_filename( default_cpu_trace_filename );
+	for ( int i = 1; i < argc - 2; i++ )
+	{
+		if ( std::string( argv[i] ) == "--cpu-trace" )
+		{
+			cpu_trace_filename = argv[i + 1];
+			CpuProfiler::start();
+		}
+	}
+	BEY_PROFILE_THREAD_NAME( "main" );
+
 	// setup the renderer
 	Scene scene;
 	scene.camera.set_aspect_ratio(1.0f * screen_width / screen_height);
@@ -75,6 +94,30 @@ int main( int argc, char ** argv )
 	RendererInitData data;
 	data.screen_width = screen_width;
 	data.screen_height = screen_height;
+
+	// --frame-time <milliseconds> lets the renderer lower its quality to hold that gpu frame time
+	// --render-scale <scale> renders at a fraction of the window size, --temporal-upscaling accumulates it back to the window size
+	for ( int i = 1; i < argc - 1; i++ )
+	{
+		std::string arg( argv[i] );
+		if ( arg == "--frame-time" && i < argc - 2 )
+		{
+			data.target_frame_time = (float)atof( argv[i + 1] );
+		}
+		else if ( arg == "--render-scale" && i < argc - 2 )
+		{
+			data.render_scale = (float)atof( argv[i + 1] );
+		}
+		else if ( arg == "--temporal-upscaling" )
+		{
+			data.temporal_upscaling = true;
+		}
+		else if ( arg == "--no-idle-skipping" )
+		{
+			data.idle_frame_skipping = false;
+		}
+	}
+
 	if ( !renderer.initialize(scene, data) )
 	{
 		sf::err() << "FATAL ERROR: Failed to initialize renderer" << std::endl;
@@ -82,12 +125,51 @@ int main( int argc, char ** argv )
 		return EXIT_FAILURE;
 	}
 
+	// --gpu-profile <file> times every pass and light on the gpu, and writes each frame to file, as csv when it ends in .csv and as json otherwise
+	for ( int i = 1; i < argc - 2; i++ )
+	{
+		std::string arg( argv[i] );
+		if ( arg == "--gpu-profile" )
+		{
+			std::string profile_filename( argv[i + 1] );
+			bool csv = profile_filename.size() > 4 && profile_filename.compare( profile_filename.size() - 4, 4, ".csv" ) == 0;
+			renderer.get_gpu_profiler().set_enabled( true );
+			renderer.get_gpu_profiler().begin_export( profile_filename, csv ? GpuProfiler::ExportFormat::CSV : GpuProfiler::ExportFormat::JSON );
+		}
+	}
+
+	// --benchmark compares the geometry buffer and visibility buffer paths on the scene's camera, then quits
+	for ( int i = 1; i < argc - 1; i++ )
+	{
+		if ( std::string( argv[i] ) == "--benchmark" )
+		{
+			renderer.benchmark_geometry_paths( scene, 200 );
+			if ( renderer.get_gpu_profiler().is_enabled() )
+			{
+				renderer.get_gpu_profiler().print( std::cout, num_top_lights );
+			}
+			if ( GlStats::is_compiled() )
+			{
+				GlStats::print( std::cout );
+			}
+			if ( CpuProfiler::is_recording() )
+			{
+				CpuProfiler::write_trace( cpu_trace_filename );
+			}
+			renderer.release();
+			window.close();
+			return EXIT_SUCCESS;
+		}
+	}
+
 	sf::Clock clock;
 
 	// main loop - handle user input
 	bool running = true;
 	while ( running )
 	{
+		BEY_PROFILE_ZONE( "frame" );
+		BEY_PROFILE_ZONE_NAMED( events_zone, "events" );
 		sf::Event event;
 		while ( window.pollEvent(event) )
 		{
@@ -106,10 +188,154 @@ int main( int argc, char ** argv )
 					 * like saving a screenshot, that you want to trigger immediately and not poll
 					 * for every frame, you should put that here.
 					 */
-					 break;
+
+					// switch between stencil volumes and clustered shading for point and spot lights
+					if ( event.key.code == sf::Keyboard::C )
+					{
+						bool clustered = renderer.get_light_path() != Renderer::LightPath::CLUSTERED;
+						renderer.set_light_path( clustered ? Renderer::LightPath::CLUSTERED : Renderer::LightPath::STENCIL );
+						std::cout << "light path : " << ( clustered ? "clustered" : "stencil" ) << std::endl;
+					}
+
+					// fill the geometry buffer directly, or resolve it from a visibility buffer
+					if ( event.key.code == sf::Keyboard::U )
+					{
+						bool visibility_buffer = renderer.get_geometry_path() != Renderer::GeometryPath::VISIBILITY_BUFFER;
+						renderer.set_geometry_path( visibility_buffer ? Renderer::GeometryPath::VISIBILITY_BUFFER : Renderer::GeometryPath::GEOMETRY_BUFFER );
+						visibility_buffer = renderer.get_geometry_path() == Renderer::GeometryPath::VISIBILITY_BUFFER;
+						std::cout << "geometry path : " << ( visibility_buffer ? "visibility buffer" : "geometry buffer" ) << std::endl;
+					}
+
+					// shade the low resolution lights at full, half or quarter resolution
+					if ( event.key.code == sf::Keyboard::H )
+					{
+						int scale = renderer.get_light_resolution_scale() * 2;
+						renderer.set_light_resolution_scale( scale > 4 ? 1 : scale );
+						std::cout << "local light resolution : 1/" << renderer.get_light_resolution_scale() << std::endl;
+					}
+
+					// hold 60 frames per second by lowering the quality when needed, or always render at full quality
+					if ( event.key.code == sf::Keyboard::T )
+					{
+						renderer.set_target_frame_time( renderer.get_target_frame_time() > 0.0f ? 0.0f : 1000.0f / 60.0f );
+						std::cout << "target frame time : " << ( renderer.get_target_frame_time() > 0.0f ? "16.7 ms" : "off" ) << std::endl;
+					}
+
+					// temporal upscaling, or a plain stretch of the render to the window
+					if ( event.key.code == sf::Keyboard::Y )
+					{
+						bool temporal_upscaling = !renderer.get_temporal_upscaling();
+						renderer.set_temporal_upscaling( temporal_upscaling );
+						std::cout << "temporal upscaling : " << ( temporal_upscaling ? "on" : "off" ) << ", render scale " << renderer.get_render_scale() << std::endl;
+					}
+
+					// cost and error of the low resolution lights against full resolution
+					if ( event.key.code == sf::Keyboard::R )
+					{
+						renderer.compare_light_resolution( scene, 50 );
+					}
+
+					// light the sun in the geometry pass, or in its own full screen pass
+					if ( event.key.code == sf::Keyboard::F )
+					{
+						bool fused = !renderer.get_fused_sun_light();
+						renderer.set_fused_sun_light( fused );
+						std::cout << "sun light : " << ( fused ? "fused into the geometry pass" : "full screen pass" ) << std::endl;
+					}
+
+					// depth pre-pass before the geometry pass
+					if ( event.key.code == sf::Keyboard::Z )
+					{
+						bool depth_pre_pass = !renderer.get_depth_pre_pass();
+						renderer.set_depth_pre_pass( depth_pre_pass );
+						std::cout << "depth pre-pass : " << ( depth_pre_pass ? "on" : "off" ) << std::endl;
+					}
+
+					// draw the geometry pass front to back
+					if ( event.key.code == sf::Keyboard::X )
+					{
+						bool sort_front_to_back = !renderer.get_sort_front_to_back();
+						renderer.set_sort_front_to_back( sort_front_to_back );
+						std::cout << "front to back : " << ( sort_front_to_back ? "on" : "off" ) << std::endl;
+					}
+
+					// fragments the geometry pass wrote, 1 per pixel means no overdraw
+					if ( event.key.code == sf::Keyboard::G )
+					{
+						const Renderer::GeometryPassStats& stats = renderer.get_geometry_pass_stats();
+						std::cout << "geometry pass : " << stats.num_samples << " samples, overdraw " << stats.overdraw << std::endl;
+					}
+
+					// how the light volumes of the last frame were drawn
+					if ( event.key.code == sf::Keyboard::V )
+					{
+						const Renderer::LightVolumeStats& stats = renderer.get_light_volume_stats();
+						std::cout << "light volumes : " << stats.num_culled << " culled, " << stats.num_inside << " inside, "
+							<< stats.num_scissor << " scissor, " << stats.num_stencil << " stencil in " << stats.num_stencil_clears << " stencil clears" << std::endl;
+					}
+
+					// gpu profiler on and off, its statistics are printed when it is turned off
+					if ( event.key.code == sf::Keyboard::P )
+					{
+						GpuProfiler& profiler = renderer.get_gpu_profiler();
+						profiler.set_enabled( !profiler.is_enabled() );
+						if ( profiler.is_enabled() )
+						{
+							std::cout << "gpu profiler : on" << std::endl;
+						}
+						else
+						{
+							profiler.print( std::cout, num_top_lights );
+						}
+					}
+
+					// frames rendered in full, with only their lights, or skipped because nothing changed
+					if ( event.key.code == sf::Keyboard::O )
+					{
+						const Renderer::FrameUpdateStats& stats = renderer.get_frame_update_stats();
+						std::cout << "frames : " << stats.num_full << " full, " << stats.num_lights_only << " lights only, " << stats.num_idle << " skipped" << std::endl;
+					}
+
+					// gl calls of the last frame, per pass
+					if ( event.key.code == sf::Keyboard::M )
+					{
+						if ( GlStats::is_compiled() )
+						{
+							GlStats::print( std::cout );
+						}
+						else
+						{
+							std::cout << "gl stats : not compiled in, build with GL_STATS on" << std::endl;
+						}
+					}
+
+					// cpu zones recording on and off, the trace is written when it is turned off
+					if ( event.key.code == sf::Keyboard::N )
+					{
+						if ( CpuProfiler::is_recording() )
+						{
+							CpuProfiler::stop();
+							if ( CpuProfiler::write_trace( cpu_trace_filename ) )
+							{
+								std::cout << "cpu profiler : trace written to " << cpu_trace_filename << std::endl;
+							}
+						}
+						else
+						{
+							CpuProfiler::start();
+							std::cout << "cpu profiler : on" << std::endl;
+						}
+					}
+					break;
 
 				case sf::Event::Resized:
-					glViewport(0, 0, event.size.width, event.size.height);
+					// a minimized window has no size, the last frame size is kept until it comes back
+					if ( event.size.width > 0 && event.size.height > 0 )
+					{
+						glViewport(0, 0, event.size.width, event.size.height);
+						scene.camera.set_aspect_ratio(1.0f * event.size.width / event.size.height);
+						renderer.resize(event.size.width, event.size.height);
+					}
 					break;
 
 				// If you want, you can pause rendering when the window is out of focus.
@@ -121,6 +347,8 @@ int main( int argc, char ** argv )
 			}
 		}
 
+		BEY_PROFILE_ZONE_END( events_zone );
+
 		float deltaTime = clock.restart().asSeconds();
 
 		// update the camera position and orientation
@@ -138,9 +366,16 @@ int main( int argc, char ** argv )
 		// be careful though, as SFML/Graphics will override OpenGL settings!
 
 		// sfml handles presenting the frame for you
+		BEY_PROFILE_ZONE( "display" );
 		window.display();
 	}
 
+	if ( CpuProfiler::is_recording() )
+	{
+		CpuProfiler::stop();
+		CpuProfiler::write_trace( cpu_trace_filename );
+	}
+
 	renderer.release();
 
 	window.close();
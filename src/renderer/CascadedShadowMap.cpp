@@ -0,0 +1,303 @@
+#include "renderer/CascadedShadowMap.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <limits>
+#include "renderer/GlStats.hpp"
+
+using namespace bey;
+
+// a refitted cascade is made this much bigger than its slice of the frustum, so the camera can move a while before the next refit
+static const float refit_padding = 1.3f;
+
+CascadedShadowMap::CascadedShadowMap()
+{
+}
+
+CascadedShadowMap::~CascadedShadowMap()
+{
+}
+
+void CascadedShadowMap::initialize(int num_cascades, int resolution, float split_lambda, bool dynamic_casters, ShadowMap::DepthFormat depth_format, bool debug)
+{
+	this->num_cascades = glm::clamp(num_cascades, 1, (int)MAX_CASCADES);
+	this->resolution = resolution;
+	max_resolution = resolution;
+	this->split_lambda = split_lambda;
+	dynamic_layer = dynamic_casters;
+	sun_direction = glm::vec3(0);
+	fit_scene_bounds.min = glm::vec3(0);
+	fit_scene_bounds.max = glm::vec3(0);
+
+	for (int i = 0; i < MAX_CASCADES; i++)
+	{
+		static_dirty[i] = true;
+		fit_extents[i] = 0.0f;
+	}
+
+	int columns = this->num_cascades > 1 ? 2 : 1;
+	int rows = this->num_cascades > 2 ? 2 : 1;
+	static_shadow_map.initialize(columns * resolution, rows * resolution, depth_format, debug);
+	if (dynamic_layer)
+	{
+		shadow_map.initialize(columns * resolution, rows * resolution, depth_format, debug);
+	}
+}
+
+void CascadedShadowMap::set_resolution(int resolution)
+{
+	resolution = glm::clamp(resolution, 1, max_resolution);
+	if (resolution == this->resolution)
+	{
+		return;
+	}
+
+	this->resolution = resolution;
+	for (int i = 0; i < MAX_CASCADES; i++)
+	{
+		static_dirty[i] = true;
+	}
+}
+
+int CascadedShadowMap::get_resolution() const
+{
+	return resolution;
+}
+
+void CascadedShadowMap::update(const Camera& camera, const DirectionalLight& sunlight, const BoundingBox& scene_bounds)
+{
+	glm::mat4 view_mat = camera.get_view_matrix();
+	glm::mat4 inv_view_mat = glm::inverse(view_mat);
+	const glm::mat4& proj_mat = camera.get_projection_matrix();
+
+	// the scene bounds in camera space limit how far the cascades have to reach
+	glm::vec3 corners[8];
+	for (int i = 0; i < 8; i++)
+	{
+		corners[i] = glm::vec3(i & 1 ? scene_bounds.max.x : scene_bounds.min.x,
+							   i & 2 ? scene_bounds.max.y : scene_bounds.min.y,
+							   i & 4 ? scene_bounds.max.z : scene_bounds.min.z);
+	}
+
+	float scene_far = 0.0f;
+	for (int i = 0; i < 8; i++)
+	{
+		scene_far = std::max(scene_far, -(view_mat * glm::vec4(corners[i], 1.0f)).z);
+	}
+
+	float near_clip = camera.get_near_clip();
+	float far_clip = glm::clamp(scene_far, near_clip * 2.0f, camera.get_far_clip());
+
+	// practical split scheme, a blend of logarithmic and uniform distribution
+	for (int i = 0; i < num_cascades; i++)
+	{
+		float t = (float)(i + 1) / num_cascades;
+		float log_split = near_clip * glm::pow(far_clip / near_clip, t);
+		float uniform_split = near_clip + (far_clip - near_clip) * t;
+		split_distances[i] = split_lambda * log_split + (1.0f - split_lambda) * uniform_split;
+	}
+
+	// every cascade has to be redrawn when the sun moves, or when a dynamic model grew the scene bounds and so the depth range
+	if (sunlight.direction != sun_direction || scene_bounds.min != fit_scene_bounds.min || scene_bounds.max != fit_scene_bounds.max)
+	{
+		sun_direction = sunlight.direction;
+		fit_scene_bounds = scene_bounds;
+		for (int i = 0; i < num_cascades; i++)
+		{
+			static_dirty[i] = true;
+		}
+	}
+
+	// light space looks down the sun direction
+	glm::vec3 up = glm::abs(sunlight.direction.y) > 0.99f ? glm::vec3(0, 0, 1) : glm::vec3(0, 1, 0);
+	glm::mat4 light_view = glm::lookAt(glm::vec3(0), sunlight.direction, up);
+
+	glm::vec3 scene_min = glm::vec3(std::numeric_limits<float>::max());
+	glm::vec3 scene_max = glm::vec3(-std::numeric_limits<float>::max());
+	for (int i = 0; i < 8; i++)
+	{
+		glm::vec3 corner = glm::vec3(light_view * glm::vec4(corners[i], 1.0f));
+		scene_min = glm::min(scene_min, corner);
+		scene_max = glm::max(scene_max, corner);
+	}
+	float scene_extent = std::max(scene_max.x - scene_min.x, scene_max.y - scene_min.y);
+
+	// frustum extents come from the projection matrix itself
+	float tan_half_fov_x = 1.0f / proj_mat[0][0];
+	float tan_half_fov_y = 1.0f / proj_mat[1][1];
+
+	float slice_near = near_clip;
+	for (int i = 0; i < num_cascades; i++)
+	{
+		float slice_far = split_distances[i];
+
+		// bounding sphere of the frustum slice, its size does not change when the camera rotates, so neither does the texel size
+		glm::vec3 slice_corners[8];
+		glm::vec3 slice_center = glm::vec3(0);
+		for (int j = 0; j < 8; j++)
+		{
+			float depth = j & 4 ? slice_far : slice_near;
+			glm::vec3 view_corner = glm::vec3((j & 1 ? 1 : -1) * depth * tan_half_fov_x, (j & 2 ? 1 : -1) * depth * tan_half_fov_y, -depth);
+			slice_corners[j] = glm::vec3(inv_view_mat * glm::vec4(view_corner, 1.0f));
+			slice_center += slice_corners[j] / 8.0f;
+		}
+
+		float radius = 0.0f;
+		for (int j = 0; j < 8; j++)
+		{
+			radius = std::max(radius, glm::length(slice_corners[j] - slice_center));
+		}
+
+		// never cover more than the scene itself
+		float extent = std::min(2.0f * radius, scene_extent);
+		glm::vec3 center = glm::vec3(light_view * glm::vec4(slice_center, 1.0f));
+
+		// the cascade is kept as long as it still contains the part of the slice inside the scene, and is not much bigger than needed
+		bool refit = static_dirty[i] || extent > fit_extents[i] || extent * refit_padding * 2.0f < fit_extents[i];
+		for (int axis = 0; axis < 2 && !refit; axis++)
+		{
+			float needed_low = std::max(center[axis] - radius, scene_min[axis]);
+			float needed_high = std::min(center[axis] + radius, scene_max[axis]);
+			refit = needed_low < fit_centers[i][axis] - fit_extents[i] * 0.5f || needed_high > fit_centers[i][axis] + fit_extents[i] * 0.5f;
+		}
+
+		if (refit)
+		{
+			extent = std::min(extent * refit_padding, scene_extent);
+			float texel_size = extent / resolution;
+
+			for (int axis = 0; axis < 2; axis++)
+			{
+				float low = scene_min[axis] + extent * 0.5f;
+				float high = scene_max[axis] - extent * 0.5f;
+				center[axis] = low <= high ? glm::clamp(center[axis], low, high) : (scene_min[axis] + scene_max[axis]) * 0.5f;
+
+				// move in whole texels only, so the shadow edges do not shimmer when the cascade moves
+				center[axis] = glm::floor(center[axis] / texel_size) * texel_size;
+			}
+
+			fit_centers[i] = center;
+			fit_extents[i] = extent;
+			static_dirty[i] = true;
+		}
+
+		center = fit_centers[i];
+		extent = fit_extents[i];
+
+		// the depth range always covers the whole scene, casters outside the slice still throw shadows into it
+		const float depth_padding = 0.01f * (scene_max.z - scene_min.z) + 0.01f;
+		glm::mat4 light_proj = glm::ortho(center.x - extent * 0.5f, center.x + extent * 0.5f,
+										  center.y - extent * 0.5f, center.y + extent * 0.5f,
+										  -scene_max.z - depth_padding, -scene_min.z + depth_padding);
+		proj_views[i] = light_proj * light_view;
+
+		slice_near = slice_far;
+	}
+}
+
+bool CascadedShadowMap::begin_static_pass()
+{
+	bool dirty = false;
+	for (int i = 0; i < num_cascades; i++)
+	{
+		dirty = dirty || static_dirty[i];
+	}
+
+	if (!dirty)
+	{
+		return false;
+	}
+
+	static_shadow_map.bind_first_pass(false);
+	glDepthMask(GL_TRUE);
+	glEnable(GL_SCISSOR_TEST);
+	return true;
+}
+
+bool CascadedShadowMap::is_static_dirty(int cascade) const
+{
+	return static_dirty[cascade];
+}
+
+void CascadedShadowMap::bind_static_cascade(int cascade)
+{
+	bind_tile(cascade);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void CascadedShadowMap::end_static_pass()
+{
+	for (int i = 0; i < num_cascades; i++)
+	{
+		static_dirty[i] = false;
+	}
+
+	glDisable(GL_SCISSOR_TEST);
+	static_shadow_map.unbind_first_pass();
+}
+
+void CascadedShadowMap::begin_shadow_pass()
+{
+	// blits are affected by the scissor test, so copy before enabling it
+	shadow_map.copy_from(static_shadow_map);
+
+	shadow_map.bind_first_pass(false);
+	glDepthMask(GL_TRUE);
+	glEnable(GL_SCISSOR_TEST);
+}
+
+void CascadedShadowMap::bind_cascade(int cascade)
+{
+	// no clear, the tile already holds the depth of the static casters
+	bind_tile(cascade);
+}
+
+void CascadedShadowMap::end_shadow_pass()
+{
+	glDisable(GL_SCISSOR_TEST);
+	shadow_map.unbind_first_pass();
+}
+
+void CascadedShadowMap::bind_tile(int cascade)
+{
+	int x = (cascade % 2) * resolution;
+	int y = (cascade / 2) * resolution;
+	glViewport(x, y, resolution, resolution);
+	glScissor(x, y, resolution, resolution);
+}
+
+bool CascadedShadowMap::has_dynamic_layer() const
+{
+	return dynamic_layer;
+}
+
+int CascadedShadowMap::get_num_cascades() const
+{
+	return num_cascades;
+}
+
+const glm::mat4& CascadedShadowMap::get_proj_view(int cascade) const
+{
+	return proj_views[cascade];
+}
+
+glm::vec4 CascadedShadowMap::get_tile_transform(int cascade) const
+{
+	float scale_x = (float)resolution / static_shadow_map.get_width();
+	float scale_y = (float)resolution / static_shadow_map.get_height();
+	return glm::vec4((cascade % 2) * scale_x, (cascade / 2) * scale_y, scale_x, scale_y);
+}
+
+float CascadedShadowMap::get_split_distance(int cascade) const
+{
+	return split_distances[cascade];
+}
+
+const ShadowMap& CascadedShadowMap::get_shadow_map() const
+{
+	return dynamic_layer ? shadow_map : static_shadow_map;
+}
+
+const ShadowMap& CascadedShadowMap::get_static_shadow_map() const
+{
+	return static_shadow_map;
+}
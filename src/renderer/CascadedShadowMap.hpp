@@ -0,0 +1,78 @@
+#pragma once
+
+#include "renderer/ShadowMap.hpp"
+#include "renderer/camera.hpp"
+#include "scene/scene.hpp"
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+namespace bey
+{
+	// shadow map of the sunlight, split into cascades along the camera view direction.
+	// every cascade is fitted to its slice of the camera frustum, clipped to the scene bounds, and
+	// gets its own tile of one depth texture (2 cascades side by side, 3 or 4 in a 2x2 grid).
+	// static casters are rendered into their own layer, which is only redrawn when the sun or the scene bounds change or a cascade has to move.
+	// cascades are padded and only refitted when their slice of the frustum leaves them, so the static layer stays valid while the camera moves.
+	// dynamic casters, the models that may move, are drawn every frame over a copy of the static layer
+	class CascadedShadowMap
+	{
+	public:
+		static const int MAX_CASCADES = 4;
+
+		CascadedShadowMap();
+		~CascadedShadowMap();
+
+		// resolution is the size of one cascade. split_lambda blends between uniform (0) and logarithmic (1) split distances
+		// without dynamic casters there is no dynamic layer, and the static layer is sampled directly
+		void initialize(int num_cascades, int resolution, float split_lambda, bool dynamic_casters,
+						ShadowMap::DepthFormat depth_format = ShadowMap::DepthFormat::DEPTH24, bool debug = ShadowMap::default_debug);
+
+		// renders every cascade into only resolution x resolution texels of its tile, up to the resolution it was initialized with.
+		// the cascades are refitted and redrawn on the next update
+		void set_resolution(int resolution);
+		int get_resolution() const;
+
+		// fits the cascades for the current camera, refitted cascades get their static layer invalidated
+		void update(const Camera& camera, const DirectionalLight& sunlight, const BoundingBox& scene_bounds);
+
+		// returns false when no cascade of the static layer has to be redrawn
+		bool begin_static_pass();
+		bool is_static_dirty(int cascade) const;
+		void bind_static_cascade(int cascade);
+		void end_static_pass();
+
+		// copies the static layer into the dynamic layer, the dynamic casters are then drawn on top of it
+		void begin_shadow_pass();
+		void bind_cascade(int cascade);
+		void end_shadow_pass();
+
+		bool has_dynamic_layer() const;
+
+		int get_num_cascades() const;
+		const glm::mat4& get_proj_view(int cascade) const;
+		glm::vec4 get_tile_transform(int cascade) const; // xy : uv offset, zw : uv scale
+		float get_split_distance(int cascade) const; // view depth where the cascade ends
+		const ShadowMap& get_shadow_map() const; // the layer the light pass samples
+		const ShadowMap& get_static_shadow_map() const;
+
+	private:
+		void bind_tile(int cascade);
+
+		ShadowMap shadow_map; // dynamic layer
+		ShadowMap static_shadow_map;
+		bool dynamic_layer;
+		int num_cascades;
+		int resolution;
+		int max_resolution; // the tiles' size in the shadow maps
+		float split_lambda;
+
+		glm::vec3 sun_direction;
+		BoundingBox fit_scene_bounds; // the static layer's depth range covers them
+		bool static_dirty[MAX_CASCADES];
+		glm::vec3 fit_centers[MAX_CASCADES]; // light space
+		float fit_extents[MAX_CASCADES];
+
+		glm::mat4 proj_views[MAX_CASCADES];
+		float split_distances[MAX_CASCADES];
+	};
+}
@@ -0,0 +1,308 @@
+#include "renderer/ClusteredLighting.hpp"
+#include "util/CpuProfiler.hpp"
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <limits>
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define BEY_CLUSTER_SSE
+#include <xmmintrin.h>
+#endif
+#include "renderer/GlStats.hpp"
+
+using namespace bey;
+
+// bit x is set when the sphere's x distance to the box [min_x[x], max_x[x]] is within max_offset_x. the squared distance along y and z
+// is already taken out of max_offset_x, so this is the sphere/box test of every cluster of a row
+static unsigned int intersect_sphere_row(float center_x, float max_offset_x, const float* min_x, const float* max_x, int num_tiles)
+{
+	unsigned int hits = 0;
+#ifdef BEY_CLUSTER_SSE
+	__m128 center = _mm_set1_ps(center_x);
+	__m128 max_offset = _mm_set1_ps(max_offset_x);
+	for (int x = 0; x < num_tiles; x += 4)
+	{
+		__m128 closest = _mm_min_ps(_mm_max_ps(center, _mm_loadu_ps(min_x + x)), _mm_loadu_ps(max_x + x));
+		__m128 offset = _mm_sub_ps(center, closest);
+		hits |= (unsigned int)_mm_movemask_ps(_mm_cmple_ps(_mm_mul_ps(offset, offset), max_offset)) << x;
+	}
+#else
+	for (int x = 0; x < num_tiles; x++)
+	{
+		float offset = center_x - glm::clamp(center_x, min_x[x], max_x[x]);
+		hits |= (unsigned int)(offset * offset <= max_offset_x) << x;
+	}
+#endif
+	return hits;
+}
+
+ClusteredLighting::ClusteredLighting() : num_lights(0), near_clip(0.0f), far_clip(0.0f)
+{
+}
+
+ClusteredLighting::~ClusteredLighting()
+{
+}
+
+void ClusteredLighting::initialize()
+{
+	cluster_data.resize(NUM_CLUSTERS * 2, 0);
+	cluster_rows.resize(TILES_Y * SLICES);
+	cluster_proj_mat = glm::mat4(0.0f);
+
+	light_buffer.initialize(GL_RGBA32F);
+	cluster_buffer.initialize(GL_RG32UI);
+	index_buffer.initialize(GL_R32UI);
+}
+
+void ClusteredLighting::update(const Camera& camera, const Scene& scene, const std::vector<glm::vec4>& spot_shadow_tiles, const std::vector<glm::mat4>& spot_shadow_proj_views,
+							   LightSelection selection)
+{
+	BEY_PROFILE_ZONE("light binning");
+	const glm::mat4& proj_mat = camera.get_projection_matrix();
+	if (proj_mat != cluster_proj_mat || camera.get_near_clip() != near_clip || camera.get_far_clip() != far_clip)
+	{
+		calc_cluster_bounds(proj_mat, camera.get_near_clip(), camera.get_far_clip());
+	}
+
+	glm::mat4 view_mat = camera.get_view_matrix();
+	size_t num_point_lights = scene.num_point_lights();
+	size_t num_spot_lights = scene.num_spot_lights();
+	const PointLight* point_lights = scene.get_point_lights();
+	const SpotLight* spot_lights = scene.get_spot_lights();
+
+	light_data.clear();
+	num_lights = 0;
+
+	// every (cluster, light) pair first, then a counting sort by cluster builds the lists
+	assignments.clear();
+	for (size_t i = 0; i < num_point_lights; i++)
+	{
+		const PointLight& point_light = point_lights[i];
+		if (!is_selected(point_light.low_resolution, selection))
+		{
+			continue;
+		}
+		glm::vec3 view_center = glm::vec3(view_mat * glm::vec4(point_light.position, 1.0f));
+		pack_light(point_light.position, point_light.cutoff, point_light.color, POINT_LIGHT, point_light.Kc, point_light.Kl, point_light.Kq, 1.0f,
+				   glm::vec3(0.0f), -1.0f, glm::vec4(0.0f), glm::mat4());
+		assign_light(num_lights++, view_center, point_light.cutoff, assignments);
+	}
+
+	for (size_t i = 0; i < num_spot_lights; i++)
+	{
+		const SpotLight& spot_light = spot_lights[i];
+		if (!is_selected(spot_light.low_resolution, selection))
+		{
+			continue;
+		}
+		glm::vec3 center;
+		float radius;
+		spot_light.calc_bounding_sphere(center, radius);
+		glm::vec3 view_center = glm::vec3(view_mat * glm::vec4(center, 1.0f));
+
+		glm::vec4 shadow_tile = i < spot_shadow_tiles.size() ? spot_shadow_tiles[i] : glm::vec4(0.0f);
+		glm::mat4 shadow_proj_view = i < spot_shadow_proj_views.size() ? spot_shadow_proj_views[i] : glm::mat4();
+		pack_light(spot_light.position, spot_light.cutoff, spot_light.color, SPOT_LIGHT, spot_light.Kc, spot_light.Kl, spot_light.Kq, spot_light.correction,
+				   spot_light.get_direction(), glm::cos(glm::radians(spot_light.angle)), shadow_tile, shadow_proj_view);
+		assign_light(num_lights++, view_center, radius, assignments);
+	}
+
+	std::fill(cluster_data.begin(), cluster_data.end(), 0);
+	for (size_t i = 0; i < assignments.size(); i++)
+	{
+		cluster_data[assignments[i].first * 2 + 1]++;
+	}
+
+	GLuint offset = 0;
+	for (int i = 0; i < NUM_CLUSTERS; i++)
+	{
+		cluster_data[i * 2] = offset;
+		offset += cluster_data[i * 2 + 1];
+		cluster_data[i * 2 + 1] = 0;
+	}
+
+	light_indices.resize(std::max<size_t>(assignments.size(), 1));
+	for (size_t i = 0; i < assignments.size(); i++)
+	{
+		GLuint* cluster = &cluster_data[assignments[i].first * 2];
+		light_indices[cluster[0] + cluster[1]] = assignments[i].second;
+		cluster[1]++;
+	}
+
+	if (light_data.empty())
+	{
+		light_data.push_back(glm::vec4(0.0f));
+	}
+
+	light_buffer.upload(light_data.data(), light_data.size() * sizeof(glm::vec4));
+	cluster_buffer.upload(cluster_data.data(), cluster_data.size() * sizeof(GLuint));
+	index_buffer.upload(light_indices.data(), light_indices.size() * sizeof(GLuint));
+}
+
+void ClusteredLighting::bind(const Shader& shader, int first_texture_unit) const
+{
+	light_buffer.bind(shader, "u_light_data", first_texture_unit);
+	cluster_buffer.bind(shader, "u_cluster_lists", first_texture_unit + 1);
+	index_buffer.bind(shader, "u_light_indices", first_texture_unit + 2);
+
+	GLint uni_cluster_grid = glGetUniformLocation(shader.program, "u_cluster_grid");
+	if (uni_cluster_grid != -1)
+	{
+		glUniform3i(uni_cluster_grid, TILES_X, TILES_Y, SLICES);
+	}
+
+	// slice = log(view_depth / near) * slice_scale
+	GLint uni_cluster_depth = glGetUniformLocation(shader.program, "u_cluster_depth");
+	if (uni_cluster_depth != -1)
+	{
+		glUniform2f(uni_cluster_depth, near_clip, SLICES / glm::log(far_clip / near_clip));
+	}
+}
+
+int ClusteredLighting::get_num_lights() const
+{
+	return num_lights;
+}
+
+size_t ClusteredLighting::get_num_light_indices() const
+{
+	size_t num_indices = 0;
+	for (int i = 0; i < NUM_CLUSTERS; i++)
+	{
+		num_indices += cluster_data[i * 2 + 1];
+	}
+	return num_indices;
+}
+
+void ClusteredLighting::calc_cluster_bounds(const glm::mat4& proj_mat, float near_clip, float far_clip)
+{
+	cluster_proj_mat = proj_mat;
+	this->near_clip = near_clip;
+	this->far_clip = far_clip;
+
+	// frustum extents come from the projection matrix itself
+	tan_half_fov_x = 1.0f / proj_mat[0][0];
+	tan_half_fov_y = 1.0f / proj_mat[1][1];
+
+	for (int z = 0; z < SLICES; z++)
+	{
+		float slice_near = near_clip * glm::pow(far_clip / near_clip, (float)z / SLICES);
+		float slice_far = near_clip * glm::pow(far_clip / near_clip, (float)(z + 1) / SLICES);
+
+		for (int y = 0; y < TILES_Y; y++)
+		{
+			ClusterRow& row = cluster_rows[z * TILES_Y + y];
+			float ndc_y[2] = { 2.0f * y / TILES_Y - 1.0f, 2.0f * (y + 1) / TILES_Y - 1.0f };
+			float depths[2] = { slice_near, slice_far };
+			for (int x = 0; x < TILES_X; x++)
+			{
+				float ndc_x[2] = { 2.0f * x / TILES_X - 1.0f, 2.0f * (x + 1) / TILES_X - 1.0f };
+
+				glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+				glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+				for (int i = 0; i < 8; i++)
+				{
+					float depth = depths[(i >> 2) & 1];
+					glm::vec3 corner = glm::vec3(ndc_x[i & 1] * depth * tan_half_fov_x, ndc_y[(i >> 1) & 1] * depth * tan_half_fov_y, -depth);
+					min = glm::min(min, corner);
+					max = glm::max(max, corner);
+				}
+				row.min_x[x] = min.x;
+				row.max_x[x] = max.x;
+				row.min_yz = glm::vec2(min.y, min.z);
+				row.max_yz = glm::vec2(max.y, max.z);
+			}
+		}
+	}
+}
+
+bool ClusteredLighting::is_selected(bool low_resolution, LightSelection selection)
+{
+	return selection == LightSelection::ALL || low_resolution == (selection == LightSelection::LOW_RESOLUTION);
+}
+
+int ClusteredLighting::calc_slice(float view_depth) const
+{
+	if (view_depth <= near_clip)
+	{
+		return 0;
+	}
+	int slice = (int)(glm::log(view_depth / near_clip) * SLICES / glm::log(far_clip / near_clip));
+	return glm::clamp(slice, 0, SLICES - 1);
+}
+
+void ClusteredLighting::assign_light(int light_index, const glm::vec3& view_center, float radius, std::vector<std::pair<int, int> >& assignments) const
+{
+	float depth = -view_center.z;
+	if (depth + radius < near_clip || depth - radius > far_clip)
+	{
+		return;
+	}
+
+	int slice_begin = calc_slice(depth - radius);
+	int slice_end = calc_slice(depth + radius);
+
+	// screen rectangle of the sphere's box. a sphere that crosses the near plane may cover any tile
+	int tile_begin_x = 0, tile_end_x = TILES_X - 1;
+	int tile_begin_y = 0, tile_end_y = TILES_Y - 1;
+	if (depth - radius > near_clip)
+	{
+		glm::vec2 ndc_min = glm::vec2(std::numeric_limits<float>::max());
+		glm::vec2 ndc_max = glm::vec2(-std::numeric_limits<float>::max());
+		for (int i = 0; i < 8; i++)
+		{
+			glm::vec3 corner = view_center + glm::vec3(i & 1 ? radius : -radius, i & 2 ? radius : -radius, i & 4 ? radius : -radius);
+			glm::vec2 ndc = glm::vec2(corner.x / (-corner.z * tan_half_fov_x), corner.y / (-corner.z * tan_half_fov_y));
+			ndc_min = glm::min(ndc_min, ndc);
+			ndc_max = glm::max(ndc_max, ndc);
+		}
+
+		if (ndc_max.x < -1.0f || ndc_min.x > 1.0f || ndc_max.y < -1.0f || ndc_min.y > 1.0f)
+		{
+			return;
+		}
+
+		tile_begin_x = glm::clamp((int)((ndc_min.x * 0.5f + 0.5f) * TILES_X), 0, TILES_X - 1);
+		tile_end_x = glm::clamp((int)((ndc_max.x * 0.5f + 0.5f) * TILES_X), 0, TILES_X - 1);
+		tile_begin_y = glm::clamp((int)((ndc_min.y * 0.5f + 0.5f) * TILES_Y), 0, TILES_Y - 1);
+		tile_end_y = glm::clamp((int)((ndc_max.y * 0.5f + 0.5f) * TILES_Y), 0, TILES_Y - 1);
+	}
+
+	glm::vec2 center_yz = glm::vec2(view_center.y, view_center.z);
+	for (int z = slice_begin; z <= slice_end; z++)
+	{
+		for (int y = tile_begin_y; y <= tile_end_y; y++)
+		{
+			const ClusterRow& row = cluster_rows[z * TILES_Y + y];
+			glm::vec2 offset_yz = center_yz - glm::clamp(center_yz, row.min_yz, row.max_yz);
+			float max_offset_x = radius * radius - glm::dot(offset_yz, offset_yz);
+			if (max_offset_x < 0.0f)
+			{
+				continue;
+			}
+
+			unsigned int hits = intersect_sphere_row(view_center.x, max_offset_x, row.min_x, row.max_x, TILES_X);
+			for (int x = tile_begin_x; x <= tile_end_x; x++)
+			{
+				if (hits & (1u << x))
+				{
+					assignments.push_back(std::make_pair((z * TILES_Y + y) * TILES_X + x, light_index));
+				}
+			}
+		}
+	}
+}
+
+void ClusteredLighting::pack_light(const glm::vec3& position, float radius, const glm::vec3& color, LightType type, float Kc, float Kl, float Kq, float correction,
+								   const glm::vec3& direction, float cos_angle, const glm::vec4& shadow_tile, const glm::mat4& shadow_proj_view)
+{
+	light_data.push_back(glm::vec4(position, radius));
+	light_data.push_back(glm::vec4(color, (float)type));
+	light_data.push_back(glm::vec4(Kc, Kl, Kq, correction));
+	light_data.push_back(glm::vec4(direction, cos_angle));
+	light_data.push_back(shadow_tile);
+	for (int i = 0; i < 4; i++)
+	{
+		light_data.push_back(shadow_proj_view[i]);
+	}
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "renderer/Shader.hpp"
+#include "renderer/camera.hpp"
+#include "renderer/TextureBuffer.hpp"
+#include "scene/scene.hpp"
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace bey
+{
+	// light culling for the clustered light path. the view frustum is split into clusters (screen tiles x exponential depth slices),
+	// every point and spot light is assigned on the cpu to the clusters its bounding sphere touches, and a single full screen pass
+	// shades each pixel with the light list of its cluster. light data and cluster lists live in texture buffers
+	class ClusteredLighting
+	{
+	public:
+		static const int TILES_X = 16;
+		static const int TILES_Y = 9;
+		static const int SLICES = 24;
+		static const int NUM_CLUSTERS = TILES_X * TILES_Y * SLICES;
+		static_assert(TILES_X % 4 == 0 && TILES_X <= 32, "a row of tiles is tested 4 at a time, into a 32 bit mask");
+		static const int LIGHT_TEXELS = 9; // rgba32f texels per light, see pack_light
+
+		enum LightType
+		{
+			POINT_LIGHT = 0,
+			SPOT_LIGHT,
+		};
+
+		// which lights update assigns, by their low_resolution flag
+		enum class LightSelection
+		{
+			ALL = 0,
+			FULL_RESOLUTION,
+			LOW_RESOLUTION,
+		};
+
+		ClusteredLighting();
+		~ClusteredLighting();
+
+		void initialize();
+
+		// assigns the lights to the clusters and uploads them. spot_shadow_tiles and spot_shadow_proj_views have one entry per spot light,
+		// a tile with zero size means the spot light has no shadow
+		void update(const Camera& camera, const Scene& scene, const std::vector<glm::vec4>& spot_shadow_tiles, const std::vector<glm::mat4>& spot_shadow_proj_views,
+					LightSelection selection = LightSelection::ALL);
+
+		// binds the light data, the cluster lists and the grid uniforms, starting from first_texture_unit
+		void bind(const Shader& shader, int first_texture_unit) const;
+
+		int get_num_lights() const;
+		size_t get_num_light_indices() const; // sum of the light list sizes of all clusters
+
+	private:
+		// the clusters of one slice and one tile row share their y and z extents in view space, only x varies along the row.
+		// the x extents are kept apart so a light is tested against 4 clusters of a row at once
+		struct ClusterRow
+		{
+			float min_x[TILES_X];
+			float max_x[TILES_X];
+			glm::vec2 min_yz;
+			glm::vec2 max_yz;
+		};
+
+		void calc_cluster_bounds(const glm::mat4& proj_mat, float near_clip, float far_clip);
+		int calc_slice(float view_depth) const;
+		static bool is_selected(bool low_resolution, LightSelection selection);
+		void assign_light(int light_index, const glm::vec3& view_center, float radius, std::vector<std::pair<int, int> >& assignments) const;
+		void pack_light(const glm::vec3& position, float radius, const glm::vec3& color, LightType type, float Kc, float Kl, float Kq, float correction,
+						const glm::vec3& direction, float cos_angle, const glm::vec4& shadow_tile, const glm::mat4& shadow_proj_view);
+
+		TextureBuffer light_buffer;
+		TextureBuffer cluster_buffer;
+		TextureBuffer index_buffer;
+
+		std::vector<glm::vec4> light_data;
+		std::vector<GLuint> cluster_data; // offset and count into light_indices for every cluster
+		std::vector<GLuint> light_indices;
+		std::vector<std::pair<int, int> > assignments; // (cluster, light) pairs, kept between frames so their storage is reused
+		int num_lights;
+
+		// cluster boxes in view space, one row per slice and tile row, only rebuilt when the projection changes
+		std::vector<ClusterRow> cluster_rows;
+		glm::mat4 cluster_proj_mat;
+		float near_clip;
+		float far_clip;
+		float tan_half_fov_x;
+		float tan_half_fov_y;
+	};
+}
@@ -0,0 +1,85 @@
+#include "renderer/Frustum.hpp"
+
+using namespace bey;
+
+Frustum::Frustum()
+{
+}
+
+Frustum::Frustum(const glm::mat4& proj_view)
+{
+	set(proj_view);
+}
+
+void Frustum::set(const glm::mat4& proj_view)
+{
+	// glm is column major, so row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+	glm::vec4 row_x = glm::vec4(proj_view[0][0], proj_view[1][0], proj_view[2][0], proj_view[3][0]);
+	glm::vec4 row_y = glm::vec4(proj_view[0][1], proj_view[1][1], proj_view[2][1], proj_view[3][1]);
+	glm::vec4 row_z = glm::vec4(proj_view[0][2], proj_view[1][2], proj_view[2][2], proj_view[3][2]);
+	glm::vec4 row_w = glm::vec4(proj_view[0][3], proj_view[1][3], proj_view[2][3], proj_view[3][3]);
+
+	planes[PLANE_LEFT] = row_w + row_x;
+	planes[PLANE_RIGHT] = row_w - row_x;
+	planes[PLANE_BOTTOM] = row_w + row_y;
+	planes[PLANE_TOP] = row_w - row_y;
+	planes[PLANE_NEAR] = row_w + row_z;
+	planes[PLANE_FAR] = row_w - row_z;
+
+	for (int i = 0; i < NUM_PLANES; i++)
+	{
+		planes[i] /= glm::length(glm::vec3(planes[i]));
+	}
+}
+
+bool Frustum::intersect_sphere(const glm::vec3& center, float radius) const
+{
+	for (int i = 0; i < NUM_PLANES; i++)
+	{
+		if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Frustum::intersect_box(const BoundingBox& box) const
+{
+	for (int i = 0; i < NUM_PLANES; i++)
+	{
+		// the corner of the box furthest along the plane normal
+		glm::vec3 normal = glm::vec3(planes[i]);
+		glm::vec3 corner = glm::vec3(normal.x >= 0 ? box.max.x : box.min.x,
+									 normal.y >= 0 ? box.max.y : box.min.y,
+									 normal.z >= 0 ? box.max.z : box.min.z);
+		if (glm::dot(normal, corner) + planes[i].w < 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Frustum::intersect_cone(const glm::vec3& apex, const glm::vec3& direction, float height, float base_radius) const
+{
+	glm::vec3 cap_center = apex + direction * height;
+	for (int i = 0; i < NUM_PLANES; i++)
+	{
+		// the cone is outside when both its tip and the point of its cap furthest along the plane normal are
+		glm::vec3 normal = glm::vec3(planes[i]);
+		glm::vec3 cap_dir = normal - direction * glm::dot(normal, direction);
+		float cap_dir_length = glm::length(cap_dir);
+		glm::vec3 cap_point = cap_dir_length > 0.0f ? cap_center + cap_dir * (base_radius / cap_dir_length) : cap_center;
+		if (glm::dot(normal, apex) + planes[i].w < 0 && glm::dot(normal, cap_point) + planes[i].w < 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+const glm::vec4& Frustum::get_plane(PlaneType plane_type) const
+{
+	return planes[plane_type];
+}
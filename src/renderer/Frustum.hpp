@@ -0,0 +1,37 @@
+#pragma once
+
+#include "scene/scene.hpp"
+#include <glm/glm.hpp>
+
+namespace bey
+{
+	// the six planes of a view volume, extracted from a projection * view matrix.
+	// every plane's normal points into the volume
+	class Frustum
+	{
+	public:
+		enum PlaneType
+		{
+			PLANE_LEFT = 0,
+			PLANE_RIGHT,
+			PLANE_BOTTOM,
+			PLANE_TOP,
+			PLANE_NEAR,
+			PLANE_FAR,
+			NUM_PLANES,
+		};
+
+		Frustum();
+		Frustum(const glm::mat4& proj_view);
+
+		void set(const glm::mat4& proj_view);
+		bool intersect_sphere(const glm::vec3& center, float radius) const;
+		bool intersect_box(const BoundingBox& box) const;
+		// cone with its tip at apex, opening along the normalized direction up to a cap of base_radius at height
+		bool intersect_cone(const glm::vec3& apex, const glm::vec3& direction, float height, float base_radius) const;
+		const glm::vec4& get_plane(PlaneType plane_type) const;
+
+	private:
+		glm::vec4 planes[NUM_PLANES]; // xyz : normal, w : distance
+	};
+}
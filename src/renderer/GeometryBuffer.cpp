@@ -1,9 +1,40 @@
 #include "renderer/GeometryBuffer.hpp"
 #include <iostream>
+#include "renderer/GlStats.hpp"
 
 using namespace bey;
 
-GeometryBuffer::GeometryBuffer()
+// depth is sampled from its own texture unit, after the ones of the targets
+static const int depth_texture_unit = GeometryBuffer::NUM_TEXTURES;
+
+struct TargetFormat
+{
+	GLenum internal_format; // GL_NONE when the target is not allocated
+	int bytes_per_pixel;
+};
+
+static TargetFormat get_target_format(GeometryBuffer::TextureType texture_type, bool compact)
+{
+	if (!compact)
+	{
+		return TargetFormat { GL_RGBA32F, 16 };
+	}
+
+	switch (texture_type)
+	{
+	case GeometryBuffer::DIFFUSE:
+	case GeometryBuffer::SPECULAR:
+		return TargetFormat { GL_RGBA8, 4 };
+	case GeometryBuffer::NORMAL:
+		return TargetFormat { GL_RG16, 4 };
+	case GeometryBuffer::LIGHT_ACCUMULATION:
+		return TargetFormat { GL_RGBA16F, 8 };
+	default:
+		return TargetFormat { GL_NONE, 0 };
+	}
+}
+
+GeometryBuffer::GeometryBuffer() : sun_light(false)
 {
 }
 
@@ -11,9 +42,18 @@ GeometryBuffer::~GeometryBuffer()
 {
 }
 
-void GeometryBuffer::initialize(int screen_width, int screen_height)
+void GeometryBuffer::initialize(int screen_width, int screen_height, bool compact)
 {
-	shader.load_shader_program("../../shaders/geometry_pass.vs", "../../shaders/geometry_pass.fs");
+	this->compact = compact;
+	width = screen_width;
+	height = screen_height;
+
+	ShaderDefines sun_light_defines;
+	sun_light_defines.set("SUN_LIGHT");
+	shader.begin_load_shader_program("../../shaders/geometry_pass.vs", "../../shaders/geometry_pass.fs");
+	sun_light_shader.begin_load_shader_program("../../shaders/geometry_pass.vs", "../../shaders/geometry_pass.fs", sun_light_defines);
+	shader.finish_load_shader_program();
+	sun_light_shader.finish_load_shader_program();
 
 	// Create the FBO for geometry buffer
 	glGenFramebuffers(1, &geometry_buffer_fbo_id);
@@ -22,25 +62,35 @@ void GeometryBuffer::initialize(int screen_width, int screen_height)
 	// Create the gbuffer textures
 	glGenTextures(NUM_TEXTURES, texture_ids);
 	glGenTextures(1, &depth_id);
+	glGenTextures(1, &depth_copy_id);
 
 	for (unsigned int i = 0; i < NUM_TEXTURES; i++)
 	{
+		// targets the compact layout does not need keep their attachment index, but get no texture and no draw buffer
+		TargetFormat format = get_target_format((TextureType)i, compact);
+		if (format.internal_format == GL_NONE)
+		{
+			glDeleteTextures(1, &texture_ids[i]);
+			texture_ids[i] = 0;
+			draw_buffers[i] = GL_NONE;
+			continue;
+		}
+
 		glBindTexture(GL_TEXTURE_2D, texture_ids[i]);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, screen_width, screen_height, 0, GL_RGBA, GL_FLOAT, nullptr);
 		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, texture_ids[i], 0);
+		draw_buffers[i] = GL_COLOR_ATTACHMENT0 + i;
 	}
 
-	// depth for geometry buffer
+	// depth for geometry buffer. the compact layout samples it to reconstruct the position
 	glBindTexture(GL_TEXTURE_2D, depth_id);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH32F_STENCIL8, screen_width, screen_height, 0, GL_DEPTH_STENCIL, GL_FLOAT_32_UNSIGNED_INT_24_8_REV, nullptr);
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depth_id, 0);
 
-	for (int i = 0; i < NUM_TEXTURES; i++)
-	{
-		draw_buffers[i] = GL_COLOR_ATTACHMENT0 + i;
-	}
+	allocate_textures();
+
 	glDrawBuffers(NUM_TEXTURES, draw_buffers);	
 
 	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
@@ -51,10 +101,55 @@ void GeometryBuffer::initialize(int screen_width, int screen_height)
 		return;
 	}
 
+	// the copy has the same format, a depth blit needs it
+	glGenFramebuffers(1, &depth_copy_fbo_id);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, depth_copy_fbo_id);
+	glBindTexture(GL_TEXTURE_2D, depth_copy_id);
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depth_copy_id, 0);
+	glDrawBuffer(GL_NONE);
+
+	status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		std::cerr << "FB error, status: 0x" << status << std::endl;
+		exit(EXIT_FAILURE);
+		return;
+	}
+
 	// restore default FBO
 	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 }
 
+void GeometryBuffer::resize(int screen_width, int screen_height)
+{
+	width = screen_width;
+	height = screen_height;
+	allocate_textures();
+}
+
+void GeometryBuffer::allocate_textures()
+{
+	// the attachments keep their texture names, only the storage is replaced
+	for (unsigned int i = 0; i < NUM_TEXTURES; i++)
+	{
+		TargetFormat format = get_target_format((TextureType)i, compact);
+		if (format.internal_format == GL_NONE)
+		{
+			continue;
+		}
+
+		glBindTexture(GL_TEXTURE_2D, texture_ids[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, format.internal_format, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, depth_id);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH32F_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_FLOAT_32_UNSIGNED_INT_24_8_REV, nullptr);
+	glBindTexture(GL_TEXTURE_2D, depth_copy_id);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH32F_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_FLOAT_32_UNSIGNED_INT_24_8_REV, nullptr);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
 void GeometryBuffer::bind_texture(const Shader* shader, const GLchar* uniform_name, GeometryBuffer::TextureType texture_type)
 {
 	GLuint uniform_location = glGetUniformLocation(shader->program, uniform_name);
@@ -73,21 +168,86 @@ void GeometryBuffer::bind(BindType bind_type, const Shader* light_shader)
 	{
 		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, geometry_buffer_fbo_id);
 		setup_draw_buffers();		
-		shader.bind();
+		const Shader* geometry_shader = get_geometry_pass_shader();
+		geometry_shader->bind();
+
+		GLint uni_compact = glGetUniformLocation(geometry_shader->program, "u_compact_g_buffer");
+		if (uni_compact != -1)
+		{
+			glUniform1i(uni_compact, compact);
+		}
 	}
 	else if (bind_type == BindType::READ_AND_WRITE)
 	{
 		glBindFramebuffer(GL_FRAMEBUFFER, geometry_buffer_fbo_id);
-		setup_draw_buffers();
+		// the light shaders only output the light accumulation. with every target enabled, the other
+		// outputs would be undefined and get blended into the targets the next lights read
+		setup_light_draw_buffer();
 		shader.bind();
 	}
 }
 
+void GeometryBuffer::bind_light_pass_textures(const Shader* shader)
+{
+	GLint uni_compact = glGetUniformLocation(shader->program, "u_compact_g_buffer");
+	if (uni_compact != -1)
+	{
+		glUniform1i(uni_compact, compact);
+	}
+
+	// depth is read by the compact layout, and by shaders that have to skip the background. sampling the attached depth would be a
+	// feedback loop, the light passes depth test and write stencil into it
+	GLint uni_depth = glGetUniformLocation(shader->program, "u_g_depth");
+	if (uni_depth != -1)
+	{
+		glUniform1i(uni_depth, depth_texture_unit);
+		glActiveTexture(GL_TEXTURE0 + depth_texture_unit);
+		glBindTexture(GL_TEXTURE_2D, depth_copy_id);
+	}
+
+	if (!compact)
+	{
+		bind_texture(shader, "u_g_position", TextureType::POSITION);
+	}
+
+	bind_texture(shader, "u_g_specular", TextureType::SPECULAR);
+	bind_texture(shader, "u_g_diffuse", TextureType::DIFFUSE);
+	bind_texture(shader, "u_g_normal", TextureType::NORMAL);
+}
+
+void GeometryBuffer::copy_depth()
+{
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, geometry_buffer_fbo_id);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, depth_copy_fbo_id);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+}
+
 void GeometryBuffer::setup_draw_buffers()
 {
 	glDrawBuffers(NUM_TEXTURES, draw_buffers);
 }
 
+void GeometryBuffer::setup_light_draw_buffer()
+{
+	// the light shaders write to location 5, so the other draw buffers are kept but disabled
+	GLenum light_draw_buffers[NUM_TEXTURES];
+	for (int i = 0; i < NUM_TEXTURES; i++)
+	{
+		light_draw_buffers[i] = GL_NONE;
+	}
+	light_draw_buffers[LIGHT_ACCUMULATION] = GL_COLOR_ATTACHMENT0 + LIGHT_ACCUMULATION;
+	glDrawBuffers(NUM_TEXTURES, light_draw_buffers);
+}
+
+void GeometryBuffer::clear_light_accumulation()
+{
+	// the light draw buffers map draw buffer LIGHT_ACCUMULATION to its attachment
+	const GLfloat black[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	glClearBufferfv(GL_COLOR, LIGHT_ACCUMULATION, black);
+}
+
 void GeometryBuffer::unbind(BindType bind_type)
 {
 	if (bind_type == BindType::READ)
@@ -137,5 +297,50 @@ void GeometryBuffer::dump_geometry_buffer(int screen_width, int screen_height)
 
 const Shader* GeometryBuffer::get_geometry_pass_shader() const
 {
-	return &shader;
-}
\ No newline at end of file
+	return sun_light ? &sun_light_shader : &shader;
+}
+
+void GeometryBuffer::set_sun_light(bool sun_light)
+{
+	this->sun_light = sun_light;
+}
+
+bool GeometryBuffer::has_sun_light() const
+{
+	return sun_light;
+}
+
+bool GeometryBuffer::is_compact() const
+{
+	return compact;
+}
+
+GLuint GeometryBuffer::get_depth_texture_id() const
+{
+	return depth_id;
+}
+
+int GeometryBuffer::get_width() const
+{
+	return width;
+}
+
+int GeometryBuffer::get_height() const
+{
+	return height;
+}
+
+size_t GeometryBuffer::get_memory_size() const
+{
+	return calc_memory_size(width, height, compact);
+}
+
+size_t GeometryBuffer::calc_memory_size(int width, int height, bool compact)
+{
+	size_t bytes_per_pixel = 16; // depth32f stencil8 and its copy, padded
+	for (int i = 0; i < NUM_TEXTURES; i++)
+	{
+		bytes_per_pixel += get_target_format((TextureType)i, compact).bytes_per_pixel;
+	}
+	return bytes_per_pixel * width * height;
+}
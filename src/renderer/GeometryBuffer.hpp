@@ -11,6 +11,9 @@ namespace bey
 		GeometryBuffer();
 		~GeometryBuffer();
 
+		// in the compact layout there is no position (it is reconstructed from depth) and no texcoord target,
+		// normals are octahedral encoded in RG16, diffuse and specular are RGBA8 and the specular power is packed in specular's alpha.
+		// with depth and its copy that is 36 bytes per pixel against 112 for the full layout, 71.2 MB against 221.5 MB at 1080p
 		enum TextureType
 		{
 			POSITION = 0,
@@ -29,20 +32,48 @@ namespace bey
 			READ_AND_WRITE,			
 		};
 
-		void initialize(int screen_width, int screen_height);
+		void initialize(int screen_width, int screen_height, bool compact = true);
+		// reallocates every target at the new size, their content is lost
+		void resize(int screen_width, int screen_height);
 		void bind(BindType bind_type, const Shader* shader = nullptr);
 		void unbind(BindType bind_type);
 		void set_read_buffer(TextureType texture_type);
 		void dump_geometry_buffer(int screen_width, int screen_height);
 		const Shader* get_geometry_pass_shader() const;
+		// the geometry pass also lights every pixel with the sun, writing the light accumulation target instead of clearing it
+		void set_sun_light(bool sun_light);
+		bool has_sun_light() const;
 		void bind_texture(const Shader* shader, const GLchar* uniform_name, GeometryBuffer::TextureType texture_type);
+		// binds every target a light shader reads, in either layout. depth is the copy of the last copy_depth
+		void bind_light_pass_textures(const Shader* shader);
+		// copies depth for the light passes, after the geometry pass. they sample it while the stencil passes write to the attached one
+		void copy_depth();
 
 		void setup_draw_buffers();
+		void setup_light_draw_buffer(); // light passes only write to the light accumulation target
+		// clears only the light accumulation target, while bound for the light passes. the other targets keep the last geometry pass
+		void clear_light_accumulation();
+
+		bool is_compact() const;
+		GLuint get_depth_texture_id() const; // depth and stencil, shared with the visibility buffer
+		int get_width() const;
+		int get_height() const;
+		size_t get_memory_size() const; // bytes used by all targets, including depth and its copy
+		static size_t calc_memory_size(int width, int height, bool compact);
 	private:
+		void allocate_textures(); // storage of the targets and of depth, at width x height
+
+		bool compact;
+		int width;
+		int height;
 		GLuint geometry_buffer_fbo_id;
 		GLuint depth_id;	
+		GLuint depth_copy_fbo_id;
+		GLuint depth_copy_id; // what the light passes sample, never attached to the geometry buffer
 		GLuint uni_texture_ids[(unsigned int)TextureType::NUM_TEXTURES];
 		Shader shader;
+		Shader sun_light_shader; // geometry_pass compiled with SUN_LIGHT
+		bool sun_light;
 		GLuint texture_ids[(unsigned int)TextureType::NUM_TEXTURES];
 		GLenum draw_buffers[NUM_TEXTURES];
 
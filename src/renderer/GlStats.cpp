@@ -0,0 +1,121 @@
+#include "renderer/GlStats.hpp"
+#include <iomanip>
+
+using namespace bey;
+
+static const char* call_names[] = { "draws", "buffer binds", "buffer uploads", "program binds", "texture binds", "uniforms", "uniform lookups",
+	"framebuffer binds", "clears", "blits", "queries", "state changes" };
+static const char* call_short_names[] = { "draw", "buffer", "upload", "program", "texture", "uniform", "lookup", "fbo", "clear", "blit", "query",
+	"state" };
+
+GlStats::Counts GlStats::current[GlStats::NUM_SECTIONS];
+GlStats::Counts GlStats::last[GlStats::NUM_SECTIONS];
+GlStats::Counts GlStats::last_frame;
+int GlStats::section = GlStats::NUM_SECTIONS - 1;
+int GlStats::depth = 0;
+
+GlStats::Counts::Counts()
+{
+	for (int i = 0; i < (int)Call::NUM_CALLS; i++)
+	{
+		calls[i] = 0;
+	}
+}
+
+int GlStats::Counts::get_total() const
+{
+	int total = 0;
+	for (int i = 0; i < (int)Call::NUM_CALLS; i++)
+	{
+		total += calls[i];
+	}
+	return total;
+}
+
+GlStats::Counts& GlStats::Counts::operator+=(const Counts& counts)
+{
+	for (int i = 0; i < (int)Call::NUM_CALLS; i++)
+	{
+		calls[i] += counts.calls[i];
+	}
+	return *this;
+}
+
+bool GlStats::is_compiled()
+{
+#ifdef BEY_GL_STATS
+	return true;
+#else
+	return false;
+#endif
+}
+
+void GlStats::end_frame()
+{
+#ifdef BEY_GL_STATS
+	last_frame = Counts();
+	for (int i = 0; i < NUM_SECTIONS; i++)
+	{
+		last[i] = current[i];
+		last_frame += current[i];
+	}
+#endif
+}
+
+const GlStats::Counts& GlStats::get_frame()
+{
+	return last_frame;
+}
+
+const GlStats::Counts& GlStats::get_pass(GpuProfiler::Pass pass)
+{
+	return last[(int)pass];
+}
+
+const GlStats::Counts& GlStats::get_other()
+{
+	return last[NUM_SECTIONS - 1];
+}
+
+void GlStats::print(std::ostream& out)
+{
+	out << "gl calls of the last frame" << std::endl;
+	out << "  " << std::left << std::setw(18) << "pass" << std::right;
+	for (int i = 0; i < (int)Call::NUM_CALLS; i++)
+	{
+		out << std::setw(9) << call_short_names[i];
+	}
+	out << std::setw(9) << "total" << std::endl;
+
+	for (int i = 0; i <= NUM_SECTIONS; i++)
+	{
+		const Counts& counts = i < NUM_SECTIONS ? last[i] : last_frame;
+		if (i < NUM_SECTIONS && counts.get_total() == 0)
+		{
+			continue;
+		}
+
+		const char* name = i < NUM_SECTIONS - 1 ? GpuProfiler::get_pass_name((GpuProfiler::Pass)i) : (i == NUM_SECTIONS - 1 ? "other" : "frame");
+		out << "  " << std::left << std::setw(18) << name << std::right;
+		for (int j = 0; j < (int)Call::NUM_CALLS; j++)
+		{
+			out << std::setw(9) << counts.calls[j];
+		}
+		out << std::setw(9) << counts.get_total() << std::endl;
+	}
+}
+
+void GlStats::print_frame(std::ostream& out)
+{
+	out << "gl calls : " << last_frame.get_total();
+	for (int i = 0; i < (int)Call::NUM_CALLS; i++)
+	{
+		out << (i == 0 ? " (" : ", ") << last_frame.calls[i] << " " << call_names[i];
+	}
+	out << ")" << std::endl;
+}
+
+const char* GlStats::get_call_name(Call call)
+{
+	return call_names[(int)call];
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include "renderer/GpuProfiler.hpp"
+#include <GL/glew.h>
+#include <ostream>
+
+namespace bey
+{
+	// how many draws, binds, uniform uploads and lookups, clears, queries and state changes the renderer issues, per pass and per frame.
+	// the gl calls of the files that include this header last are counted through the macros at its end, which only exist with
+	// BEY_GL_STATS. without it nothing is counted and the functions below that run every frame are empty
+	class GlStats
+	{
+	public:
+		enum class Call
+		{
+			DRAW = 0,
+			BUFFER_BIND,
+			BUFFER_UPLOAD,
+			PROGRAM_BIND,
+			TEXTURE_BIND,
+			UNIFORM,
+			UNIFORM_LOOKUP, // glGetUniformLocation
+			FRAMEBUFFER_BIND,
+			CLEAR,
+			BLIT,
+			QUERY, // begin and end of the timer and occlusion queries
+			// enables, masks, depth, blend and stencil functions, viewport, scissor, draw buffers, active texture, vertex attributes,
+			// texture buffer storage
+			STATE,
+			NUM_CALLS,
+		};
+
+		// a section for each pass, the last one has the calls of the frame outside of any pass
+		static const int NUM_SECTIONS = (int)GpuProfiler::Pass::NUM_PASSES + 1;
+
+		struct Counts
+		{
+			int calls[(int)Call::NUM_CALLS];
+
+			Counts();
+			int get_total() const;
+			Counts& operator+=(const Counts& counts);
+		};
+
+		static bool is_compiled();
+
+		// a frame goes from begin_frame to end_frame. the calls between two frames, of the renderer's update and of the passes
+		// the benchmarks time on their own, are not counted
+		static void begin_frame();
+		static void end_frame();
+		// like the gpu profiler's sections, a pass begun inside another one is part of the outer pass
+		static void begin(GpuProfiler::Pass pass);
+		static void end();
+		static void count(Call call);
+
+		// of the last frame
+		static const Counts& get_frame();
+		static const Counts& get_pass(GpuProfiler::Pass pass);
+		static const Counts& get_other();
+
+		static void print(std::ostream& out); // the last frame's calls of each pass
+		static void print_frame(std::ostream& out); // the last frame's calls, on one line
+
+		static const char* get_call_name(Call call);
+
+	private:
+		static Counts current[NUM_SECTIONS];
+		static Counts last[NUM_SECTIONS];
+		static Counts last_frame;
+		static int section;
+		static int depth;
+	};
+
+	inline void GlStats::begin_frame()
+	{
+#ifdef BEY_GL_STATS
+		for (int i = 0; i < NUM_SECTIONS; i++)
+		{
+			current[i] = Counts();
+		}
+		section = NUM_SECTIONS - 1;
+		depth = 0;
+#endif
+	}
+
+	inline void GlStats::begin(GpuProfiler::Pass pass)
+	{
+#ifdef BEY_GL_STATS
+		if (depth++ == 0)
+		{
+			section = (int)pass;
+		}
+#else
+		(void)pass;
+#endif
+	}
+
+	inline void GlStats::end()
+	{
+#ifdef BEY_GL_STATS
+		if (depth > 0 && --depth == 0)
+		{
+			section = NUM_SECTIONS - 1;
+		}
+#endif
+	}
+
+	inline void GlStats::count(Call call)
+	{
+		current[section].calls[(int)call]++;
+	}
+}
+
+#ifdef BEY_GL_STATS
+#define BEY_GL_COUNTED(call, expression) (bey::GlStats::count(bey::GlStats::Call::call), expression)
+
+//gl 1.1 functions are declared as functions, the name inside their own macro is not expanded again
+#define glDrawArrays(...) BEY_GL_COUNTED(DRAW, glDrawArrays(__VA_ARGS__))
+#define glDrawElements(...) BEY_GL_COUNTED(DRAW, glDrawElements(__VA_ARGS__))
+#define glBindTexture(...) BEY_GL_COUNTED(TEXTURE_BIND, glBindTexture(__VA_ARGS__))
+#define glClear(...) BEY_GL_COUNTED(CLEAR, glClear(__VA_ARGS__))
+#define glEnable(...) BEY_GL_COUNTED(STATE, glEnable(__VA_ARGS__))
+#define glDisable(...) BEY_GL_COUNTED(STATE, glDisable(__VA_ARGS__))
+#define glDepthMask(...) BEY_GL_COUNTED(STATE, glDepthMask(__VA_ARGS__))
+#define glDepthFunc(...) BEY_GL_COUNTED(STATE, glDepthFunc(__VA_ARGS__))
+#define glColorMask(...) BEY_GL_COUNTED(STATE, glColorMask(__VA_ARGS__))
+#define glBlendFunc(...) BEY_GL_COUNTED(STATE, glBlendFunc(__VA_ARGS__))
+#define glStencilMask(...) BEY_GL_COUNTED(STATE, glStencilMask(__VA_ARGS__))
+#define glStencilFunc(...) BEY_GL_COUNTED(STATE, glStencilFunc(__VA_ARGS__))
+#define glStencilOp(...) BEY_GL_COUNTED(STATE, glStencilOp(__VA_ARGS__))
+#define glCullFace(...) BEY_GL_COUNTED(STATE, glCullFace(__VA_ARGS__))
+#define glScissor(...) BEY_GL_COUNTED(STATE, glScissor(__VA_ARGS__))
+#define glViewport(...) BEY_GL_COUNTED(STATE, glViewport(__VA_ARGS__))
+#define glDrawBuffer(...) BEY_GL_COUNTED(STATE, glDrawBuffer(__VA_ARGS__))
+#define glReadBuffer(...) BEY_GL_COUNTED(STATE, glReadBuffer(__VA_ARGS__))
+
+//the later ones are glew's macros for its function pointers
+#define BEY_GL_COUNTED_GLEW(call, name, ...) BEY_GL_COUNTED(call, GLEW_GET_FUN(__glew##name)(__VA_ARGS__))
+#undef glDrawElementsInstanced
+#define glDrawElementsInstanced(...) BEY_GL_COUNTED_GLEW(DRAW, DrawElementsInstanced, __VA_ARGS__)
+#undef glBindBuffer
+#define glBindBuffer(...) BEY_GL_COUNTED_GLEW(BUFFER_BIND, BindBuffer, __VA_ARGS__)
+#undef glBindVertexArray
+#define glBindVertexArray(...) BEY_GL_COUNTED_GLEW(BUFFER_BIND, BindVertexArray, __VA_ARGS__)
+#undef glBufferData
+#define glBufferData(...) BEY_GL_COUNTED_GLEW(BUFFER_UPLOAD, BufferData, __VA_ARGS__)
+#undef glBufferSubData
+#define glBufferSubData(...) BEY_GL_COUNTED_GLEW(BUFFER_UPLOAD, BufferSubData, __VA_ARGS__)
+#undef glUseProgram
+#define glUseProgram(...) BEY_GL_COUNTED_GLEW(PROGRAM_BIND, UseProgram, __VA_ARGS__)
+#undef glBindFramebuffer
+#define glBindFramebuffer(...) BEY_GL_COUNTED_GLEW(FRAMEBUFFER_BIND, BindFramebuffer, __VA_ARGS__)
+#undef glClearBufferfv
+#define glClearBufferfv(...) BEY_GL_COUNTED_GLEW(CLEAR, ClearBufferfv, __VA_ARGS__)
+#undef glClearBufferiv
+#define glClearBufferiv(...) BEY_GL_COUNTED_GLEW(CLEAR, ClearBufferiv, __VA_ARGS__)
+#undef glClearBufferuiv
+#define glClearBufferuiv(...) BEY_GL_COUNTED_GLEW(CLEAR, ClearBufferuiv, __VA_ARGS__)
+#undef glClearBufferfi
+#define glClearBufferfi(...) BEY_GL_COUNTED_GLEW(CLEAR, ClearBufferfi, __VA_ARGS__)
+#undef glBlitFramebuffer
+#define glBlitFramebuffer(...) BEY_GL_COUNTED_GLEW(BLIT, BlitFramebuffer, __VA_ARGS__)
+#undef glBlendEquation
+#define glBlendEquation(...) BEY_GL_COUNTED_GLEW(STATE, BlendEquation, __VA_ARGS__)
+#undef glActiveTexture
+#define glActiveTexture(...) BEY_GL_COUNTED_GLEW(STATE, ActiveTexture, __VA_ARGS__)
+#undef glDrawBuffers
+#define glDrawBuffers(...) BEY_GL_COUNTED_GLEW(STATE, DrawBuffers, __VA_ARGS__)
+#undef glEnableVertexAttribArray
+#define glEnableVertexAttribArray(...) BEY_GL_COUNTED_GLEW(STATE, EnableVertexAttribArray, __VA_ARGS__)
+#undef glDisableVertexAttribArray
+#define glDisableVertexAttribArray(...) BEY_GL_COUNTED_GLEW(STATE, DisableVertexAttribArray, __VA_ARGS__)
+#undef glVertexAttribPointer
+#define glVertexAttribPointer(...) BEY_GL_COUNTED_GLEW(STATE, VertexAttribPointer, __VA_ARGS__)
+#undef glTexBuffer
+#define glTexBuffer(...) BEY_GL_COUNTED_GLEW(STATE, TexBuffer, __VA_ARGS__)
+#undef glBeginQuery
+#define glBeginQuery(...) BEY_GL_COUNTED_GLEW(QUERY, BeginQuery, __VA_ARGS__)
+#undef glEndQuery
+#define glEndQuery(...) BEY_GL_COUNTED_GLEW(QUERY, EndQuery, __VA_ARGS__)
+#undef glGetUniformLocation
+#define glGetUniformLocation(...) BEY_GL_COUNTED_GLEW(UNIFORM_LOOKUP, GetUniformLocation, __VA_ARGS__)
+#undef glUniform1i
+#define glUniform1i(...) BEY_GL_COUNTED_GLEW(UNIFORM, Uniform1i, __VA_ARGS__)
+#undef glUniform1iv
+#define glUniform1iv(...) BEY_GL_COUNTED_GLEW(UNIFORM, Uniform1iv, __VA_ARGS__)
+#undef glUniform2i
+#define glUniform2i(...) BEY_GL_COUNTED_GLEW(UNIFORM, Uniform2i, __VA_ARGS__)
+#undef glUniform3i
+#define glUniform3i(...) BEY_GL_COUNTED_GLEW(UNIFORM, Uniform3i, __VA_ARGS__)
+#undef glUniform1ui
+#define glUniform1ui(...) BEY_GL_COUNTED_GLEW(UNIFORM, Uniform1ui, __VA_ARGS__)
+#undef glUniform1f
+#define glUniform1f(...) BEY_GL_COUNTED_GLEW(UNIFORM, Uniform1f, __VA_ARGS__)
+#undef glUniform2f
+#define glUniform2f(...) BEY_GL_COUNTED_GLEW(UNIFORM, Uniform2f, __VA_ARGS__)
+#undef glUniform3f
+#define glUniform3f(...) BEY_GL_COUNTED_GLEW(UNIFORM, Uniform3f, __VA_ARGS__)
+#undef glUniform4f
+#define glUniform4f(...) BEY_GL_COUNTED_GLEW(UNIFORM, Uniform4f, __VA_ARGS__)
+#undef glUniform1fv
+#define glUniform1fv(...) BEY_GL_COUNTED_GLEW(UNIFORM, Uniform1fv, __VA_ARGS__)
+#undef glUniform2fv
+#define glUniform2fv(...) BEY_GL_COUNTED_GLEW(UNIFORM, Uniform2fv, __VA_ARGS__)
+#undef glUniform3fv
+#define glUniform3fv(...) BEY_GL_COUNTED_GLEW(UNIFORM, Uniform3fv, __VA_ARGS__)
+#undef glUniform4fv
+#define glUniform4fv(...) BEY_GL_COUNTED_GLEW(UNIFORM, Uniform4fv, __VA_ARGS__)
+#undef glUniformMatrix3fv
+#define glUniformMatrix3fv(...) BEY_GL_COUNTED_GLEW(UNIFORM, UniformMatrix3fv, __VA_ARGS__)
+#undef glUniformMatrix4fv
+#define glUniformMatrix4fv(...) BEY_GL_COUNTED_GLEW(UNIFORM, UniformMatrix4fv, __VA_ARGS__)
+#endif
@@ -0,0 +1,396 @@
+#include "renderer/GpuProfiler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include "renderer/GlStats.hpp"
+
+using namespace bey;
+
+static const float light_smoothing = 0.1f; // weight of the newest frame in a light's rolling average
+
+static const char* pass_names[] = { "geometry", "sun shadow", "sun light", "spot shadow", "point stencil", "point light", "spot stencil",
+	"spot light", "clustered lights", "low resolution", "final" };
+
+static bool is_spot_light_pass(GpuProfiler::Pass pass)
+{
+	return pass == GpuProfiler::Pass::SPOT_SHADOW || pass == GpuProfiler::Pass::SPOT_STENCIL || pass == GpuProfiler::Pass::SPOT_LIGHT;
+}
+
+// nearest rank, sorted_times is sorted in increasing order
+static float calc_percentile(const std::vector<float>& sorted_times, float percentile)
+{
+	size_t rank = (size_t)std::ceil(percentile * sorted_times.size());
+	return sorted_times[std::min(std::max(rank, (size_t)1), sorted_times.size()) - 1];
+}
+
+GpuProfiler::GpuProfiler() : enabled(false), recording(false), current(0), next_index(0), depth(0), last_frame_time(0.0f), num_frames(0), num_dropped_frames(0),
+	export_format(ExportFormat::JSON), first_export_frame(true)
+{
+}
+
+GpuProfiler::~GpuProfiler()
+{
+	end_export();
+}
+
+void GpuProfiler::set_enabled(bool enabled)
+{
+	if (enabled && !this->enabled)
+	{
+		for (int i = 0; i < NUM_BUFFERED_FRAMES; i++)
+		{
+			frames[i].pending = false;
+		}
+		recording = false;
+		depth = 0;
+		last_frame.clear();
+		last_frame_time = 0.0f;
+		history.clear();
+		num_frames = 0;
+		num_dropped_frames = 0;
+		lights.clear();
+	}
+	this->enabled = enabled;
+}
+
+bool GpuProfiler::is_enabled() const
+{
+	return enabled;
+}
+
+void GpuProfiler::begin_frame()
+{
+	if (!enabled)
+	{
+		return;
+	}
+
+	//oldest first, a frame is only read back once the ones before it are
+	for (int i = 1; i <= NUM_BUFFERED_FRAMES; i++)
+	{
+		Frame& frame = frames[(current + i) % NUM_BUFFERED_FRAMES];
+		if (!frame.pending)
+		{
+			continue;
+		}
+		if (!is_available(frame))
+		{
+			break;
+		}
+		if (!read_back(frame))
+		{
+			num_dropped_frames++;
+		}
+	}
+
+	current = (current + 1) % NUM_BUFFERED_FRAMES;
+	Frame& frame = frames[current];
+	if (frame.pending)
+	{
+		num_dropped_frames++;
+	}
+	frame.samples.clear();
+	frame.index = next_index++;
+	frame.pending = false;
+	frame.begin_time = clock.getElapsedTime().asSeconds() * 1000.0f;
+	recording = true;
+	depth = 0;
+}
+
+void GpuProfiler::end_frame()
+{
+	if (!enabled)
+	{
+		return;
+	}
+
+	frames[current].pending = true;
+	recording = false;
+}
+
+void GpuProfiler::begin(Pass pass, int light_index)
+{
+	//passes drawn outside of a frame, by the benchmarks, are not timed
+	if (!enabled || !recording || depth++ > 0)
+	{
+		return;
+	}
+
+	Frame& frame = frames[current];
+	size_t section = frame.samples.size();
+	if (section == frame.queries.size())
+	{
+		GLuint query;
+		glGenQueries(1, &query);
+		frame.queries.push_back(query);
+	}
+
+	Sample sample = { pass, light_index, 0.0f };
+	frame.samples.push_back(sample);
+	glBeginQuery(GL_TIME_ELAPSED, frame.queries[section]);
+}
+
+void GpuProfiler::end()
+{
+	if (!enabled || !recording || depth == 0 || --depth > 0)
+	{
+		return;
+	}
+
+	glEndQuery(GL_TIME_ELAPSED);
+}
+
+bool GpuProfiler::is_available(const Frame& frame) const
+{
+	if (frame.samples.empty())
+	{
+		return true;
+	}
+
+	//the queries of a frame finish in order
+	GLint available = 0;
+	glGetQueryObjectiv(frame.queries[frame.samples.size() - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+	return available != 0;
+}
+
+bool GpuProfiler::read_back(Frame& frame)
+{
+	frame.pending = false;
+	float max_milliseconds = clock.getElapsedTime().asSeconds() * 1000.0f - frame.begin_time;
+	for (size_t i = 0; i < frame.samples.size(); i++)
+	{
+		GLuint64 elapsed_nanoseconds;
+		glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &elapsed_nanoseconds);
+		frame.samples[i].milliseconds = elapsed_nanoseconds / 1000000.0f;
+		if (frame.samples[i].milliseconds > max_milliseconds)
+		{
+			return false;
+		}
+	}
+
+	add_frame(frame);
+	if (export_file.is_open())
+	{
+		export_frame(frame);
+	}
+	return true;
+}
+
+void GpuProfiler::add_frame(const Frame& frame)
+{
+	FrameTimes frame_times;
+	std::fill(frame_times.times, frame_times.times + (int)Pass::NUM_PASSES + 1, 0.0f);
+
+	//the stencil, shadow and shading of a light add up before they go in its average
+	std::map<std::pair<bool, int>, float> light_times;
+	for (size_t i = 0; i < frame.samples.size(); i++)
+	{
+		const Sample& sample = frame.samples[i];
+		frame_times.times[(int)sample.pass] += sample.milliseconds;
+		frame_times.times[(int)Pass::NUM_PASSES] += sample.milliseconds;
+		if (sample.light_index >= 0)
+		{
+			light_times[std::make_pair(is_spot_light_pass(sample.pass), sample.light_index)] += sample.milliseconds;
+		}
+	}
+
+	for (std::map<std::pair<bool, int>, float>::const_iterator it = light_times.begin(); it != light_times.end(); ++it)
+	{
+		std::map<std::pair<bool, int>, LightRecord>::iterator record = lights.find(it->first);
+		if (record == lights.end())
+		{
+			LightRecord new_record = { it->second, num_frames };
+			lights[it->first] = new_record;
+			continue;
+		}
+		record->second.average += (it->second - record->second.average) * light_smoothing;
+		record->second.last_frame = num_frames;
+	}
+
+	if (history.size() < NUM_HISTORY_FRAMES)
+	{
+		history.push_back(frame_times);
+	}
+	else
+	{
+		history[num_frames % NUM_HISTORY_FRAMES] = frame_times;
+	}
+
+	last_frame = frame.samples;
+	last_frame_time = frame_times.times[(int)Pass::NUM_PASSES];
+	num_frames++;
+}
+
+int GpuProfiler::get_num_frames() const
+{
+	return num_frames;
+}
+
+int GpuProfiler::get_num_dropped_frames() const
+{
+	return num_dropped_frames;
+}
+
+const std::vector<GpuProfiler::Sample>& GpuProfiler::get_frame() const
+{
+	return last_frame;
+}
+
+float GpuProfiler::get_frame_time() const
+{
+	return last_frame_time;
+}
+
+GpuProfiler::Statistics GpuProfiler::calc_statistics(int time_index) const
+{
+	Statistics statistics;
+	if (history.empty())
+	{
+		return statistics;
+	}
+
+	std::vector<float> times(history.size());
+	float sum = 0.0f;
+	for (size_t i = 0; i < history.size(); i++)
+	{
+		times[i] = history[i].times[time_index];
+		sum += times[i];
+	}
+	std::sort(times.begin(), times.end());
+
+	statistics.average = sum / times.size();
+	statistics.p50 = calc_percentile(times, 0.5f);
+	statistics.p95 = calc_percentile(times, 0.95f);
+	statistics.p99 = calc_percentile(times, 0.99f);
+	statistics.max = times.back();
+	return statistics;
+}
+
+GpuProfiler::Statistics GpuProfiler::get_statistics(Pass pass) const
+{
+	return calc_statistics((int)pass);
+}
+
+GpuProfiler::Statistics GpuProfiler::get_frame_statistics() const
+{
+	return calc_statistics((int)Pass::NUM_PASSES);
+}
+
+void GpuProfiler::get_top_lights(int num_lights, std::vector<LightTime>& lights) const
+{
+	lights.clear();
+	for (std::map<std::pair<bool, int>, LightRecord>::const_iterator it = this->lights.begin(); it != this->lights.end(); ++it)
+	{
+		//a light that left the view keeps its last average, it only competes while it is still drawn
+		if (num_frames - it->second.last_frame > NUM_HISTORY_FRAMES)
+		{
+			continue;
+		}
+		LightTime light = { it->first.first, it->first.second, it->second.average };
+		lights.push_back(light);
+	}
+
+	std::sort(lights.begin(), lights.end(), [](const LightTime& a, const LightTime& b) { return a.average > b.average; });
+	if ((int)lights.size() > num_lights)
+	{
+		lights.resize(std::max(num_lights, 0));
+	}
+}
+
+void GpuProfiler::print(std::ostream& out, int num_top_lights) const
+{
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+	out << std::fixed << std::setprecision(3);
+
+	out << "gpu profile : " << history.size() << " frames (" << num_frames << " read back, " << num_dropped_frames << " dropped), in ms" << std::endl;
+	out << "  " << std::left << std::setw(18) << "pass" << std::right << std::setw(9) << "average" << std::setw(9) << "p50" << std::setw(9) << "p95"
+		<< std::setw(9) << "p99" << std::setw(9) << "max" << std::endl;
+	for (int i = 0; i <= (int)Pass::NUM_PASSES; i++)
+	{
+		Statistics statistics = calc_statistics(i);
+		if (i < (int)Pass::NUM_PASSES && statistics.max == 0.0f)
+		{
+			continue;
+		}
+		out << "  " << std::left << std::setw(18) << (i < (int)Pass::NUM_PASSES ? pass_names[i] : "frame") << std::right << std::setw(9) << statistics.average
+			<< std::setw(9) << statistics.p50 << std::setw(9) << statistics.p95 << std::setw(9) << statistics.p99 << std::setw(9) << statistics.max << std::endl;
+	}
+
+	std::vector<LightTime> top_lights;
+	get_top_lights(num_top_lights, top_lights);
+	for (size_t i = 0; i < top_lights.size(); i++)
+	{
+		out << "  " << (top_lights[i].spot_light ? "spot light " : "point light ") << top_lights[i].light_index << " : " << top_lights[i].average << std::endl;
+	}
+
+	out.flags(flags);
+	out.precision(precision);
+}
+
+bool GpuProfiler::begin_export(const std::string& filename, ExportFormat format)
+{
+	end_export();
+	export_file.open(filename.c_str());
+	if (!export_file.is_open())
+	{
+		std::cerr << "gpu profiler : can not write " << filename << std::endl;
+		return false;
+	}
+
+	export_format = format;
+	first_export_frame = true;
+	if (format == ExportFormat::JSON)
+	{
+		export_file << "[" << std::endl;
+	}
+	else
+	{
+		export_file << "frame,pass,light,milliseconds" << std::endl;
+	}
+	return true;
+}
+
+void GpuProfiler::end_export()
+{
+	if (!export_file.is_open())
+	{
+		return;
+	}
+
+	if (export_format == ExportFormat::JSON)
+	{
+		export_file << std::endl << "]" << std::endl;
+	}
+	export_file.close();
+}
+
+void GpuProfiler::export_frame(const Frame& frame)
+{
+	if (export_format == ExportFormat::CSV)
+	{
+		for (size_t i = 0; i < frame.samples.size(); i++)
+		{
+			const Sample& sample = frame.samples[i];
+			export_file << frame.index << "," << pass_names[(int)sample.pass] << "," << sample.light_index << "," << sample.milliseconds << std::endl;
+		}
+		return;
+	}
+
+	//one object per frame, its sections in the order they were drawn
+	export_file << (first_export_frame ? "" : ",\n") << "  { \"frame\" : " << frame.index << ", \"milliseconds\" : " << last_frame_time << ", \"passes\" : [";
+	for (size_t i = 0; i < frame.samples.size(); i++)
+	{
+		const Sample& sample = frame.samples[i];
+		export_file << (i == 0 ? " " : ", ") << "{ \"pass\" : \"" << pass_names[(int)sample.pass] << "\", \"light\" : " << sample.light_index
+			<< ", \"milliseconds\" : " << sample.milliseconds << " }";
+	}
+	export_file << " ] }";
+	first_export_frame = false;
+}
+
+const char* GpuProfiler::get_pass_name(Pass pass)
+{
+	return pass_names[(int)pass];
+}
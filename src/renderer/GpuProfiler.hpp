@@ -0,0 +1,150 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <SFML/System/Clock.hpp>
+#include <fstream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bey
+{
+	// gpu time of every pass and every light, from GL_TIME_ELAPSED queries around each of them.
+	// the queries of a frame are read back NUM_BUFFERED_FRAMES frames later, only once they are all available, so the cpu never
+	// waits for the gpu. a frame that is still not done by then is dropped, and so is a frame with a section longer than the time
+	// between the frame's start and its read back, as some drivers return for their first query. time elapsed queries can not overlap : a section
+	// begun inside another one is part of the outer section's time
+	class GpuProfiler
+	{
+	public:
+		static const int NUM_BUFFERED_FRAMES = 3;
+		static const int NUM_HISTORY_FRAMES = 120; // frames the statistics and the top lights cover
+
+		enum class Pass
+		{
+			GEOMETRY = 0, // with the depth pre-pass, or the visibility buffer and its resolve
+			SUN_SHADOW,
+			SUN_LIGHT,
+			SPOT_SHADOW, // one spot light's shadow map
+			POINT_STENCIL,
+			POINT_LIGHT,
+			SPOT_STENCIL,
+			SPOT_LIGHT,
+			CLUSTERED_LIGHTS, // every light of the clustered path at once
+			LOW_RESOLUTION, // depth of the low resolution light buffer, and its upsample
+			FINAL, // blit or temporal upscale to the window
+			NUM_PASSES,
+		};
+
+		enum class ExportFormat
+		{
+			JSON = 0,
+			CSV,
+		};
+
+		struct Sample
+		{
+			Pass pass;
+			int light_index; // of the point or spot light the pass is for, -1 for the other passes
+			float milliseconds;
+		};
+
+		// of the pass's total time in each frame, in milliseconds
+		struct Statistics
+		{
+			float average;
+			float p50;
+			float p95;
+			float p99;
+			float max;
+
+			Statistics() : average(0.0f), p50(0.0f), p95(0.0f), p99(0.0f), max(0.0f) {}
+		};
+
+		struct LightTime
+		{
+			bool spot_light;
+			int light_index;
+			float average; // rolling average of its stencil, shadow and shading, in milliseconds
+		};
+
+		GpuProfiler();
+		~GpuProfiler();
+
+		// turning it on starts the statistics over
+		void set_enabled(bool enabled);
+		bool is_enabled() const;
+
+		// reads back the frames whose queries are available
+		void begin_frame();
+		void end_frame();
+		void begin(Pass pass, int light_index = -1);
+		void end();
+
+		int get_num_frames() const; // frames read back since the profiler was turned on
+		int get_num_dropped_frames() const;
+		const std::vector<Sample>& get_frame() const; // samples of the last frame read back, in the order they were drawn
+		float get_frame_time() const; // their sum
+		Statistics get_statistics(Pass pass) const;
+		Statistics get_frame_statistics() const;
+		// the num_lights lights with the highest rolling average, among the ones drawn during the history
+		void get_top_lights(int num_lights, std::vector<LightTime>& lights) const;
+		void print(std::ostream& out, int num_top_lights) const;
+
+		// every frame read back from now on is written to filename, until end_export
+		bool begin_export(const std::string& filename, ExportFormat format);
+		void end_export();
+
+		static const char* get_pass_name(Pass pass);
+
+	private:
+		struct Frame
+		{
+			std::vector<GLuint> queries; // grows to the most sections a frame had, and is reused
+			std::vector<Sample> samples; // milliseconds are filled in when the frame is read back
+			int index;
+			bool pending;
+			float begin_time; // of the profiler's clock, in milliseconds
+
+			Frame() : index(0), pending(false), begin_time(0.0f) {}
+		};
+
+		// per frame totals of each pass, the last one is the whole frame
+		struct FrameTimes
+		{
+			float times[(int)Pass::NUM_PASSES + 1];
+		};
+
+		struct LightRecord
+		{
+			float average;
+			int last_frame; // the frame it was last drawn in
+		};
+
+		bool is_available(const Frame& frame) const;
+		// false when a section took longer than the frame could have
+		bool read_back(Frame& frame);
+		void add_frame(const Frame& frame);
+		void export_frame(const Frame& frame);
+		Statistics calc_statistics(int time_index) const;
+
+		bool enabled;
+		bool recording; // between begin_frame and end_frame
+		sf::Clock clock;
+		Frame frames[NUM_BUFFERED_FRAMES];
+		int current; // the frame being recorded
+		int next_index;
+		int depth; // of the nested sections, only the outermost one has a query
+		std::vector<Sample> last_frame;
+		float last_frame_time;
+		std::vector<FrameTimes> history; // ring of the last NUM_HISTORY_FRAMES frames
+		int num_frames;
+		int num_dropped_frames;
+		std::map<std::pair<bool, int>, LightRecord> lights;
+		std::ofstream export_file;
+		ExportFormat export_format;
+		bool first_export_frame;
+	};
+}
@@ -0,0 +1,129 @@
+#include "renderer/LowResolutionLightBuffer.hpp"
+#include "renderer/GeometryBuffer.hpp"
+#include <iostream>
+#include "renderer/GlStats.hpp"
+
+using namespace bey;
+
+LowResolutionLightBuffer::LowResolutionLightBuffer() : screen_width(0), screen_height(0), scale(1), width(0), height(0), fbo_id(0), light_texture_id(0), depth_id(0)
+{
+}
+
+LowResolutionLightBuffer::~LowResolutionLightBuffer()
+{
+}
+
+void LowResolutionLightBuffer::initialize(int screen_width, int screen_height, int scale)
+{
+	this->screen_width = screen_width;
+	this->screen_height = screen_height;
+
+	glGenFramebuffers(1, &fbo_id);
+	glGenTextures(1, &light_texture_id);
+	glGenTextures(1, &depth_id);
+	set_scale(scale);
+}
+
+void LowResolutionLightBuffer::resize(int screen_width, int screen_height)
+{
+	this->screen_width = screen_width;
+	this->screen_height = screen_height;
+	set_scale(scale);
+}
+
+void LowResolutionLightBuffer::set_scale(int scale)
+{
+	this->scale = scale;
+	if (scale <= 1)
+	{
+		// nothing is shaded at a lower resolution, release the storage
+		width = 0;
+		height = 0;
+		glBindTexture(GL_TEXTURE_2D, light_texture_id);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, 0, 0, 0, GL_RGBA, GL_FLOAT, nullptr);
+		glBindTexture(GL_TEXTURE_2D, depth_id);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH32F_STENCIL8, 0, 0, 0, GL_DEPTH_STENCIL, GL_FLOAT_32_UNSIGNED_INT_24_8_REV, nullptr);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		return;
+	}
+
+	// rounded up, the last block of a row or a column may be cut by the screen's edge
+	width = (screen_width + scale - 1) / scale;
+	height = (screen_height + scale - 1) / scale;
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo_id);
+
+	glBindTexture(GL_TEXTURE_2D, light_texture_id);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	// the same attachment as the geometry buffer's light accumulation, so GeometryBuffer::setup_light_draw_buffer works on both
+	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + GeometryBuffer::LIGHT_ACCUMULATION, GL_TEXTURE_2D, light_texture_id, 0);
+
+	glBindTexture(GL_TEXTURE_2D, depth_id);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH32F_STENCIL8, width, height, 0, GL_DEPTH_STENCIL, GL_FLOAT_32_UNSIGNED_INT_24_8_REV, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depth_id, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// the light shaders write to location 5
+	GLenum draw_buffers[GeometryBuffer::NUM_TEXTURES];
+	for (int i = 0; i < GeometryBuffer::NUM_TEXTURES; i++)
+	{
+		draw_buffers[i] = GL_NONE;
+	}
+	draw_buffers[GeometryBuffer::LIGHT_ACCUMULATION] = GL_COLOR_ATTACHMENT0 + GeometryBuffer::LIGHT_ACCUMULATION;
+	glDrawBuffers(GeometryBuffer::NUM_TEXTURES, draw_buffers);
+
+	GLenum status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		std::cerr << "FB error, status: 0x" << status << std::endl;
+		exit(EXIT_FAILURE);
+		return;
+	}
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+}
+
+int LowResolutionLightBuffer::get_scale() const
+{
+	return scale;
+}
+
+int LowResolutionLightBuffer::get_width() const
+{
+	return width;
+}
+
+int LowResolutionLightBuffer::get_height() const
+{
+	return height;
+}
+
+void LowResolutionLightBuffer::bind()
+{
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo_id);
+}
+
+void LowResolutionLightBuffer::unbind()
+{
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+}
+
+void LowResolutionLightBuffer::bind_texture(const Shader& shader, const char* uniform_name, int texture_unit) const
+{
+	GLint uni_texture = glGetUniformLocation(shader.program, uniform_name);
+	if (uni_texture != -1)
+	{
+		glActiveTexture(GL_TEXTURE0 + texture_unit);
+		glBindTexture(GL_TEXTURE_2D, light_texture_id);
+		glUniform1i(uni_texture, texture_unit);
+	}
+}
+
+size_t LowResolutionLightBuffer::get_memory_size() const
+{
+	// rgba16f and depth32f + stencil8 (stored as 8 bytes)
+	return (size_t)width * height * (8 + 8);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "renderer/Shader.hpp"
+#include <GL/glew.h>
+
+namespace bey
+{
+	// light accumulation at 1 / scale of the screen resolution, for the local lights that are allowed to be shaded at a lower resolution.
+	// every pixel stands for the first pixel of its scale x scale block of the geometry buffer. its depth and stencil are the light
+	// volumes' depth and stencil buffer, the depth is copied from that first pixel before the lights are drawn
+	class LowResolutionLightBuffer
+	{
+	public:
+		LowResolutionLightBuffer();
+		~LowResolutionLightBuffer();
+
+		void initialize(int screen_width, int screen_height, int scale);
+		// follows the size of the geometry buffer, keeping the scale
+		void resize(int screen_width, int screen_height);
+		// reallocates the targets, a scale of 1 keeps no targets at all
+		void set_scale(int scale);
+		int get_scale() const;
+		int get_width() const;
+		int get_height() const;
+
+		void bind();
+		void unbind();
+		// binds the light accumulation to texture_unit, for the upsample
+		void bind_texture(const Shader& shader, const char* uniform_name, int texture_unit) const;
+
+		size_t get_memory_size() const; // bytes of the light accumulation and of depth + stencil
+
+	private:
+		int screen_width;
+		int screen_height;
+		int scale;
+		int width;
+		int height;
+		GLuint fbo_id;
+		GLuint light_texture_id;
+		GLuint depth_id;
+	};
+}
@@ -0,0 +1,143 @@
+#include "renderer/QualityGovernor.hpp"
+#include <algorithm>
+#include <iostream>
+
+using namespace bey;
+
+static const float smoothing = 0.1f; // weight of the newest frame time in the average
+static const float lower_margin = 1.1f; // the level goes down while the average is over target * lower_margin
+static const float raise_margin = 0.7f; // and may go up while it is under target * raise_margin
+static const float max_sample_ratio = 4.0f; // frame times are clamped to target * max_sample_ratio, so a single hitch barely moves the average
+static const int lower_frames = 10;
+static const int min_raise_delay = 60;
+static const int max_raise_delay = 960;
+static const int settle_frames = 30; // no decision right after a change, the average still holds the frame times of the old level
+static const int bounce_frames = 180; // a step down this soon after a step up doubles the raise delay, a step up that lasts halves it
+
+QualityGovernor::QualityGovernor() : level(0), target(0.0f), average(0.0f), num_frames_over(0), num_frames_under(0), num_frames_since_change(0),
+	last_change_raised(false), raise_delay(min_raise_delay)
+{
+}
+
+QualityGovernor::~QualityGovernor()
+{
+}
+
+void QualityGovernor::initialize(float target_milliseconds, int shadow_tile_size, int sun_shadow_resolution, int shadow_updates)
+{
+	// without a limit at full quality, the lower levels still need one
+	int limited_updates = shadow_updates > 0 ? shadow_updates : 4;
+
+	//every step gives up a little of the screen resolution, of the shadows or of the light volumes
+	Level full = { 1.0f, shadow_tile_size, sun_shadow_resolution, 1.0f / 256.0f, shadow_updates };
+	Level high = { 0.85f, shadow_tile_size, sun_shadow_resolution, 1.0f / 256.0f, limited_updates };
+	Level medium = { 0.75f, shadow_tile_size / 2, sun_shadow_resolution, 1.0f / 128.0f, limited_updates };
+	Level low = { 0.67f, shadow_tile_size / 2, sun_shadow_resolution / 2, 1.0f / 128.0f, std::max(limited_updates / 2, 1) };
+	Level lowest = { 0.5f, shadow_tile_size / 4, sun_shadow_resolution / 2, 1.0f / 64.0f, 1 };
+	levels.assign({ full, high, medium, low, lowest });
+
+	level = 0;
+	set_target(target_milliseconds);
+}
+
+void QualityGovernor::set_target(float target_milliseconds)
+{
+	target = std::max(target_milliseconds, 0.0f);
+	average = 0.0f;
+	num_frames_over = 0;
+	num_frames_under = 0;
+	num_frames_since_change = 0;
+	last_change_raised = false;
+	raise_delay = min_raise_delay;
+	if (!is_enabled() && level != 0)
+	{
+		std::cout << "quality governor : off, back to level 0" << std::endl;
+		level = 0;
+	}
+}
+
+float QualityGovernor::get_target() const
+{
+	return target;
+}
+
+bool QualityGovernor::is_enabled() const
+{
+	return target > 0.0f;
+}
+
+bool QualityGovernor::add_frame_time(float milliseconds)
+{
+	if (!is_enabled())
+	{
+		return false;
+	}
+
+	milliseconds = std::min(milliseconds, target * max_sample_ratio);
+	average = average > 0.0f ? average + (milliseconds - average) * smoothing : milliseconds;
+	num_frames_since_change++;
+	if (last_change_raised && num_frames_since_change == bounce_frames)
+	{
+		raise_delay = std::max(raise_delay / 2, min_raise_delay);
+	}
+
+	if (num_frames_since_change < settle_frames)
+	{
+		return false;
+	}
+
+	num_frames_over = average > target * lower_margin ? num_frames_over + 1 : 0;
+	num_frames_under = average < target * raise_margin ? num_frames_under + 1 : 0;
+
+	if (num_frames_over >= lower_frames && level + 1 < get_num_levels())
+	{
+		if (last_change_raised && num_frames_since_change < bounce_frames)
+		{
+			raise_delay = std::min(raise_delay * 2, max_raise_delay);
+		}
+		change_level(level + 1, "over");
+		return true;
+	}
+
+	if (num_frames_under >= raise_delay && level > 0)
+	{
+		change_level(level - 1, "under");
+		return true;
+	}
+
+	return false;
+}
+
+void QualityGovernor::change_level(int level, const char* reason)
+{
+	const Level& next = levels[level];
+	std::cout << "quality governor : level " << this->level << " -> " << level << ", gpu frame " << average << " ms " << reason << " the "
+		<< target << " ms target : render scale " << next.render_scale << ", shadow tiles " << next.shadow_tile_size << ", sun cascades "
+		<< next.sun_shadow_resolution << ", light threshold 1/" << 1.0f / next.light_cutoff_threshold << ", shadow updates " << next.shadow_updates << std::endl;
+
+	last_change_raised = level < this->level;
+	this->level = level;
+	num_frames_over = 0;
+	num_frames_under = 0;
+	num_frames_since_change = 0;
+}
+
+const QualityGovernor::Level& QualityGovernor::get_level() const
+{
+	return levels[level];
+}
+
+int QualityGovernor::get_level_index() const
+{
+	return level;
+}
+
+int QualityGovernor::get_num_levels() const
+{
+	return (int)levels.size();
+}
+
+float QualityGovernor::get_average_frame_time() const
+{
+	return average;
+}
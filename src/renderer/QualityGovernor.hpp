@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+
+namespace bey
+{
+	// picks a quality level from the measured gpu frame time, to hold a target frame time.
+	// the frame time is smoothed, and the level only moves one step at a time : down once the frame time stayed over the target
+	// for a few frames, up once it stayed well under it for much longer. a step up that has to be taken back soon after makes the
+	// next step up wait twice as long, so the quality does not keep bouncing between two levels
+	class QualityGovernor
+	{
+	public:
+		// everything one level sets. level 0 is the full quality
+		struct Level
+		{
+			float render_scale; // of the window size, for the geometry buffer and all the passes that read it
+			int shadow_tile_size; // biggest spot light shadow atlas tile
+			int sun_shadow_resolution; // of each sun shadow cascade
+			float light_cutoff_threshold; // see PointLight::calc_bounding_sphere_scale
+			int shadow_updates; // spot light shadow maps re-rendered per frame, see ShadowScheduler::Budget
+		};
+
+		QualityGovernor();
+		~QualityGovernor();
+
+		// the levels are derived from the full quality shadow sizes. a target of 0 turns the governor off, it then stays on level 0
+		void initialize(float target_milliseconds, int shadow_tile_size, int sun_shadow_resolution, int shadow_updates);
+		void set_target(float target_milliseconds);
+		float get_target() const;
+		bool is_enabled() const;
+
+		// feeds the gpu time of one frame, returns true when the level changed
+		bool add_frame_time(float milliseconds);
+
+		const Level& get_level() const;
+		int get_level_index() const;
+		int get_num_levels() const;
+		float get_average_frame_time() const; // smoothed gpu frame time, in milliseconds
+
+	private:
+		void change_level(int level, const char* reason);
+
+		std::vector<Level> levels;
+		int level;
+		float target; // in milliseconds
+		float average; // in milliseconds, 0 until the first frame time
+		int num_frames_over; // consecutive frames over the target
+		int num_frames_under; // consecutive frames well under the target
+		int num_frames_since_change;
+		bool last_change_raised;
+		int raise_delay; // frames num_frames_under has to reach before the level goes up
+	};
+}
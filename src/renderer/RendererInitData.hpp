@@ -1,10 +1,42 @@
 #pragma once
 
+#include "renderer/ShadowMap.hpp"
+#include <string>
+
 namespace bey
 {
 	struct RendererInitData 
 	{
-		int screen_width;
+		int screen_width; // of the window
 		int screen_height;
+		float render_scale; // see Renderer::set_render_scale
+		float target_frame_time; // in milliseconds, see Renderer::set_target_frame_time
+		bool temporal_upscaling; // see Renderer::set_temporal_upscaling
+		bool idle_frame_skipping; // see Renderer::set_idle_frame_skipping
+
+		//shadow maps are sized independently of the screen
+		int sun_shadow_cascade_resolution;
+		int shadow_atlas_size;
+		ShadowMap::DepthFormat shadow_depth_format;
+		bool shadow_debug; // adds a color attachment to the shadow maps that shows the shadow casters
+		int spot_shadow_pcf_size; // the spot light shadow lookup filters pcf_size x pcf_size texels, 1 is a single tap
+
+		bool compact_geometry_buffer; // see GeometryBuffer::TextureType
+		bool fused_sun_light; // see Renderer::set_fused_sun_light
+		bool depth_pre_pass; // see Renderer::set_depth_pre_pass
+		bool sort_front_to_back; // see Renderer::set_sort_front_to_back
+		bool visibility_buffer; // see Renderer::GeometryPath
+		int light_resolution_scale; // see Renderer::set_light_resolution_scale
+
+		//tessellation of the point and spot light volumes
+		int light_volume_sphere_subdivisions;
+		int light_volume_cone_segments;
+
+		std::string shader_cache_directory; // linked shader programs are cached here, empty turns the cache off
+
+		RendererInitData() : screen_width(0), screen_height(0), render_scale(1.0f), target_frame_time(0.0f), temporal_upscaling(false), idle_frame_skipping(true), sun_shadow_cascade_resolution(1024), shadow_atlas_size(2048),
+			shadow_depth_format(ShadowMap::DepthFormat::DEPTH24), shadow_debug(ShadowMap::default_debug), spot_shadow_pcf_size(1),
+			compact_geometry_buffer(true), fused_sun_light(false), depth_pre_pass(false), sort_front_to_back(false), visibility_buffer(false), light_resolution_scale(1),
+			light_volume_sphere_subdivisions(2), light_volume_cone_segments(16), shader_cache_directory("../../shader_cache/") {}
 	};
-}
\ No newline at end of file
+}
@@ -1,28 +1,129 @@
 #pragma once
 
 #include <renderer/Shader.hpp>
+#include <util/CpuProfiler.hpp>
+#include <cstring>
 #include <iostream>
+#include <sstream>
+#include <renderer/GlStats.hpp>
 
 using namespace bey;
 
-static char* read_source(const std::string& filepath)
+static bool read_source(const std::string& filepath, std::string& source)
 {
 	FILE * pf;
 	if (fopen_s(&pf, filepath.c_str(), "rb") != 0)
-		return NULL;
+		return false;
 	fseek(pf, 0, SEEK_END);
 	long size = ftell(pf);
 	fseek(pf, 0, SEEK_SET);
 
-	char * shader_source = new char[size + 1];
-	fread(shader_source, sizeof(char), size, pf);
-	shader_source[size] = 0;
+	source.resize(size);
+	if (size > 0)
+	{
+		fread(&source[0], sizeof(char), size, pf);
+	}
 	fclose(pf);
 
-	return shader_source;
+	return true;
+}
+
+//glsl has no #include. a line #include "file" is replaced by that file, found next to the one including it, before the source is
+//compiled or hashed for the program cache
+static bool read_shader_source(const std::string& filepath, std::string& source, int depth = 0)
+{
+	if (depth > 8 || !read_source(filepath, source))
+	{
+		std::cout << "Error reading shader " << filepath << std::endl;
+		return false;
+	}
+
+	std::string directory = filepath.substr(0, filepath.find_last_of("/\\") + 1);
+	size_t line_begin = 0;
+	while (line_begin < source.size())
+	{
+		size_t line_end = source.find('\n', line_begin);
+		if (line_end == std::string::npos)
+		{
+			line_end = source.size();
+		}
+
+		if (source.compare(line_begin, 8, "#include") != 0)
+		{
+			line_begin = line_end + 1;
+			continue;
+		}
+
+		size_t name_begin = source.find('"', line_begin);
+		size_t name_end = name_begin < line_end ? source.find('"', name_begin + 1) : std::string::npos;
+		if (name_end >= line_end)
+		{
+			std::cout << "Error in shader " << filepath << " : " << source.substr(line_begin, line_end - line_begin) << std::endl;
+			return false;
+		}
+
+		std::string included_source;
+		if (!read_shader_source(directory + source.substr(name_begin + 1, name_end - name_begin - 1), included_source, depth + 1))
+		{
+			return false;
+		}
+		source.replace(line_begin, line_end - line_begin, included_source);
+		line_begin += included_source.size();
+	}
+
+	return true;
+}
+
+//64 bit FNV-1a
+static unsigned long long hash_string(const std::string& str, unsigned long long hash = 14695981039346656037ULL)
+{
+	for (size_t i = 0; i < str.size(); i++)
+	{
+		hash ^= (unsigned char)str[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static const unsigned int program_cache_magic = 0x42455950; // "BEYP"
+
+//a program cache file is the header followed by the program binary
+struct ProgramCacheHeader
+{
+	unsigned int magic;
+	unsigned long long key;
+	GLenum binary_format;
+	GLint binary_length;
+};
+
+std::string Shader::program_cache_directory;
+
+void ShaderDefines::set(const std::string& name, int value)
+{
+	defines[name] = value;
+}
+
+std::string ShaderDefines::get_key() const
+{
+	std::ostringstream key;
+	for (std::map<std::string, int>::const_iterator it = defines.begin(); it != defines.end(); ++it)
+	{
+		key << it->first << "=" << it->second << ";";
+	}
+	return key.str();
 }
 
-Shader::Shader()
+std::string ShaderDefines::get_source() const
+{
+	std::ostringstream source;
+	for (std::map<std::string, int>::const_iterator it = defines.begin(); it != defines.end(); ++it)
+	{
+		source << "#define " << it->first << " " << it->second << "\n";
+	}
+	return source.str();
+}
+
+Shader::Shader() : cache_key(0), loading(false), program(0), vertex_shader(0), fragment_shader(0)
 {
 }
 
@@ -31,18 +132,55 @@ Shader::~Shader()
 	//fixme : delete stuffs here
 }
 
+void Shader::set_program_cache_directory(const std::string& directory)
+{
+	program_cache_directory = directory;
+}
+
 //shader type is either GL_VERTEX_SHADER or GL_FRAGMENT_SHADER
-GLuint Shader::compile_shader(const std::string& filepath, GLint shader_type)
+GLuint Shader::compile_shader(const std::string& filepath, GLint shader_type, const ShaderDefines& defines)
 {
-	GLint compile_result;
-	GLuint shader = glCreateShader(shader_type);
+	std::string source;
+	if (!read_shader_source(filepath, source))
+	{
+		std::cout << "Error reading shader " << filepath << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	GLuint shader = submit_shader(source, shader_type, defines);
+	check_shader(shader, filepath);
+	return shader;
+}
 
-	const char* source = read_source(filepath);
+GLuint Shader::submit_shader(const std::string& source, GLint shader_type, const ShaderDefines& defines)
+{
+	GLuint shader = glCreateShader(shader_type);
 
-	glShaderSource(shader, 1, &source, NULL);
-	delete[] source;
+	//the defines go right after the #version line, which has to stay the first thing in the source
+	std::string define_source = defines.get_source();
+	std::string version_line;
+	size_t body_begin = 0;
+	if (source.compare(0, 8, "#version") == 0)
+	{
+		size_t line_end = source.find('\n');
+		body_begin = line_end != std::string::npos ? line_end + 1 : source.size();
+		version_line = source.substr(0, body_begin);
+		if (line_end == std::string::npos)
+		{
+			version_line += "\n";
+		}
+	}
 
+	const char* sources[] = { version_line.c_str(), define_source.c_str(), source.c_str() + body_begin };
+	glShaderSource(shader, 3, sources, NULL);
 	glCompileShader(shader);
+
+	return shader;
+}
+
+void Shader::check_shader(GLuint shader, const std::string& filepath)
+{
+	GLint compile_result;
 	glGetShaderiv(shader, GL_COMPILE_STATUS, &compile_result);
 
 	if (!compile_result)
@@ -61,20 +199,92 @@ GLuint Shader::compile_shader(const std::string& filepath, GLint shader_type)
 
 		exit(EXIT_FAILURE);
 	}
+}
 
-	return shader;
+void Shader::load_shader_program(const std::string& vs_filepath, const std::string& fs_filepath, const ShaderDefines& defines)
+{
+	begin_load_shader_program(vs_filepath, fs_filepath, defines);
+	finish_load_shader_program();
 }
 
-void Shader::load_shader_program(const std::string& vs_filepath, const std::string& fs_filepath)
+void Shader::begin_load_shader_program(const std::string& vs_filepath, const std::string& fs_filepath, const ShaderDefines& defines)
 {
-	GLuint compiled_vs_id = compile_shader(vs_filepath, GL_VERTEX_SHADER);
-	GLuint compiled_fs_id = compile_shader(fs_filepath, GL_FRAGMENT_SHADER);
-	GLint link_status;
+	BEY_PROFILE_ZONE("shader compile");
+	this->vs_filepath = vs_filepath;
+	this->fs_filepath = fs_filepath;
+	vertex_shader = 0;
+	fragment_shader = 0;
+	cache_filepath.clear();
+	loading = true;
+
+	std::string vs_source, fs_source;
+	if (!read_shader_source(vs_filepath, vs_source) || !read_shader_source(fs_filepath, fs_source))
+	{
+		std::cout << "Error reading shader " << vs_filepath << " or " << fs_filepath << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
 	program = glCreateProgram();
 
-	glAttachShader(program, compiled_vs_id);
-	glAttachShader(program, compiled_fs_id);
+	//a binary is only valid for the driver that made it, so the driver strings are part of the key
+	bool use_cache = !program_cache_directory.empty() && GLEW_ARB_get_program_binary;
+	if (use_cache)
+	{
+		GLint num_binary_formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_binary_formats);
+		use_cache = num_binary_formats > 0;
+	}
+
+	if (use_cache)
+	{
+		cache_key = hash_string(vs_source);
+		cache_key = hash_string(fs_source, cache_key);
+		cache_key = hash_string(defines.get_key(), cache_key);
+		cache_key = hash_string((const char*)glGetString(GL_VENDOR), cache_key);
+		cache_key = hash_string((const char*)glGetString(GL_RENDERER), cache_key);
+		cache_key = hash_string((const char*)glGetString(GL_VERSION), cache_key);
+
+		char filename[32];
+		sprintf(filename, "%016llx.bin", cache_key);
+		cache_filepath = program_cache_directory + filename;
+
+		if (load_program_binary())
+		{
+			cache_filepath.clear(); // nothing to save
+			return;
+		}
+
+		//the driver rejected the binary or there was none, start over from the source
+		glDeleteProgram(program);
+		program = glCreateProgram();
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+
+	//no status is queried until finish_load_shader_program, so the driver can compile several programs at once
+	vertex_shader = submit_shader(vs_source, GL_VERTEX_SHADER, defines);
+	fragment_shader = submit_shader(fs_source, GL_FRAGMENT_SHADER, defines);
+	glAttachShader(program, vertex_shader);
+	glAttachShader(program, fragment_shader);
 	glLinkProgram(program);
+}
+
+void Shader::finish_load_shader_program()
+{
+	BEY_PROFILE_ZONE("shader link");
+	if (!loading)
+	{
+		return;
+	}
+	loading = false;
+
+	GLint link_status;
+
+	//a program loaded from the cache has no shaders to check
+	if (vertex_shader != 0)
+	{
+		check_shader(vertex_shader, vs_filepath);
+		check_shader(fragment_shader, fs_filepath);
+	}
 	glGetProgramiv(program, GL_LINK_STATUS, &link_status);
 
 	if (link_status == GL_FALSE)
@@ -95,14 +305,67 @@ void Shader::load_shader_program(const std::string& vs_filepath, const std::stri
 		exit(EXIT_FAILURE);		
 	}
 
+	if (!cache_filepath.empty())
+	{
+		save_program_binary();
+	}
+
 	//load all the attributes
 	posL_attribute = glGetAttribLocation(program, "a_posL");
 	color_attribute = glGetAttribLocation(program, "a_color");
 	uv_attribute = glGetAttribLocation(program, "a_uv");
 	normal_attribute = glGetAttribLocation(program, "a_normalL");
+}
 
-	this->vs_filepath = vs_filepath;
-	this->fs_filepath = fs_filepath;
+bool Shader::load_program_binary()
+{
+	FILE * pf;
+	if (fopen_s(&pf, cache_filepath.c_str(), "rb") != 0)
+		return false;
+
+	ProgramCacheHeader header;
+	std::string binary;
+	bool valid = fread(&header, sizeof(header), 1, pf) == 1 && header.magic == program_cache_magic && header.key == cache_key && header.binary_length > 0;
+	if (valid)
+	{
+		binary.resize(header.binary_length);
+		valid = fread(&binary[0], 1, header.binary_length, pf) == (size_t)header.binary_length;
+	}
+	fclose(pf);
+
+	if (!valid)
+	{
+		return false;
+	}
+
+	GLint link_status;
+	glProgramBinary(program, header.binary_format, binary.data(), header.binary_length);
+	glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+	return link_status == GL_TRUE;
+}
+
+void Shader::save_program_binary() const
+{
+	ProgramCacheHeader header;
+	header.magic = program_cache_magic;
+	header.binary_length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &header.binary_length);
+	if (header.binary_length <= 0)
+	{
+		return;
+	}
+
+	std::string binary(header.binary_length, 0);
+	glGetProgramBinary(program, header.binary_length, NULL, &header.binary_format, &binary[0]);
+
+	header.key = cache_key;
+
+	FILE * pf;
+	if (fopen_s(&pf, cache_filepath.c_str(), "wb") != 0)
+		return; // the cache directory is missing or read only, the program is compiled again next time
+	fwrite(&header, sizeof(header), 1, pf);
+	fwrite(binary.data(), 1, binary.size(), pf);
+	fclose(pf);
 }
 
 void Shader::bind() const
@@ -113,4 +376,32 @@ void Shader::bind() const
 void Shader::unbind() const
 {
 	glUseProgram(0);
+}
+
+void ShaderVariants::initialize(const std::string& vs_filepath, const std::string& fs_filepath)
+{
+	this->vs_filepath = vs_filepath;
+	this->fs_filepath = fs_filepath;
+}
+
+void ShaderVariants::prepare_variant(const ShaderDefines& defines)
+{
+	std::string key = defines.get_key();
+	if (variants.find(key) == variants.end())
+	{
+		variants[key].begin_load_shader_program(vs_filepath, fs_filepath, defines);
+	}
+}
+
+const Shader& ShaderVariants::get_variant(const ShaderDefines& defines)
+{
+	prepare_variant(defines);
+	Shader& shader = variants[defines.get_key()];
+	shader.finish_load_shader_program();
+	return shader;
+}
+
+size_t ShaderVariants::get_num_variants() const
+{
+	return variants.size();
 }
\ No newline at end of file
@@ -1,16 +1,39 @@
 #pragma once
 
 #include <GL/glew.h>
+#include <map>
 #include <string>
 
 namespace bey
 {
+	// preprocessor defines a shader source is compiled with. they are kept sorted by name, so the same set always makes the same key
+	class ShaderDefines
+	{
+	private:
+		std::map<std::string, int> defines;
+
+	public:
+		void set(const std::string& name, int value = 1);
+		std::string get_key() const; // e.g. "COMPACT_G_BUFFER=1;SPOT_LIGHT=1"
+		std::string get_source() const; // one #define line per define
+	};
 
 	class Shader
 	{		
 	private:
 		std::string vs_filepath;
 		std::string fs_filepath;
+		std::string cache_filepath; // where the linked program is saved, empty when it doesn't need to be
+		unsigned long long cache_key; // hash of the sources, the defines and the driver
+		bool loading; // between begin_load_shader_program and finish_load_shader_program
+
+		// linked program binaries are saved here and loaded instead of compiling the sources again. empty turns the cache off
+		static std::string program_cache_directory;
+
+		GLuint submit_shader(const std::string& source, GLint shader_type, const ShaderDefines& defines);
+		void check_shader(GLuint shader, const std::string& filepath);
+		bool load_program_binary();
+		void save_program_binary() const;
 
 	public:
 
@@ -25,10 +48,32 @@ namespace bey
 		Shader();
 		~Shader();
 		
-		GLuint compile_shader(const std::string& filepath, GLint shader_type);
-		void load_shader_program(const std::string& vs_filepath, const std::string& fs_filepath);
+		static void set_program_cache_directory(const std::string& directory);
+
+		GLuint compile_shader(const std::string& filepath, GLint shader_type, const ShaderDefines& defines = ShaderDefines());
+		void load_shader_program(const std::string& vs_filepath, const std::string& fs_filepath, const ShaderDefines& defines = ShaderDefines());
+		// load_shader_program in two halves. begin only submits the work, so the driver can compile programs in parallel until
+		// finish waits for the result
+		void begin_load_shader_program(const std::string& vs_filepath, const std::string& fs_filepath, const ShaderDefines& defines = ShaderDefines());
+		void finish_load_shader_program();
 		void bind() const;
 		void unbind() const;
 	};
 
+	// the permutations of one vertex and fragment shader source. a variant is compiled the first time its defines are asked for,
+	// so features a light doesn't use are compiled out instead of branched over at runtime
+	class ShaderVariants
+	{
+	private:
+		std::string vs_filepath;
+		std::string fs_filepath;
+		std::map<std::string, Shader> variants;
+
+	public:
+		void initialize(const std::string& vs_filepath, const std::string& fs_filepath);
+		void prepare_variant(const ShaderDefines& defines); // starts compiling the variant without waiting for it
+		const Shader& get_variant(const ShaderDefines& defines);
+		size_t get_num_variants() const;
+	};
+
 }
\ No newline at end of file
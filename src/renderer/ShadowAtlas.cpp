@@ -0,0 +1,135 @@
+#include "renderer/ShadowAtlas.hpp"
+#include <algorithm>
+#include "renderer/GlStats.hpp"
+
+using namespace bey;
+
+// takes every other bit of value, starting from the lowest one
+static int compact_bits(unsigned int value)
+{
+	value &= 0x55555555;
+	value = (value | (value >> 1)) & 0x33333333;
+	value = (value | (value >> 2)) & 0x0F0F0F0F;
+	value = (value | (value >> 4)) & 0x00FF00FF;
+	value = (value | (value >> 8)) & 0x0000FFFF;
+	return (int)value;
+}
+
+ShadowAtlas::ShadowAtlas()
+{
+}
+
+ShadowAtlas::~ShadowAtlas()
+{
+}
+
+void ShadowAtlas::initialize(int atlas_size, int max_tile_size, int min_tile_size, ShadowMap::DepthFormat depth_format, bool debug)
+{
+	this->atlas_size = atlas_size;
+	this->max_tile_size = std::min(max_tile_size, atlas_size);
+	this->min_tile_size = min_tile_size;
+
+	shadow_map.initialize(atlas_size, atlas_size, depth_format, debug);
+}
+
+void ShadowAtlas::set_max_tile_size(int max_tile_size)
+{
+	this->max_tile_size = std::max(std::min(max_tile_size, atlas_size), min_tile_size);
+}
+
+int ShadowAtlas::get_max_tile_size() const
+{
+	return max_tile_size;
+}
+
+int ShadowAtlas::calc_tile_size(float screen_coverage) const
+{
+	int size = min_tile_size;
+	while (size < max_tile_size && size < screen_coverage * max_tile_size)
+	{
+		size *= 2;
+	}
+	return size;
+}
+
+void ShadowAtlas::allocate_tiles(const std::vector<int>& requested_sizes, std::vector<Tile>& tiles) const
+{
+	tiles.assign(requested_sizes.size(), Tile());
+
+	// place the biggest tiles first. walking the atlas along a morton curve in units of the smallest tile,
+	// every tile then starts on a cell index that is a multiple of its own area, so it is always square and aligned
+	std::vector<int> order;
+	for (size_t i = 0; i < requested_sizes.size(); i++)
+	{
+		if (requested_sizes[i] > 0)
+		{
+			order.push_back((int)i);
+		}
+	}
+	std::stable_sort(order.begin(), order.end(), [&requested_sizes](int a, int b) { return requested_sizes[a] > requested_sizes[b]; });
+
+	const int cells_per_side = atlas_size / min_tile_size;
+	const int total_cells = cells_per_side * cells_per_side;
+	int used_cells = 0;
+
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		int size = std::min(requested_sizes[order[i]], max_tile_size);
+		int cells = (size / min_tile_size) * (size / min_tile_size);
+
+		// atlas is full, shrink the tile until it fits
+		while (used_cells + cells > total_cells && size > min_tile_size)
+		{
+			size /= 2;
+			cells /= 4;
+		}
+
+		if (used_cells + cells > total_cells)
+		{
+			break;
+		}
+
+		Tile& tile = tiles[order[i]];
+		tile.x = compact_bits(used_cells) * min_tile_size;
+		tile.y = compact_bits(used_cells >> 1) * min_tile_size;
+		tile.size = size;
+		used_cells += cells;
+	}
+}
+
+void ShadowAtlas::begin_shadow_pass()
+{
+	shadow_map.bind_first_pass(false);
+	glDepthMask(GL_TRUE);
+	glEnable(GL_SCISSOR_TEST);
+}
+
+void ShadowAtlas::bind_tile(const Tile& tile)
+{
+	// only the tile is cleared, the rest of the atlas belongs to the other lights
+	glViewport(tile.x, tile.y, tile.size, tile.size);
+	glScissor(tile.x, tile.y, tile.size, tile.size);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void ShadowAtlas::end_shadow_pass()
+{
+	glDisable(GL_SCISSOR_TEST);
+	shadow_map.unbind_first_pass();
+}
+
+glm::vec4 ShadowAtlas::get_tile_transform(const Tile& tile) const
+{
+	float inv_size = 1.0f / atlas_size;
+	return glm::vec4(tile.x * inv_size, tile.y * inv_size, tile.size * inv_size, tile.size * inv_size);
+}
+
+const ShadowMap& ShadowAtlas::get_shadow_map() const
+{
+	return shadow_map;
+}
+
+int ShadowAtlas::get_size() const
+{
+	return atlas_size;
+}
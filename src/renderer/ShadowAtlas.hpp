@@ -0,0 +1,53 @@
+#pragma once
+
+#include "renderer/ShadowMap.hpp"
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace bey
+{
+	// packs the shadow maps of several lights into square tiles of one large depth texture.
+	// all tiles are rendered up front, so the light passes never have to switch back to a shadow framebuffer
+	class ShadowAtlas
+	{
+	public:
+		struct Tile
+		{
+			int x;
+			int y;
+			int size; // 0 means no tile was given to the light
+
+			Tile() : x(0), y(0), size(0) {}
+		};
+
+		ShadowAtlas();
+		~ShadowAtlas();
+
+		// all sizes have to be power of two
+		void initialize(int atlas_size, int max_tile_size, int min_tile_size, ShadowMap::DepthFormat depth_format = ShadowMap::DepthFormat::DEPTH24, bool debug = ShadowMap::default_debug);
+
+		// caps the tiles handed out from now on, between the smallest tile size and the atlas size
+		void set_max_tile_size(int max_tile_size);
+		int get_max_tile_size() const;
+
+		// the tile size a light gets, from the fraction of the screen height [0, 1] its volume covers
+		int calc_tile_size(float screen_coverage) const;
+		// packs one tile per requested size (0 means no tile requested). tiles that do not fit are shrunk, or dropped when even the smallest size does not fit
+		void allocate_tiles(const std::vector<int>& requested_sizes, std::vector<Tile>& tiles) const;
+
+		void begin_shadow_pass();
+		void bind_tile(const Tile& tile);
+		void end_shadow_pass();
+
+		glm::vec4 get_tile_transform(const Tile& tile) const; // xy : uv offset, zw : uv scale
+		const ShadowMap& get_shadow_map() const;
+		int get_size() const;
+
+	private:
+		ShadowMap shadow_map;
+		int atlas_size;
+		int max_tile_size;
+		int min_tile_size;
+	};
+}
@@ -2,9 +2,22 @@
 #include "scene/Vertex.hpp"
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
+#include "renderer/GlStats.hpp"
 
 using namespace bey;
-static const bool debug = true;
+
+static GLenum get_internal_format(ShadowMap::DepthFormat depth_format)
+{
+	switch (depth_format)
+	{
+	case ShadowMap::DepthFormat::DEPTH16:
+		return GL_DEPTH_COMPONENT16;
+	case ShadowMap::DepthFormat::DEPTH32F:
+		return GL_DEPTH_COMPONENT32F;
+	default:
+		return GL_DEPTH_COMPONENT24;
+	}
+}
 
 ShadowMap::ShadowMap()
 {
@@ -14,26 +27,43 @@ ShadowMap::~ShadowMap()
 {
 }
 
-void ShadowMap::initialize(int screen_width, int screen_height)
+void ShadowMap::initialize(int width, int height, DepthFormat depth_format, bool debug)
 {
-	shader_first_pass.load_shader_program("../../shaders/shadow_first_pass.vs", "../../shaders/shadow_first_pass.fs");
+	this->width = width;
+	this->height = height;
+	this->depth_format = depth_format;
+	this->debug = debug;
+
+	//without debug, the first pass only writes depth, so the fragment shader does not need to fetch any texture
+	if (debug)
+	{
+		shader_first_pass.load_shader_program("../../shaders/shadow_first_pass.vs", "../../shaders/shadow_first_pass.fs");
+	}
+	else
+	{
+		shader_first_pass.load_shader_program("../../shaders/shadow_first_pass.vs", "../../shaders/shadow_depth_pass.fs");
+	}
 	shader_second_pass.load_shader_program("../../shaders/shadow_second_pass.vs", "../../shaders/shadow_second_pass.fs");
 
 	glGenFramebuffers(1, &fbo_id);
 	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo_id);
 
-	// for debugging, color attachment
-	glGenTextures(1, &debug_texture_id);
-	glBindTexture(GL_TEXTURE_2D, debug_texture_id);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, screen_width, screen_height, 0, GL_RGBA, GL_FLOAT, nullptr);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, debug_texture_id, 0);
+	debug_texture_id = 0;
+	if (debug)
+	{
+		// for debugging, color attachment
+		glGenTextures(1, &debug_texture_id);
+		glBindTexture(GL_TEXTURE_2D, debug_texture_id);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, debug_texture_id, 0);
+	}
 
 	//shadow map will only store depth values
 	glGenTextures(1, &shadow_texture_id);
 	glBindTexture(GL_TEXTURE_2D, shadow_texture_id);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, screen_width, screen_height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+	glTexImage2D(GL_TEXTURE_2D, 0, get_internal_format(depth_format), width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
 	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -41,13 +71,16 @@ void ShadowMap::initialize(int screen_width, int screen_height)
 
 	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, shadow_texture_id, 0);
 
-	//for debugging
-	GLenum draw_buffers[] = { GL_COLOR_ATTACHMENT0 };
-	glDrawBuffers(1, draw_buffers);
-	//this should be the actual draw buffer
-	//glDrawBuffer(GL_NONE); // we never write any color to color buffer, so we dont need draw buffer	
-	
-	//glReadBuffer(GL_NONE);
+	if (debug)
+	{
+		GLenum draw_buffers[] = { GL_COLOR_ATTACHMENT0 };
+		glDrawBuffers(1, draw_buffers);
+	}
+	else
+	{
+		glDrawBuffer(GL_NONE); // we never write any color to color buffer, so we dont need draw buffer
+		glReadBuffer(GL_NONE);
+	}
 
 	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
 
@@ -60,16 +93,19 @@ void ShadowMap::initialize(int screen_width, int screen_height)
 	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 }
 
-void ShadowMap::bind_first_pass()
+void ShadowMap::bind_first_pass(bool clear)
 {
 	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo_id);
 	shader_first_pass.bind();
 
-	GLenum draw_buffers[] = { GL_COLOR_ATTACHMENT0 };
-	glDrawBuffers(1, draw_buffers);
+	// the shadow map is not necessarily the size of the screen, the caller restores the viewport afterwards
+	glViewport(0, 0, width, height);
 
-	//clear the shadow texture
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // color bit perhaps does not need to be cleared ? 
+	//clear the shadow texture. callers that only update part of the texture (e.g the shadow atlas) clear per region instead
+	if (clear)
+	{
+		glClear(debug ? GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT : GL_DEPTH_BUFFER_BIT);
+	}
 }
 
 void ShadowMap::unbind_first_pass()
@@ -78,14 +114,14 @@ void ShadowMap::unbind_first_pass()
 	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 }
 
-void ShadowMap::bind_second_pass()
+void ShadowMap::bind_second_pass() const
 {
 	shader_second_pass.bind();
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_2D, shadow_texture_id);
 }
 
-void ShadowMap::unbind_second_pass()
+void ShadowMap::unbind_second_pass() const
 {
 	shader_second_pass.unbind();
 }
@@ -110,14 +146,37 @@ void ShadowMap::set_matrix_first_pass(const glm::mat4& matrix)
 
 void ShadowMap::dump_shadow_texture(int screen_width, int screen_height)
 {
+	//only the debug color attachment can be blitted to the screen
+	if (!debug)
+	{
+		return;
+	}
+
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo_id);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	
 	glReadBuffer(GL_COLOR_ATTACHMENT0 + 0);
-	glBlitFramebuffer(0, 0, screen_width, screen_height, 0, 0, screen_width, screen_height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, screen_width, screen_height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+}
+
+void ShadowMap::copy_from(const ShadowMap& source)
+{
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, source.fbo_id);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo_id);
+
+	GLbitfield mask = GL_DEPTH_BUFFER_BIT;
+	if (debug && source.debug)
+	{
+		glReadBuffer(GL_COLOR_ATTACHMENT0);
+		mask |= GL_COLOR_BUFFER_BIT;
+	}
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, mask, GL_NEAREST);
 
 	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 }
 
 const Shader& ShadowMap::get_first_pass_shader() const
@@ -133,4 +192,54 @@ const Shader& ShadowMap::get_second_pass_shader() const
 GLuint ShadowMap::get_shadow_texture_id() const
 {
 	return shadow_texture_id;
-}
\ No newline at end of file
+}
+
+int ShadowMap::get_width() const
+{
+	return width;
+}
+
+int ShadowMap::get_height() const
+{
+	return height;
+}
+
+ShadowMap::DepthFormat ShadowMap::get_depth_format() const
+{
+	return depth_format;
+}
+
+bool ShadowMap::is_debug() const
+{
+	return debug;
+}
+
+size_t ShadowMap::get_memory_size() const
+{
+	size_t num_texels = (size_t)width * height;
+	size_t size = num_texels * get_bytes_per_texel(depth_format);
+	if (debug)
+	{
+		size += num_texels * debug_color_bytes_per_texel;
+	}
+	return size;
+}
+
+int ShadowMap::get_bytes_per_texel(DepthFormat depth_format)
+{
+	// depth 24 is padded to 4 bytes by the drivers
+	return depth_format == DepthFormat::DEPTH16 ? 2 : 4;
+}
+
+const char* ShadowMap::get_depth_format_name(DepthFormat depth_format)
+{
+	switch (depth_format)
+	{
+	case DepthFormat::DEPTH16:
+		return "depth16";
+	case DepthFormat::DEPTH32F:
+		return "depth32f";
+	default:
+		return "depth24";
+	}
+}
@@ -9,24 +9,50 @@ namespace bey
 	class ShadowMap
 	{
 	public :
+		enum class DepthFormat
+		{
+			DEPTH16,
+			DEPTH24,
+			DEPTH32F,
+		};
+
+#ifdef NDEBUG
+		static const bool default_debug = false;
+#else
+		static const bool default_debug = true;
+#endif
+
 		ShadowMap();
 		~ShadowMap();
 
-		void initialize(int screen_width, int screen_height);
-		void bind_first_pass();
+		// the size of the shadow map is independent of the screen. without debug the framebuffer is depth only,
+		// with debug it also gets a color attachment that shows the diffuse texture of the shadow casters
+		void initialize(int width, int height, DepthFormat depth_format = DepthFormat::DEPTH24, bool debug = default_debug);
+		void bind_first_pass(bool clear = true);
 		void unbind_first_pass();		
 
-		void bind_second_pass();
-		void unbind_second_pass();
+		void bind_second_pass() const;
+		void unbind_second_pass() const;
 
 		void set_attribute_first_pass();
 		void set_matrix_first_pass(const glm::mat4& matrix);
 		void dump_shadow_texture(int screen_width, int screen_height);
+		// copies depth (and the debug color) of a shadow map with the same size and format
+		void copy_from(const ShadowMap& source);
 
 		const Shader& get_first_pass_shader() const;
 		const Shader& get_second_pass_shader() const;
 
 		GLuint get_shadow_texture_id() const;
+		int get_width() const;
+		int get_height() const;
+		DepthFormat get_depth_format() const;
+		bool is_debug() const;
+		size_t get_memory_size() const; // bytes used by the depth texture, and the color attachment in debug
+
+		static int get_bytes_per_texel(DepthFormat depth_format);
+		static const char* get_depth_format_name(DepthFormat depth_format);
+		static const int debug_color_bytes_per_texel = 16; // RGBA32F
 
 	private:
 		GLuint fbo_id;				
@@ -34,5 +60,9 @@ namespace bey
 		Shader shader_first_pass;
 		Shader shader_second_pass;
 		GLuint debug_texture_id;
+		int width;
+		int height;
+		DepthFormat depth_format;
+		bool debug;
 	};
 }
\ No newline at end of file
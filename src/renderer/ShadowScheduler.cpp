@@ -0,0 +1,190 @@
+#include "renderer/ShadowScheduler.hpp"
+#include <algorithm>
+#include <limits>
+
+using namespace bey;
+
+// weights of the priority terms
+static const float distance_falloff = 0.05f;
+static const float moving_light_boost = 4.0f;
+static const float static_light_factor = 0.25f; // the cached map of a light that did not move is most likely still right
+static const float aging_rate = 1.0f;
+
+static bool same_tile(const ShadowAtlas::Tile& a, const ShadowAtlas::Tile& b)
+{
+	return a.x == b.x && a.y == b.y && a.size == b.size;
+}
+
+static bool same_matrix(const glm::mat4& a, const glm::mat4& b)
+{
+	const float epsilon = 1e-5f;
+	for (int i = 0; i < 4; i++)
+	{
+		glm::vec4 difference = glm::abs(a[i] - b[i]);
+		if (difference.x > epsilon || difference.y > epsilon || difference.z > epsilon || difference.w > epsilon)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+ShadowScheduler::ShadowScheduler() : num_updated(0), num_deferred(0), num_stale(0), num_triangles(0)
+{
+}
+
+ShadowScheduler::~ShadowScheduler()
+{
+}
+
+void ShadowScheduler::set_budget(const Budget& budget)
+{
+	this->budget = budget;
+}
+
+const ShadowScheduler::Budget& ShadowScheduler::get_budget() const
+{
+	return budget;
+}
+
+void ShadowScheduler::begin_frame(size_t num_lights)
+{
+	light_states.resize(num_lights);
+	for (size_t i = 0; i < light_states.size(); i++)
+	{
+		light_states[i].updated = false;
+	}
+
+	num_updated = 0;
+	num_triangles = 0;
+}
+
+int ShadowScheduler::stabilize_tile_size(int light_index, int tile_size) const
+{
+	const LightState& state = light_states[light_index];
+	if (state.valid && tile_size < state.tile.size && tile_size * 2 >= state.tile.size)
+	{
+		return state.tile.size;
+	}
+	return tile_size;
+}
+
+bool ShadowScheduler::is_mandatory(const Candidate& candidate) const
+{
+	const LightState& state = light_states[candidate.light_index];
+	return !state.valid || !same_tile(state.tile, candidate.tile);
+}
+
+float ShadowScheduler::calc_priority(const Candidate& candidate) const
+{
+	const LightState& state = light_states[candidate.light_index];
+	float priority = candidate.screen_coverage / (1.0f + candidate.distance * distance_falloff);
+	priority *= same_matrix(state.proj_view, candidate.proj_view) ? static_light_factor : moving_light_boost;
+	return priority * (1.0f + state.age * aging_rate);
+}
+
+void ShadowScheduler::schedule(std::vector<Candidate>& candidates) const
+{
+	std::vector<float> priorities(light_states.size(), 0.0f);
+	for (size_t i = 0; i < candidates.size(); i++)
+	{
+		// mandatory updates are pushed to the front
+		priorities[candidates[i].light_index] = is_mandatory(candidates[i]) ? std::numeric_limits<float>::max() : calc_priority(candidates[i]);
+	}
+
+	std::stable_sort(candidates.begin(), candidates.end(), [&priorities](const Candidate& a, const Candidate& b)
+	{
+		return priorities[a.light_index] > priorities[b.light_index];
+	});
+}
+
+bool ShadowScheduler::has_budget_left(float elapsed_milliseconds) const
+{
+	if (budget.max_updates > 0 && num_updated >= budget.max_updates)
+	{
+		return false;
+	}
+
+	if (budget.max_triangles > 0 && num_triangles >= budget.max_triangles)
+	{
+		return false;
+	}
+
+	if (budget.max_milliseconds > 0.0f && elapsed_milliseconds >= budget.max_milliseconds)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+void ShadowScheduler::mark_updated(const Candidate& candidate)
+{
+	LightState& state = light_states[candidate.light_index];
+	state.valid = true;
+	state.tile = candidate.tile;
+	state.proj_view = candidate.proj_view;
+	state.age = 0;
+	state.updated = true;
+
+	num_updated++;
+	num_triangles += candidate.num_triangles;
+}
+
+void ShadowScheduler::end_frame(const std::vector<Candidate>& candidates)
+{
+	num_deferred = 0;
+	num_stale = 0;
+	std::vector<bool> visible(light_states.size(), false);
+	for (size_t i = 0; i < candidates.size(); i++)
+	{
+		LightState& state = light_states[candidates[i].light_index];
+		visible[candidates[i].light_index] = true;
+		if (!state.updated)
+		{
+			state.age++;
+			num_deferred++;
+			if (candidates[i].tile.size > 0 && (!state.valid || !same_tile(state.tile, candidates[i].tile) || !same_matrix(state.proj_view, candidates[i].proj_view)))
+			{
+				num_stale++;
+			}
+		}
+	}
+
+	// lights that went out of view or did not fit in the atlas lost their tile, their next update will be a mandatory one
+	for (size_t i = 0; i < candidates.size(); i++)
+	{
+		if (candidates[i].tile.size == 0)
+		{
+			visible[candidates[i].light_index] = false;
+		}
+	}
+
+	for (size_t i = 0; i < light_states.size(); i++)
+	{
+		if (!visible[i])
+		{
+			light_states[i].valid = false;
+		}
+	}
+}
+
+const glm::mat4& ShadowScheduler::get_shadow_proj_view(int light_index) const
+{
+	return light_states[light_index].proj_view;
+}
+
+int ShadowScheduler::get_num_updated() const
+{
+	return num_updated;
+}
+
+int ShadowScheduler::get_num_deferred() const
+{
+	return num_deferred;
+}
+
+int ShadowScheduler::get_num_stale() const
+{
+	return num_stale;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "renderer/ShadowAtlas.hpp"
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace bey
+{
+	// decides which spot light shadows get re-rendered into the shadow atlas each frame.
+	// lights are ranked by screen coverage, distance and motion, and only the best ones are updated until the budget
+	// runs out. the others keep their last shadow map, and their priority grows every frame they wait so none of them starves
+	class ShadowScheduler
+	{
+	public:
+		struct Budget
+		{
+			int max_updates; // shadow maps re-rendered per frame, 0 means no limit
+			size_t max_triangles; // triangles submitted to shadow maps per frame, 0 means no limit
+			float max_milliseconds; // cpu time spent submitting shadow maps per frame, 0 means no limit
+
+			Budget() : max_updates(4), max_triangles(0), max_milliseconds(0.0f) {}
+		};
+
+		struct Candidate
+		{
+			int light_index;
+			float screen_coverage; // [0, 1] fraction of the screen height covered by the light
+			float distance; // from the camera to the light's bounding sphere
+			glm::mat4 proj_view; // the light's current shadow matrix
+			ShadowAtlas::Tile tile; // the light's tile for this frame
+			size_t num_triangles; // cost of rendering the light's shadow map
+		};
+
+		ShadowScheduler();
+		~ShadowScheduler();
+
+		void set_budget(const Budget& budget);
+		const Budget& get_budget() const;
+
+		void begin_frame(size_t num_lights);
+		// only shrink a light's tile once it is less than half of what it had, so the tiles (and their cached content) stay put
+		int stabilize_tile_size(int light_index, int tile_size) const;
+		// sorts the candidates in update order. lights without a usable cached map come first
+		void schedule(std::vector<Candidate>& candidates) const;
+		// a mandatory update ignores the budget, there is no cached shadow map to fall back to
+		bool is_mandatory(const Candidate& candidate) const;
+		bool has_budget_left(float elapsed_milliseconds) const;
+		void mark_updated(const Candidate& candidate);
+		void end_frame(const std::vector<Candidate>& candidates);
+
+		// the shadow matrix the light's cached tile was rendered with
+		const glm::mat4& get_shadow_proj_view(int light_index) const;
+
+		int get_num_updated() const; // shadow maps re-rendered during the last frame
+		int get_num_deferred() const; // visible lights that reused an old shadow map during the last frame
+		// deferred lights whose old shadow map no longer matches their matrix or their tile. lights without a tile are not counted
+		int get_num_stale() const;
+
+	private:
+		struct LightState
+		{
+			bool valid; // whether the atlas still holds a shadow map for this light
+			ShadowAtlas::Tile tile;
+			glm::mat4 proj_view;
+			int age; // frames since the light's shadow map was last rendered
+			bool updated; // during the current frame
+
+			LightState() : valid(false), age(0), updated(false) {}
+		};
+
+		float calc_priority(const Candidate& candidate) const;
+
+		Budget budget;
+		std::vector<LightState> light_states;
+		int num_updated;
+		int num_deferred;
+		int num_stale;
+		size_t num_triangles;
+	};
+}
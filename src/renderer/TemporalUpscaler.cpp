@@ -0,0 +1,145 @@
+#include "renderer/TemporalUpscaler.hpp"
+#include <glm/gtc/type_ptr.hpp>
+#include <iostream>
+#include "renderer/GlStats.hpp"
+
+using namespace bey;
+
+// radical inverse of index in the given base, in [0, 1)
+static float calc_halton(int index, int base)
+{
+	float result = 0.0f;
+	float fraction = 1.0f / base;
+	while (index > 0)
+	{
+		result += (index % base) * fraction;
+		index /= base;
+		fraction /= base;
+	}
+	return result;
+}
+
+TemporalUpscaler::TemporalUpscaler() : width(0), height(0), current(0), history_valid(false), jitter_index(0)
+{
+	fbo_ids[0] = fbo_ids[1] = 0;
+	history_ids[0] = history_ids[1] = 0;
+}
+
+TemporalUpscaler::~TemporalUpscaler()
+{
+}
+
+void TemporalUpscaler::initialize(int window_width, int window_height)
+{
+	glGenFramebuffers(2, fbo_ids);
+	glGenTextures(2, history_ids);
+
+	for (int i = 0; i < 2; i++)
+	{
+		// the history is read bilinearly at the reprojected position
+		glBindTexture(GL_TEXTURE_2D, history_ids[i]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	resize(window_width, window_height);
+}
+
+void TemporalUpscaler::resize(int window_width, int window_height)
+{
+	width = window_width;
+	height = window_height;
+
+	for (int i = 0; i < 2; i++)
+	{
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo_ids[i]);
+		glBindTexture(GL_TEXTURE_2D, history_ids[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, history_ids[i], 0);
+
+		GLenum status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+		if (status != GL_FRAMEBUFFER_COMPLETE) {
+			std::cerr << "FB error, status: 0x" << status << std::endl;
+			exit(EXIT_FAILURE);
+			return;
+		}
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+	reset();
+}
+
+void TemporalUpscaler::reset()
+{
+	history_valid = false;
+}
+
+glm::vec2 TemporalUpscaler::next_jitter(int width, int height)
+{
+	// halton starts at index 1, index 0 would put every first sample in the pixel's corner
+	jitter_index = jitter_index % NUM_JITTER_SAMPLES + 1;
+	glm::vec2 pixel_offset = glm::vec2(calc_halton(jitter_index, 2), calc_halton(jitter_index, 3)) - 0.5f;
+	return pixel_offset * 2.0f / glm::vec2(width, height);
+}
+
+void TemporalUpscaler::begin_resolve(const Shader& shader, int texture_unit)
+{
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo_ids[1 - current]);
+	glViewport(0, 0, width, height);
+
+	GLint uni_history = glGetUniformLocation(shader.program, "u_history");
+	if (uni_history != -1)
+	{
+		glActiveTexture(GL_TEXTURE0 + texture_unit);
+		glBindTexture(GL_TEXTURE_2D, history_ids[current]);
+		glUniform1i(uni_history, texture_unit);
+	}
+
+	GLint uni_history_valid = glGetUniformLocation(shader.program, "u_history_valid");
+	if (uni_history_valid != -1)
+	{
+		glUniform1i(uni_history_valid, history_valid);
+	}
+
+	GLint uni_prev_proj_view = glGetUniformLocation(shader.program, "u_prev_proj_view");
+	if (uni_prev_proj_view != -1)
+	{
+		glUniformMatrix4fv(uni_prev_proj_view, 1, GL_FALSE, glm::value_ptr(prev_proj_view));
+	}
+}
+
+void TemporalUpscaler::end_resolve(const glm::mat4& proj_view)
+{
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	current = 1 - current;
+	prev_proj_view = proj_view;
+	history_valid = true;
+}
+
+void TemporalUpscaler::present()
+{
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo_ids[current]);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+}
+
+int TemporalUpscaler::get_width() const
+{
+	return width;
+}
+
+int TemporalUpscaler::get_height() const
+{
+	return height;
+}
+
+size_t TemporalUpscaler::get_memory_size() const
+{
+	// two rgba16f histories
+	return (size_t)width * height * 8 * 2;
+}
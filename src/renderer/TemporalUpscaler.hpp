@@ -0,0 +1,53 @@
+#pragma once
+
+#include "renderer/Shader.hpp"
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+namespace bey
+{
+	// upscales the light accumulation to the window over several frames. every frame is rendered with the camera's projection moved
+	// by a different sub-pixel offset, and its pixels are accumulated into a history at the window's resolution. the history is
+	// reprojected with the depth and the view projection of the previous frame, and clamped to the colors around each pixel
+	// so what the history saw before a disocclusion does not ghost
+	class TemporalUpscaler
+	{
+	public:
+		static const int NUM_JITTER_SAMPLES = 16; // halton (2, 3) sequence
+		// frames after which a still image has converged, each new frame is blended in with a weight under 0.1
+		static const int NUM_CONVERGENCE_FRAMES = 3 * NUM_JITTER_SAMPLES;
+
+		TemporalUpscaler();
+		~TemporalUpscaler();
+
+		void initialize(int window_width, int window_height);
+		// reallocates the history, it starts over
+		void resize(int window_width, int window_height);
+		// the next resolve ignores the history
+		void reset();
+
+		// the jitter, in ndc, of the next frame rendered at width x height. every call moves along the sequence
+		glm::vec2 next_jitter(int width, int height);
+
+		// binds the history target that is written next, and the history of the previous frames to texture_unit
+		void begin_resolve(const Shader& shader, int texture_unit);
+		// proj_view is the unjittered view projection of the frame that was just resolved, the next frame reprojects with it
+		void end_resolve(const glm::mat4& proj_view);
+		// copies the history that was resolved last to the default framebuffer
+		void present();
+
+		int get_width() const;
+		int get_height() const;
+		size_t get_memory_size() const; // bytes of both histories
+
+	private:
+		int width;
+		int height;
+		GLuint fbo_ids[2];
+		GLuint history_ids[2];
+		int current; // the history resolved last
+		bool history_valid;
+		glm::mat4 prev_proj_view;
+		int jitter_index;
+	};
+}
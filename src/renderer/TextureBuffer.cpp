@@ -0,0 +1,54 @@
+#include "renderer/TextureBuffer.hpp"
+#include <glm/glm.hpp>
+#include "renderer/GlStats.hpp"
+
+using namespace bey;
+
+TextureBuffer::TextureBuffer() : buffer_id(0), texture_id(0)
+{
+}
+
+TextureBuffer::~TextureBuffer()
+{
+}
+
+void TextureBuffer::initialize(GLenum internal_format)
+{
+	glGenBuffers(1, &buffer_id);
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer_id);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::vec4), nullptr, GL_STREAM_DRAW); // never empty, it is resized on upload
+
+	glGenTextures(1, &texture_id);
+	glBindTexture(GL_TEXTURE_BUFFER, texture_id);
+	glTexBuffer(GL_TEXTURE_BUFFER, internal_format, buffer_id);
+
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void TextureBuffer::upload(const void* data, size_t size)
+{
+	// orphan the previous storage, the last frame may still be reading it
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer_id);
+	glBufferData(GL_TEXTURE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void TextureBuffer::update(const void* data, size_t offset, size_t size)
+{
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer_id);
+	glBufferSubData(GL_TEXTURE_BUFFER, offset, size, data);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void TextureBuffer::bind(const Shader& shader, const char* uniform_name, int texture_unit) const
+{
+	GLint uni_buffer = glGetUniformLocation(shader.program, uniform_name);
+	if (uni_buffer != -1)
+	{
+		glActiveTexture(GL_TEXTURE0 + texture_unit);
+		glBindTexture(GL_TEXTURE_BUFFER, texture_id);
+		glUniform1i(uni_buffer, texture_unit);
+	}
+}
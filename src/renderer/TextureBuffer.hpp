@@ -0,0 +1,27 @@
+#pragma once
+
+#include "renderer/Shader.hpp"
+#include <GL/glew.h>
+#include <cstddef>
+
+namespace bey
+{
+	// a buffer object read by the shaders through a buffer texture (samplerBuffer / usamplerBuffer), refilled from the cpu every frame
+	class TextureBuffer
+	{
+	public:
+		TextureBuffer();
+		~TextureBuffer();
+
+		void initialize(GLenum internal_format);
+		void upload(const void* data, size_t size);
+		// overwrites size bytes from offset of the last upload, which has to hold them
+		void update(const void* data, size_t offset, size_t size);
+		// binds the buffer texture to texture_unit when the shader has uniform_name
+		void bind(const Shader& shader, const char* uniform_name, int texture_unit) const;
+
+	private:
+		GLuint buffer_id;
+		GLuint texture_id;
+	};
+}
@@ -0,0 +1,221 @@
+#include "renderer/VisibilityBuffer.hpp"
+#include <algorithm>
+#include <iostream>
+#include "renderer/GlStats.hpp"
+
+using namespace bey;
+
+VisibilityBuffer::VisibilityBuffer() : width(0), height(0), fbo_id(0), id_texture_id(0), num_draws(0), num_vertices(0), num_indices(0),
+	complete(true)
+{
+}
+
+VisibilityBuffer::~VisibilityBuffer()
+{
+}
+
+void VisibilityBuffer::initialize(int width, int height, GLuint depth_texture_id)
+{
+	this->width = width;
+	this->height = height;
+
+	//texture buffers are limited in texels, a scene that does not fit keeps the geometry buffer path
+	GLint max_texels = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &max_texels);
+	if (vertex_data.size() > (size_t)max_texels || index_data.size() > (size_t)max_texels || draw_data.size() > (size_t)max_texels)
+	{
+		complete = false;
+	}
+
+	vertex_buffer.initialize(GL_RGBA32F);
+	index_buffer.initialize(GL_R32UI);
+	draw_buffer.initialize(GL_RGBA32F);
+	draw_index_buffer.initialize(GL_RG32UI);
+	if (!vertex_data.empty() && !index_data.empty())
+	{
+		vertex_buffer.upload(vertex_data.data(), vertex_data.size() * sizeof(glm::vec4));
+		index_buffer.upload(index_data.data(), index_data.size() * sizeof(GLuint));
+		draw_buffer.upload(draw_data.data(), draw_data.size() * sizeof(glm::vec4));
+		draw_index_buffer.upload(draw_indices.data(), draw_indices.size() * sizeof(GLuint));
+	}
+	std::vector<glm::vec4>().swap(vertex_data);
+	std::vector<GLuint>().swap(index_data);
+	std::vector<glm::vec4>().swap(draw_data);
+	std::vector<GLuint>().swap(draw_indices);
+
+	glGenFramebuffers(1, &fbo_id);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo_id);
+
+	glGenTextures(1, &id_texture_id);
+	resize(width, height);
+	glBindTexture(GL_TEXTURE_2D, id_texture_id);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, id_texture_id, 0);
+
+	// the geometry buffer's depth is shared, the light passes test and reconstruct against it after the resolve
+	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depth_texture_id, 0);
+
+	GLenum draw_buffer = GL_COLOR_ATTACHMENT0;
+	glDrawBuffers(1, &draw_buffer);
+
+	GLenum status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		std::cerr << "FB error, status: 0x" << status << std::endl;
+		exit(EXIT_FAILURE);
+		return;
+	}
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+}
+
+void VisibilityBuffer::resize(int width, int height)
+{
+	this->width = width;
+	this->height = height;
+	glBindTexture(GL_TEXTURE_2D, id_texture_id);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, width, height, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+GLuint VisibilityBuffer::add_vertices(const Vertex* vertices, size_t num_vertices)
+{
+	// position and u, then normal and v
+	GLuint first_vertex = (GLuint)this->num_vertices;
+	for (size_t i = 0; i < num_vertices; i++)
+	{
+		vertex_data.push_back(glm::vec4(vertices[i].position, vertices[i].tex_coord.x));
+		vertex_data.push_back(glm::vec4(vertices[i].normal, vertices[i].tex_coord.y));
+	}
+	this->num_vertices += num_vertices;
+	return first_vertex;
+}
+
+GLuint VisibilityBuffer::add_draw(GLuint first_vertex, const unsigned int* indices, size_t num_indices, const glm::mat4& world_mat,
+	const ObjModel::ObjMtl& material, GLuint diffuse_texture_id)
+{
+	if (num_draws >= MAX_DRAWS || num_indices / 3 >= MAX_TRIANGLES)
+	{
+		complete = false;
+		return 0;
+	}
+
+	std::vector<GLuint>::iterator texture = std::find(diffuse_texture_ids.begin(), diffuse_texture_ids.end(), diffuse_texture_id);
+	if (texture == diffuse_texture_ids.end())
+	{
+		texture = diffuse_texture_ids.insert(texture, diffuse_texture_id);
+	}
+
+	// the 4 columns of the world matrix, diffuse and specular power, specular
+	for (int i = 0; i < 4; i++)
+	{
+		draw_data.push_back(world_mat[i]);
+	}
+	draw_data.push_back(glm::vec4(material.Kd, material.Ns));
+	draw_data.push_back(glm::vec4(material.Ks, 0.0f));
+	draw_indices.push_back((GLuint)this->num_indices);
+	draw_indices.push_back((GLuint)(texture - diffuse_texture_ids.begin()));
+
+	for (size_t i = 0; i < num_indices; i++)
+	{
+		index_data.push_back(first_vertex + indices[i]);
+	}
+	this->num_indices += num_indices;
+	return ++num_draws;
+}
+
+void VisibilityBuffer::set_draw_transform(GLuint draw_id, const glm::mat4& world_mat)
+{
+	if (draw_id == 0 || draw_id > num_draws)
+	{
+		return;
+	}
+
+	// the world matrix is the first 4 texels of the draw, see add_draw
+	glm::vec4 columns[4] = { world_mat[0], world_mat[1], world_mat[2], world_mat[3] };
+	draw_buffer.update(columns, (draw_id - 1) * DRAW_TEXELS * sizeof(glm::vec4), sizeof(columns));
+}
+
+bool VisibilityBuffer::is_complete() const
+{
+	return complete;
+}
+
+void VisibilityBuffer::bind()
+{
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo_id);
+
+	const GLuint background_id[4] = { 0, 0, 0, 0 };
+	glClearBufferuiv(GL_COLOR, 0, background_id);
+	glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void VisibilityBuffer::unbind()
+{
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+}
+
+void VisibilityBuffer::bind_textures(const Shader& shader, int first_texture_unit) const
+{
+	GLint uni_visibility = glGetUniformLocation(shader.program, "u_visibility");
+	if (uni_visibility != -1)
+	{
+		glActiveTexture(GL_TEXTURE0 + first_texture_unit);
+		glBindTexture(GL_TEXTURE_2D, id_texture_id);
+		glUniform1i(uni_visibility, first_texture_unit);
+	}
+
+	vertex_buffer.bind(shader, "u_vertices", first_texture_unit + 1);
+	index_buffer.bind(shader, "u_indices", first_texture_unit + 2);
+	draw_buffer.bind(shader, "u_draws", first_texture_unit + 3);
+	draw_index_buffer.bind(shader, "u_draw_indices", first_texture_unit + 4);
+}
+
+void VisibilityBuffer::bind_texture_batch(const Shader& shader, int batch, int first_texture_unit) const
+{
+	GLint uni_texture_batch = glGetUniformLocation(shader.program, "u_texture_batch");
+	if (uni_texture_batch != -1)
+	{
+		glUniform1i(uni_texture_batch, batch);
+	}
+
+	GLint uni_diffuse_textures = glGetUniformLocation(shader.program, "u_diffuse_textures");
+	if (uni_diffuse_textures != -1)
+	{
+		GLint texture_units[NUM_BATCH_TEXTURES];
+		for (int i = 0; i < NUM_BATCH_TEXTURES; i++)
+		{
+			size_t texture = (size_t)batch * NUM_BATCH_TEXTURES + i;
+			texture_units[i] = first_texture_unit + i;
+			glActiveTexture(GL_TEXTURE0 + texture_units[i]);
+			glBindTexture(GL_TEXTURE_2D, texture < diffuse_texture_ids.size() ? diffuse_texture_ids[texture] : 0);
+		}
+		glUniform1iv(uni_diffuse_textures, NUM_BATCH_TEXTURES, texture_units);
+	}
+}
+
+void VisibilityBuffer::set_draw(const Shader& shader, GLuint draw_id) const
+{
+	GLint uni_draw_id = glGetUniformLocation(shader.program, "u_draw_id");
+	if (uni_draw_id != -1)
+	{
+		glUniform1ui(uni_draw_id, draw_id);
+	}
+}
+
+GLuint VisibilityBuffer::get_num_draws() const
+{
+	return num_draws;
+}
+
+int VisibilityBuffer::get_num_texture_batches() const
+{
+	return (int)((diffuse_texture_ids.size() + NUM_BATCH_TEXTURES - 1) / NUM_BATCH_TEXTURES);
+}
+
+size_t VisibilityBuffer::get_memory_size() const
+{
+	return (size_t)width * height * sizeof(GLuint) + num_vertices * VERTEX_TEXELS * sizeof(glm::vec4) + num_indices * sizeof(GLuint)
+		+ num_draws * (DRAW_TEXELS * sizeof(glm::vec4) + 2 * sizeof(GLuint));
+}
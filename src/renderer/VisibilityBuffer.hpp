@@ -0,0 +1,84 @@
+#pragma once
+
+#include "renderer/Shader.hpp"
+#include "renderer/TextureBuffer.hpp"
+#include "scene/Vertex.hpp"
+#include "scene/objmodel.hpp"
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace bey
+{
+	// the visibility buffer path of the geometry pass. every static draw writes only depth and a 32 bit id, (draw id << TRIANGLE_BITS) | triangle,
+	// then a resolve pass rebuilds each pixel's triangle from the vertex and index buffers below and writes the geometry buffer from it.
+	// vertices and indices of all the draws, and the transform and material of every draw, live in texture buffers the resolve pass
+	// reads with texelFetch, so it is one full screen pass whatever the overdraw. the diffuse textures can only be picked by a constant
+	// index, the resolve is one pass per batch of NUM_BATCH_TEXTURES of them
+	class VisibilityBuffer
+	{
+	public:
+		static const int TRIANGLE_BITS = 22;
+		static const GLuint MAX_TRIANGLES = 1u << TRIANGLE_BITS; // per draw, its triangle ids are 0 to MAX_TRIANGLES - 1
+		static const GLuint MAX_DRAWS = (1u << (32 - TRIANGLE_BITS)) - 1; // id 0 is left for the background
+		static const int VERTEX_TEXELS = 2; // rgba32f texels per vertex, see add_vertices
+		static const int DRAW_TEXELS = 6; // rgba32f texels per draw, see add_draw
+		static const int NUM_BUFFER_TEXTURES = 5; // the id target and the texture buffers, see bind_textures
+		static const int NUM_BATCH_TEXTURES = 8; // has to match visibility_resolve.fs
+
+		VisibilityBuffer();
+		~VisibilityBuffer();
+
+		// the draws are added first, initialize then uploads them. depth_texture_id is the geometry buffer's depth, the visibility pass
+		// writes it so the light passes can use it as is
+		void initialize(int width, int height, GLuint depth_texture_id);
+		// reallocates the id target, the depth has to be resized by its geometry buffer
+		void resize(int width, int height);
+
+		// returns the index of the first vertex, for add_draw
+		GLuint add_vertices(const Vertex* vertices, size_t num_vertices);
+		// returns the draw id, 0 when the draw does not fit in the id bits
+		GLuint add_draw(GLuint first_vertex, const unsigned int* indices, size_t num_indices, const glm::mat4& world_mat, const ObjModel::ObjMtl& material,
+			GLuint diffuse_texture_id);
+		// moves a draw after initialize, for the dynamic models
+		void set_draw_transform(GLuint draw_id, const glm::mat4& world_mat);
+		// false when a draw did not fit, or the buffers are bigger than the texture buffers allow
+		bool is_complete() const;
+
+		// binds and clears the id target and the depth
+		void bind();
+		void unbind();
+		// binds the id target, the vertices, the indices and the draws, on NUM_BUFFER_TEXTURES units from first_texture_unit
+		void bind_textures(const Shader& shader, int first_texture_unit) const;
+		// binds the diffuse textures of a batch, on NUM_BATCH_TEXTURES units from first_texture_unit. only the pixels of the draws
+		// whose texture is in the batch are resolved
+		void bind_texture_batch(const Shader& shader, int batch, int first_texture_unit) const;
+		// draw id of the draw whose pixels are written
+		void set_draw(const Shader& shader, GLuint draw_id) const;
+
+		GLuint get_num_draws() const;
+		int get_num_texture_batches() const;
+		size_t get_memory_size() const; // bytes of the id target and of the texture buffers
+
+	private:
+		int width;
+		int height;
+		GLuint fbo_id;
+		GLuint id_texture_id;
+		TextureBuffer vertex_buffer;
+		TextureBuffer index_buffer;
+		TextureBuffer draw_buffer; // world matrix and material of every draw
+		TextureBuffer draw_index_buffer; // first index and texture of every draw
+
+
+		std::vector<glm::vec4> vertex_data; // only kept until initialize
+		std::vector<GLuint> index_data; // absolute vertex indices, only kept until initialize
+		std::vector<glm::vec4> draw_data; // only kept until initialize
+		std::vector<GLuint> draw_indices; // first index and texture of every draw, draw id 1 is the first pair. only kept until initialize
+		std::vector<GLuint> diffuse_texture_ids; // every diffuse texture, the batches are consecutive runs of them
+		GLuint num_draws;
+		size_t num_vertices;
+		size_t num_indices;
+		bool complete;
+	};
+}
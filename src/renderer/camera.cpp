@@ -17,16 +17,19 @@ Camera::Camera() :	position(glm::vec3(0, 2, 5)),
 					fov(glm::pi<float>() / 4.0), 
 					aspect_ratio(1), 
 					near_clip(0.1f), 
-					far_clip(100)
+					far_clip(100),
+					jitter(0.0f)
 {
 
 	view_mat = glm::lookAt(position, position + get_direction(), get_up());
-	proj_mat = glm::perspective(get_fov_degrees(), get_aspect_ratio(), get_near_clip(), get_far_clip());
+	update_proj();
 }
 
 Camera::Camera( float fovy, float aspect, float near, float far )
 	:	proj_mat(glm::perspective(fovy, aspect, near, far)),
-		position(ZERO)	  
+		unjittered_proj_mat(proj_mat),
+		position(ZERO),
+		jitter(0.0f)
 {
 }
 
@@ -40,6 +43,11 @@ const glm::mat4& Camera::get_projection_matrix() const
 	return proj_mat;
 }
 
+const glm::mat4& Camera::get_unjittered_projection_matrix() const
+{
+	return unjittered_proj_mat;
+}
+
 glm::mat4 Camera::get_view_matrix() const
 {
 	return view_mat;
@@ -85,6 +93,11 @@ float Camera::get_aspect_ratio() const
 	return aspect_ratio;
 }
 
+const glm::vec2& Camera::get_jitter() const
+{
+	return jitter;
+}
+
 void Camera::set_near_clip(float value)
 {
 	near_clip = value;
@@ -109,6 +122,12 @@ void Camera::set_fov(float value)
 	update_proj();
 }
 
+void Camera::set_jitter(const glm::vec2& ndc_offset)
+{
+	jitter = ndc_offset;
+	update_proj();
+}
+
 void Camera::set_position(glm::vec3 value)
 {
 	position = value;
@@ -210,7 +229,12 @@ void Camera::update(float delta)
 
 void Camera::update_proj()
 {
-	proj_mat = glm::perspective(get_fov_degrees(), get_aspect_ratio(), get_near_clip(), get_far_clip());
+	unjittered_proj_mat = glm::perspective(get_fov_degrees(), get_aspect_ratio(), get_near_clip(), get_far_clip());
+
+	// clip x and y get jitter * w added, so after the divide by w the whole image moves by jitter. w is -z in view space
+	proj_mat = unjittered_proj_mat;
+	proj_mat[2][0] -= jitter.x;
+	proj_mat[2][1] -= jitter.y;
 }
 
 void Camera::update_view()
@@ -8,7 +8,8 @@ namespace bey
 {
 	class Camera {
 	private:
-		glm::mat4 proj_mat;
+		glm::mat4 proj_mat; // with the jitter
+		glm::mat4 unjittered_proj_mat;
 		glm::mat4 view_mat;
 		
 		glm::vec3 position;
@@ -17,6 +18,7 @@ namespace bey
 		float aspect_ratio;
 		float near_clip;
 		float far_clip;
+		glm::vec2 jitter; // in ndc
 
 		//movement
 		glm::vec3 move_direction;
@@ -31,6 +33,7 @@ namespace bey
 		~Camera();
 
 		const glm::mat4& get_projection_matrix() const;
+		const glm::mat4& get_unjittered_projection_matrix() const;
 		glm::mat4 get_view_matrix() const;
 		const glm::vec3 get_position() const;
 		const glm::vec3 get_direction() const;
@@ -40,6 +43,7 @@ namespace bey
 		float get_fov_radians() const;	
 		float get_fov_degrees() const;
 		float get_aspect_ratio() const;
+		const glm::vec2& get_jitter() const;
 		
 		//setter
 		void set_near_clip(float value);
@@ -48,6 +52,8 @@ namespace bey
 		void set_orientation(glm::quat value);
 		void set_aspect_ratio(float value);
 		void set_fov(float value);
+		// moves the projected image by ndc_offset, for the sub-pixel offsets of temporal upscaling
+		void set_jitter(const glm::vec2& ndc_offset);
 
 		//camera control
 		void translate(const glm::vec3& direction);
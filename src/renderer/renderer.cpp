@@ -1,5 +1,7 @@
 #include "renderer.hpp"
 #include "Shader.hpp"
+#include "Frustum.hpp"
+#include "util/CpuProfiler.hpp"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/quaternion.hpp>
@@ -10,52 +12,245 @@
 #include <iostream>
 #include <cstddef>
 #include <glm/gtc/constants.hpp> 
+#include <limits>
+#include <map>
+#include <algorithm>
+#include <SFML/System/Clock.hpp>
+#include "renderer/GlStats.hpp"
 
 using namespace bey;
 
+static const int shadow_atlas_max_tile_size = 1024;
+static const int shadow_atlas_min_tile_size = 128;
+static const int sun_shadow_num_cascades = 4;
+static const float sun_shadow_split_lambda = 0.75f;
+
+static const int light_scissor_max_pixels = 64 * 64; // light volumes whose scissor rectangle is smaller skip the stencil pass
+static const int max_stencil_batch_size = 8; // one bit of the stencil buffer per light
+static const float max_spot_light_volume_angle = 85.0f; // wider spot lights are cut to this half angle, like their shadow's field of view
+static const int point_light_texels = 3; // rgba32f texels per point light in the point light buffer, see pack_point_light
+static const float min_render_scale = 0.25f;
+
+// radius of the cap of the cone drawn as a spot light's volume. the cone has its tip on the light and its cap cutoff away along
+// the light's direction, wide enough for the light's angle
+static float calc_spot_light_volume_radius(const SpotLight& spot_light)
+{
+	return spot_light.cutoff * glm::tan(glm::radians(glm::min(spot_light.angle, max_spot_light_volume_angle)));
+}
+
+//bounds of a perspective projected sphere along one view space axis, from the lines through the eye that touch the sphere.
+//center is the sphere's (coordinate along the axis, view space z). where a touching point is behind the near plane,
+//the bound comes from the circle where the sphere crosses the near plane instead
+static void calc_sphere_axis_bounds(const glm::vec2& center, float radius, float near_z, float proj_scale, float& min_ndc, float& max_ndc)
+{
+	float t_squared = glm::dot(center, center) - radius * radius;
+	bool camera_inside = t_squared <= 0.0f;
+	glm::vec2 v = camera_inside ? glm::vec2(0.0f) : glm::vec2(glm::sqrt(t_squared), radius) / glm::length(center);
+	bool clip_sphere = center.y + radius >= near_z;
+	float k = glm::sqrt(glm::max(radius * radius - (near_z - center.y) * (near_z - center.y), 0.0f));
+
+	min_ndc = std::numeric_limits<float>::max();
+	max_ndc = -std::numeric_limits<float>::max();
+	for (int i = 0; i < 2; i++)
+	{
+		// rotate the direction to the center by the angle between the center and the touching point
+		glm::vec2 bound = glm::vec2(v.x * center.x + v.y * center.y, v.x * center.y - v.y * center.x) * v.x;
+		if (clip_sphere && (camera_inside || bound.y > near_z))
+		{
+			bound = glm::vec2(center.x + k, near_z);
+		}
+
+		float ndc = proj_scale * bound.x / -bound.y;
+		min_ndc = glm::min(min_ndc, ndc);
+		max_ndc = glm::max(max_ndc, ndc);
+
+		v.y = -v.y;
+		k = -k;
+	}
+}
+
+//pixel rectangle (x, y, width, height) of normalized device coordinate bounds, clamped to the screen
+static glm::ivec4 calc_scissor_rect(const glm::vec2& min_ndc, const glm::vec2& max_ndc, int screen_width, int screen_height)
+{
+	glm::vec2 min_pos = (glm::clamp(min_ndc, -1.0f, 1.0f) * 0.5f + 0.5f) * glm::vec2(screen_width, screen_height);
+	glm::vec2 max_pos = (glm::clamp(max_ndc, -1.0f, 1.0f) * 0.5f + 0.5f) * glm::vec2(screen_width, screen_height);
+	int x0 = (int)glm::floor(min_pos.x);
+	int y0 = (int)glm::floor(min_pos.y);
+	int x1 = (int)glm::ceil(max_pos.x);
+	int y1 = (int)glm::ceil(max_pos.y);
+	return glm::ivec4(x0, y0, glm::max(x1 - x0, 0), glm::max(y1 - y0, 0));
+}
+
+static bool has_moving_point_lights(const Scene& scene)
+{
+	const PointLight* point_lights = scene.get_point_lights();
+	for (size_t i = 0; i < scene.num_point_lights(); i++)
+	{
+		if (point_lights[i].velocity != 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool has_slerping_spot_lights(const Scene& scene)
+{
+	const SpotLight* spot_lights = scene.get_spot_lights();
+	for (size_t i = 0; i < scene.num_spot_lights(); i++)
+	{
+		if (spot_lights[i].is_slerping)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// the geometry buffer's size along one side of the window
+static int calc_render_size(int window_size, float render_scale)
+{
+	return glm::max((int)(window_size * render_scale + 0.5f), 1);
+}
+
+static glm::mat4 calc_spot_light_proj_view(const SpotLight& spot_light)
+{
+	glm::vec3 direction = spot_light.get_direction();
+	glm::vec3 up = spot_light.orientation * glm::vec3(0, 1, 0);
+	glm::mat4 light_view_mat = glm::lookAt(spot_light.position, spot_light.position + direction, up);
+	// glm takes the field of view in radians, spot light angle is the half angle of the cone in degrees
+	glm::mat4 light_proj_mat = glm::perspective(glm::radians(glm::min(2 * spot_light.angle, 170.0f)), 1.0f, 0.01f, spot_light.cutoff);
+	return light_proj_mat * light_view_mat;
+}
+
 bool Renderer::initialize(const Scene& scene, const RendererInitData& data )
 {
+	BEY_PROFILE_ZONE("renderer initialize");
 	glViewport(0, 0, data.screen_width, data.screen_height);
 	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);	
 
-	screen_width = data.screen_width;
-	screen_height = data.screen_height;
+	window_width = data.screen_width;
+	window_height = data.screen_height;
+	render_scale = glm::clamp(data.render_scale, min_render_scale, 1.0f);
+	screen_width = calc_render_size(window_width, render_scale);
+	screen_height = calc_render_size(window_height, render_scale);
 	head = nullptr;
+	Shader::set_program_cache_directory(data.shader_cache_directory);
+	light_path = LightPath::STENCIL;
+	stencil_batch_size = max_stencil_batch_size;
+	spot_shadow_pcf_size = glm::max(data.spot_shadow_pcf_size, 1);
+	depth_pre_pass = data.depth_pre_pass;
+	sort_front_to_back = data.sort_front_to_back;
+	glGenQueries(1, &geometry_samples_query);
+	geometry_samples_query_pending = false;
+	glGenQueries(1, &frame_time_query);
+	frame_time_query_pending = false;
+	idle_frame_skipping = data.idle_frame_skipping;
+	frame_invalid = true;
+	last_light_revision = 0;
+	last_model_revision = scene.get_model_revision();
+	num_converging_frames = 0;
+	num_profiled_frames = 0;
+	num_shadow_caster_triangles = 0;
+	scene_bounding_box.min = glm::vec3(std::numeric_limits<float>::max());
+	scene_bounding_box.max = glm::vec3(-std::numeric_limits<float>::max());
 	
 	initialize_static_models(scene.get_static_models(), scene.num_static_models());
-	geometry_buffer.initialize(screen_width, screen_height);
-	shadow_map.initialize(screen_width, screen_height);
+	geometry_buffer.initialize(screen_width, screen_height, data.compact_geometry_buffer);
+	geometry_buffer.set_sun_light(data.fused_sun_light);
+	std::cout << "geometry buffer (" << (data.compact_geometry_buffer ? "compact" : "full") << ") : " << screen_width << "x" << screen_height << ", "
+		<< geometry_buffer.get_memory_size() / (1024.0f * 1024.0f) << " MB" << (render_scale < 1.0f ? ", upscaled to the window" : "") << std::endl;
+	visibility_buffer.initialize(screen_width, screen_height, geometry_buffer.get_depth_texture_id());
+	std::cout << "visibility buffer : " << visibility_buffer.get_num_draws() << " draws, " << visibility_buffer.get_num_texture_batches()
+		<< " resolve passes, " << visibility_buffer.get_memory_size() / (1024.0f * 1024.0f) << " MB"
+		<< (visibility_buffer.is_complete() ? "" : ", the scene does not fit, only the geometry buffer path is available") << std::endl;
+	geometry_path = GeometryPath::GEOMETRY_BUFFER;
+	set_geometry_path(data.visibility_buffer ? GeometryPath::VISIBILITY_BUFFER : GeometryPath::GEOMETRY_BUFFER);
+	temporal_upscaler.initialize(window_width, window_height);
+	temporal_upscaling = data.temporal_upscaling;
+	low_resolution_light_buffer.initialize(screen_width, screen_height, 1);
+	light_resolution_scale = 1;
+	set_light_resolution_scale(data.light_resolution_scale);
+	sun_shadow_map.initialize(sun_shadow_num_cascades, data.sun_shadow_cascade_resolution, sun_shadow_split_lambda, has_dynamic_models(scene),
+		data.shadow_depth_format, data.shadow_debug);
+	clustered_lighting.initialize();
+	point_light_buffer.initialize(GL_RGBA32F);
+	shadow_atlas.initialize(data.shadow_atlas_size, shadow_atlas_max_tile_size, shadow_atlas_min_tile_size, data.shadow_depth_format, data.shadow_debug);
+	print_shadow_memory();
+	quality_governor.initialize(0.0f, shadow_atlas.get_max_tile_size(), sun_shadow_map.get_resolution(), shadow_scheduler.get_budget().max_updates);
+	quality_level = 0;
+	set_target_frame_time(data.target_frame_time);
 	initialize_shaders();
-	initialize_primitives();
+	initialize_primitives(data);
 
 	return true;
 }
 
-void Renderer::initialize_primitives()
+bool Renderer::has_dynamic_models(const Scene& scene) const
+{
+	const StaticModel* static_models = scene.get_static_models();
+	for (size_t i = 0; i < scene.num_static_models(); i++)
+	{
+		if (static_models[i].dynamic)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void Renderer::initialize_primitives(const RendererInitData& data)
 {
-	cone = create_cone(); // somehow when creating cone after sphere, there will be some kind of artifacts in AMD
+	cone = create_cone(data.light_volume_cone_segments); // somehow when creating cone after sphere, there will be some kind of artifacts in AMD
 	quad = create_quad();
-	sphere = create_sphere();
+	sphere = create_sphere(data.light_volume_sphere_subdivisions);
 }
 
 void Renderer::initialize_shaders()
 {
-	Shader shader;
-	shader.load_shader_program("../../shaders/simple_triangle.vs", "../../shaders/simple_triangle.fs");
-	shaders.push_back(shader);
-
-	Shader test_shader;
-	test_shader.load_shader_program("../../shaders/shadow_first_pass.vs", "../../shaders/shadow_first_pass.fs");
-	shaders.push_back(test_shader);
-
-	directional_light_shader.load_shader_program("../../shaders/directional_light_pass.vs", "../../shaders/directional_light_pass.fs");
-	point_light_shader.load_shader_program("../../shaders/point_light_pass.vs", "../../shaders/point_light_pass.fs");
-	stencil_shader.load_shader_program("../../shaders/stencil_pass.vs", "../../shaders/stencil_pass.fs");
-	spot_light_shader.load_shader_program("../../shaders/spot_light_pass.vs", "../../shaders/spot_light_pass.fs");
+	BEY_PROFILE_ZONE("shaders initialize");
+	//every program is submitted before waiting for any of them, so the driver can compile them side by side
+	shaders.resize(2);
+	shaders[0].begin_load_shader_program("../../shaders/simple_triangle.vs", "../../shaders/simple_triangle.fs");
+	shaders[1].begin_load_shader_program("../../shaders/shadow_first_pass.vs", "../../shaders/shadow_first_pass.fs");
+	directional_light_shader.begin_load_shader_program("../../shaders/directional_light_pass.vs", "../../shaders/directional_light_pass.fs");
+	stencil_shader.begin_load_shader_program("../../shaders/stencil_pass.vs", "../../shaders/stencil_pass.fs");
+	depth_pre_pass_shader.begin_load_shader_program("../../shaders/geometry_pass.vs", "../../shaders/shadow_depth_pass.fs");
+	light_downsample_shader.begin_load_shader_program("../../shaders/directional_light_pass.vs", "../../shaders/light_downsample.fs");
+	light_upsample_shader.begin_load_shader_program("../../shaders/directional_light_pass.vs", "../../shaders/light_upsample.fs");
+	visibility_shader.begin_load_shader_program("../../shaders/geometry_pass.vs", "../../shaders/visibility_pass.fs");
+	visibility_resolve_shader.begin_load_shader_program("../../shaders/visibility_resolve.vs", "../../shaders/visibility_resolve.fs");
+	temporal_upscale_shader.begin_load_shader_program("../../shaders/directional_light_pass.vs", "../../shaders/temporal_upscale.fs");
+
+	//compile the local light variants up front, instead of on the first frame that needs them
+	local_light_shaders.initialize("../../shaders/local_light_pass.vs", "../../shaders/local_light_pass.fs");
+	local_light_shaders.prepare_variant(get_local_light_defines(false, false, false));
+	local_light_shaders.prepare_variant(get_local_light_defines(true, false, false));
+	local_light_shaders.prepare_variant(get_local_light_defines(true, true, false));
+	clustered_light_shaders.initialize("../../shaders/clustered_light_pass.vs", "../../shaders/clustered_light_pass.fs");
+	clustered_light_shaders.prepare_variant(get_clustered_light_defines(false));
+
+	for (size_t i = 0; i < shaders.size(); i++)
+	{
+		shaders[i].finish_load_shader_program();
+	}
+	directional_light_shader.finish_load_shader_program();
+	stencil_shader.finish_load_shader_program();
+	depth_pre_pass_shader.finish_load_shader_program();
+	light_downsample_shader.finish_load_shader_program();
+	light_upsample_shader.finish_load_shader_program();
+	visibility_shader.finish_load_shader_program();
+	visibility_resolve_shader.finish_load_shader_program();
+	temporal_upscale_shader.finish_load_shader_program();
+	get_local_light_shader(false, false, false);
+	get_local_light_shader(true, false, false);
+	get_local_light_shader(true, true, false);
+	get_clustered_light_shader(false);
 }
 
 void Renderer::initialize_material(const StaticModel& static_model, int group_index, RenderData& render_data)
 {
+	BEY_PROFILE_ZONE("texture upload");
 	const ObjModel::ObjMtl* material = static_model.model->get_material(group_index);
 	
 	//diffuse
@@ -115,8 +310,32 @@ void calc_bounding_box(BoundingBox& bounding_box, const glm::mat4& world, const
 	}
 }
 
+static glm::mat4 calc_world_matrix(const StaticModel& static_model)
+{
+	glm::mat4 world_mat = glm::scale(glm::mat4(), static_model.scale);
+	world_mat = glm::toMat4(static_model.orientation) * world_mat;
+	return glm::translate(glm::mat4(), static_model.position) * world_mat;
+}
+
+static GLuint create_position_buffer(const Vertex* vertices, size_t num_vertices)
+{
+	std::vector<glm::vec3> positions(num_vertices);
+	for (size_t i = 0; i < num_vertices; i++)
+	{
+		positions[i] = vertices[i].position;
+	}
+
+	GLuint positions_id;
+	glGenBuffers(1, &positions_id);
+	glBindBuffer(GL_ARRAY_BUFFER, positions_id);
+	glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(positions[0]), positions.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	return positions_id;
+}
+
 void Renderer::initialize_static_models(const StaticModel* static_models, size_t num_static_models)
 {	
+	BEY_PROFILE_ZONE("mesh upload");
 	RenderData* prev = nullptr;
 	for (size_t i = 0; i < num_static_models; i++)
 	{
@@ -129,12 +348,25 @@ void Renderer::initialize_static_models(const StaticModel* static_models, size_t
 		glBindBuffer(GL_ARRAY_BUFFER, vertices_id);
 		glBufferData(GL_ARRAY_BUFFER, vertices_size, &vertices[0], GL_STATIC_DRAW);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		GLuint positions_id = create_position_buffer(vertices, static_model.model->num_vertices());
+		GLuint first_visibility_vertex = visibility_buffer.add_vertices(vertices, static_model.model->num_vertices());
+
+		glm::mat4 world_mat = calc_world_matrix(static_model);
+
+		//every group of a model shares the model's bounding box
+		BoundingBox bounding_box;
+		bounding_box.min = glm::vec3(std::numeric_limits<float>::max());
+		bounding_box.max = glm::vec3(-std::numeric_limits<float>::max());
+		calc_bounding_box(bounding_box, world_mat, static_model);
+		scene_bounding_box.min = glm::min(scene_bounding_box.min, bounding_box.min);
+		scene_bounding_box.max = glm::max(scene_bounding_box.max, bounding_box.max);
 
 		for (int j = 0; j < static_model.model->get_mesh_groups_size(); j++)
 		{			
 			const unsigned int* indices = static_model.model->get_indices(j);			
 			size_t indices_size = static_model.model->num_indices(j) * sizeof(indices[0]);			
 			GLuint indices_id;						
+			num_shadow_caster_triangles += static_model.model->num_indices(j) / 3;
 		
 			glGenBuffers(1, &indices_id);			
 
@@ -144,15 +376,18 @@ void Renderer::initialize_static_models(const StaticModel* static_models, size_t
 
 			RenderData* render_data = new RenderData;
 			render_data->vertices_id = vertices_id;
+			render_data->positions_id = positions_id;
 			render_data->indices_id = indices_id;
 			render_data->model = &static_model;			
 			render_data->group_id = j;
+			render_data->num_indices = static_model.model->num_indices(j);
 			render_data->material = static_model.model->get_material(j);			
-			render_data->world_mat = glm::scale(glm::mat4(), static_model.scale);			
-			render_data->world_mat = glm::toMat4(static_model.orientation) * render_data->world_mat;
-			render_data->world_mat = glm::translate(glm::mat4(), static_model.position) * render_data->world_mat;					
+			render_data->world_mat = world_mat;
+			render_data->bounding_box = bounding_box;
 
 			initialize_material(static_model, j, *render_data);
+			render_data->visibility_id = visibility_buffer.add_draw(first_visibility_vertex, indices, render_data->num_indices, world_mat, *render_data->material,
+				render_data->diffuse_texture_id);
 
 			if (head == nullptr)
 			{
@@ -168,6 +403,45 @@ void Renderer::initialize_static_models(const StaticModel* static_models, size_t
 	}
 }
 
+void Renderer::update_dynamic_models(const Scene& scene)
+{
+	if (scene.get_model_revision() == last_model_revision)
+	{
+		return;
+	}
+	last_model_revision = scene.get_model_revision();
+
+	//the groups of a model are next to each other in the list and share its transform and bounding box
+	const StaticModel* static_model = nullptr;
+	glm::mat4 world_mat;
+	BoundingBox bounding_box;
+	for (RenderData* render_data = head; render_data != nullptr; render_data = render_data->next)
+	{
+		if (!render_data->model->dynamic)
+		{
+			continue;
+		}
+
+		if (render_data->model != static_model)
+		{
+			static_model = render_data->model;
+			world_mat = calc_world_matrix(*static_model);
+			bounding_box.min = glm::vec3(std::numeric_limits<float>::max());
+			bounding_box.max = glm::vec3(-std::numeric_limits<float>::max());
+			calc_bounding_box(bounding_box, world_mat, *static_model);
+			//the scene bounds only grow, the sun cascades keep covering every place a model has been
+			scene_bounding_box.min = glm::min(scene_bounding_box.min, bounding_box.min);
+			scene_bounding_box.max = glm::max(scene_bounding_box.max, bounding_box.max);
+		}
+
+		render_data->world_mat = world_mat;
+		render_data->bounding_box = bounding_box;
+		visibility_buffer.set_draw_transform(render_data->visibility_id, world_mat);
+	}
+
+	invalidate_frame();
+}
+
 RenderData* Renderer::create_quad()
 {
 	RenderData* rd = new RenderData;
@@ -199,93 +473,130 @@ RenderData* Renderer::create_quad()
 	return rd;
 }
 
-RenderData* Renderer::create_sphere()
+RenderData* Renderer::create_mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices)
 {
-	RenderData* render_data = new RenderData;	
-
-	StaticModel* static_model = new StaticModel;
-	ObjModel* model = new ObjModel;
-	if (!model->loadFromFile("../../scenes/", "models/sphere.obj"))
-	{
-		if (!model->loadFromFile("scenes/", "models/sphere.obj"))
-		{
-			std::cerr << "Error reading sphere object file" << std::endl;
-			exit(EXIT_FAILURE);
-		}
-	}
-	
-	static_model->model = model;
+	RenderData* render_data = new RenderData;
 
-	const Vertex* vertices = model->get_vertices();
-	size_t vertices_size = model->num_vertices() * sizeof(vertices[0]);
 	GLuint vertices_id;
-
 	glGenBuffers(1, &vertices_id);
 	glBindBuffer(GL_ARRAY_BUFFER, vertices_id);
-	glBufferData(GL_ARRAY_BUFFER, vertices_size, &vertices[0], GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(vertices[0]), &vertices[0], GL_STATIC_DRAW);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	
-	const unsigned int* indices = model->get_indices(0);
-	size_t indices_size = model->num_indices(0) * sizeof(indices[0]);
-	GLuint indices_id;
 
+	GLuint indices_id;
 	glGenBuffers(1, &indices_id);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices_id);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices_size, &indices[0], GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(indices[0]), &indices[0], GL_STATIC_DRAW);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
 	render_data->vertices_id = vertices_id;
+	render_data->positions_id = create_position_buffer(vertices.data(), vertices.size());
 	render_data->indices_id = indices_id;
+	render_data->num_indices = indices.size();
 	render_data->world_mat = glm::mat4();
-	render_data->model = static_model;	
-	render_data->group_id = 0;
 
 	return render_data;
 }
 
-RenderData* Renderer::create_cone()
+RenderData* Renderer::create_sphere(int subdivisions)
 {
-	RenderData* render_data = new RenderData;
+	//icosahedron, every subdivision splits each triangle in four and pushes the new vertices onto the unit sphere
+	const float t = (1.0f + glm::sqrt(5.0f)) * 0.5f;
+	std::vector<glm::vec3> positions = {
+		glm::vec3(-1, t, 0), glm::vec3(1, t, 0), glm::vec3(-1, -t, 0), glm::vec3(1, -t, 0),
+		glm::vec3(0, -1, t), glm::vec3(0, 1, t), glm::vec3(0, -1, -t), glm::vec3(0, 1, -t),
+		glm::vec3(t, 0, -1), glm::vec3(t, 0, 1), glm::vec3(-t, 0, -1), glm::vec3(-t, 0, 1),
+	};
+	std::vector<unsigned int> indices = {
+		0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11,
+		1, 5, 9, 5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+		3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9,
+		4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1,
+	};
+	for (size_t i = 0; i < positions.size(); i++)
+	{
+		positions[i] = glm::normalize(positions[i]);
+	}
 
-	StaticModel* static_model = new StaticModel;
-	ObjModel* model = new ObjModel;
-	if (!model->loadFromFile("../../scenes/", "models/cone_wei_2.obj"))
+	for (int level = 0; level < subdivisions; level++)
 	{
-		if (!model->loadFromFile("scenes/", "models/cone_wei_2.obj"))
+		std::map<std::pair<unsigned int, unsigned int>, unsigned int> midpoints; // shared by the two triangles of an edge
+		std::vector<unsigned int> subdivided_indices;
+		for (size_t i = 0; i < indices.size(); i += 3)
 		{
-			std::cerr << "Error reading cone object file" << std::endl;
-			exit(EXIT_FAILURE);
+			unsigned int corners[3] = { indices[i], indices[i + 1], indices[i + 2] };
+			unsigned int middles[3];
+			for (int j = 0; j < 3; j++)
+			{
+				unsigned int a = corners[j];
+				unsigned int b = corners[(j + 1) % 3];
+				std::pair<unsigned int, unsigned int> edge(glm::min(a, b), glm::max(a, b));
+				std::map<std::pair<unsigned int, unsigned int>, unsigned int>::iterator it = midpoints.find(edge);
+				if (it == midpoints.end())
+				{
+					it = midpoints.insert(std::make_pair(edge, (unsigned int)positions.size())).first;
+					positions.push_back(glm::normalize(positions[a] + positions[b]));
+				}
+				middles[j] = it->second;
+			}
+
+			unsigned int triangles[] = {
+				corners[0], middles[0], middles[2],
+				corners[1], middles[1], middles[0],
+				corners[2], middles[2], middles[1],
+				middles[0], middles[1], middles[2],
+			};
+			subdivided_indices.insert(subdivided_indices.end(), triangles, triangles + 12);
 		}
+		indices.swap(subdivided_indices);
 	}
 
-	static_model->model = model;
-
-	const Vertex* vertices = model->get_vertices();
-	size_t vertices_size = model->num_vertices() * sizeof(vertices[0]);
-	GLuint vertices_id;
-
-	glGenBuffers(1, &vertices_id);
-	glBindBuffer(GL_ARRAY_BUFFER, vertices_id);
-	glBufferData(GL_ARRAY_BUFFER, vertices_size, &vertices[0], GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	//the faces cut inside the unit sphere, scale the mesh until the closest face touches it so the light volume is never too small
+	float min_face_distance = 1.0f;
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		const glm::vec3& a = positions[indices[i]];
+		glm::vec3 normal = glm::normalize(glm::cross(positions[indices[i + 1]] - a, positions[indices[i + 2]] - a));
+		min_face_distance = glm::min(min_face_distance, glm::dot(normal, a));
+	}
 
+	std::vector<Vertex> vertices(positions.size());
+	for (size_t i = 0; i < positions.size(); i++)
+	{
+		vertices[i].position = positions[i] / min_face_distance;
+		vertices[i].normal = positions[i];
+	}
 
-	const unsigned int* indices = model->get_indices(0);
-	size_t indices_size = model->num_indices(0) * sizeof(indices[0]);
-	GLuint indices_id;
+	return create_mesh(vertices, indices);
+}
 
-	glGenBuffers(1, &indices_id);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices_id);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices_size, &indices[0], GL_STATIC_DRAW);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+RenderData* Renderer::create_cone(int segments)
+{
+	//tip at the origin, cap at z = 1. the cap is a polygon around the unit circle, so the cone bounds a round one of radius 1
+	float ring_radius = 1.0f / glm::cos(glm::pi<float>() / segments);
+	std::vector<Vertex> vertices(segments + 2);
+	vertices[0].position = glm::vec3(0.0f);
+	vertices[0].normal = glm::vec3(0.0f, 0.0f, -1.0f);
+	vertices[1].position = glm::vec3(0.0f, 0.0f, 1.0f);
+	vertices[1].normal = glm::vec3(0.0f, 0.0f, 1.0f);
+	for (int i = 0; i < segments; i++)
+	{
+		float angle = 2.0f * glm::pi<float>() * i / segments;
+		vertices[i + 2].position = glm::vec3(ring_radius * glm::cos(angle), ring_radius * glm::sin(angle), 1.0f);
+		vertices[i + 2].normal = glm::normalize(glm::vec3(glm::cos(angle), glm::sin(angle), -1.0f));
+	}
 
-	render_data->vertices_id = vertices_id;
-	render_data->indices_id = indices_id;
-	render_data->world_mat = glm::mat4();
-	render_data->model = static_model;
-	render_data->group_id = 0;
+	//counter clockwise seen from outside
+	std::vector<unsigned int> indices;
+	for (int i = 0; i < segments; i++)
+	{
+		unsigned int current = i + 2;
+		unsigned int next = (i + 1) % segments + 2;
+		unsigned int triangles[] = { 0, next, current, 1, current, next };
+		indices.insert(indices.end(), triangles, triangles + 6);
+	}
 
-	return render_data;
+	return create_mesh(vertices, indices);
 }
 
 void Renderer::set_attributes(const Shader& shader)
@@ -315,6 +626,40 @@ void Renderer::set_attributes(const Shader& shader)
 	}
 }
 
+void Renderer::set_position_attribute(const Shader& shader)
+{
+	if (shader.posL_attribute != -1)
+	{
+		glEnableVertexAttribArray(shader.posL_attribute);
+		glVertexAttribPointer(shader.posL_attribute, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void *)0);
+	}
+
+	//left enabled, they would still be fetched from whatever buffer they point to
+	GLint unused_attributes[] = { shader.color_attribute, shader.uv_attribute, shader.normal_attribute };
+	for (int i = 0; i < 3; i++)
+	{
+		if (unused_attributes[i] != -1)
+		{
+			glDisableVertexAttribArray(unused_attributes[i]);
+		}
+	}
+}
+
+void Renderer::bind_vertices(const Shader& shader, const RenderData& render_data, bool positions_only)
+{
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, render_data.indices_id);
+	if (positions_only)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, render_data.positions_id);
+		set_position_attribute(shader);
+	}
+	else
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, render_data.vertices_id);
+		set_attributes(shader);
+	}
+}
+
 void Renderer::set_uniforms(GLuint shader_program, const RenderData& render_data, const Camera& camera)
 {
 	GLint uni_world = glGetUniformLocation(shader_program, "u_world");
@@ -347,6 +692,12 @@ void Renderer::set_uniforms(GLuint shader_program, const RenderData& render_data
 		glUniformMatrix4fv(uni_proj_view_world, 1, GL_FALSE, glm::value_ptr(camera.get_projection_matrix() * camera.get_view_matrix() * render_data.world_mat));
 	}
 
+	GLint uni_inv_proj_view = glGetUniformLocation(shader_program, "u_inv_proj_view");
+	if (uni_inv_proj_view != -1)
+	{
+		glUniformMatrix4fv(uni_inv_proj_view, 1, GL_FALSE, glm::value_ptr(glm::inverse(camera.get_projection_matrix() * camera.get_view_matrix())));
+	}
+
 	GLint uni_cam_pos = glGetUniformLocation(shader_program, "u_cam_pos");
 	if (uni_cam_pos != -1)
 	{
@@ -395,10 +746,73 @@ void Renderer::set_uniforms(GLuint shader_program, const RenderData& render_data
 	}
 }
 
+void Renderer::build_geometry_queue(const Camera& camera)
+{
+	BEY_PROFILE_ZONE("geometry queue");
+	geometry_queue.clear();
+	for (RenderData* render_data = head; render_data != nullptr; render_data = render_data->next)
+	{
+		geometry_queue.push_back(render_data);
+	}
+
+	if (!sort_front_to_back)
+	{
+		return;
+	}
+
+	//by the distance from the camera to the closest point of the bounding box. the groups of a model share their box,
+	//the stable sort keeps them in their original order
+	glm::vec3 cam_pos = camera.get_position();
+	std::vector<std::pair<float, const RenderData*> > sorted(geometry_queue.size());
+	for (size_t i = 0; i < geometry_queue.size(); i++)
+	{
+		const BoundingBox& box = geometry_queue[i]->bounding_box;
+		glm::vec3 offset = cam_pos - glm::clamp(cam_pos, box.min, box.max);
+		sorted[i] = std::make_pair(glm::dot(offset, offset), geometry_queue[i]);
+	}
+	std::stable_sort(sorted.begin(), sorted.end(),
+		[](const std::pair<float, const RenderData*>& a, const std::pair<float, const RenderData*>& b) { return a.first < b.first; });
+	for (size_t i = 0; i < sorted.size(); i++)
+	{
+		geometry_queue[i] = sorted[i].second;
+	}
+}
+
+void Renderer::draw_geometry_queue(const Scene& scene, const Shader& shader, bool positions_only)
+{
+	for (size_t i = 0; i < geometry_queue.size(); i++)
+	{
+		const RenderData* render_data = geometry_queue[i];
+
+		//set shader's attributes and uniforms		
+		bind_vertices(shader, *render_data, positions_only);
+		set_uniforms(shader.program, *render_data, scene.camera);
+
+		glDrawElements(GL_TRIANGLES, render_data->num_indices, GL_UNSIGNED_INT, 0);
+	}
+	//unbind all previous binding
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
 void Renderer::geometry_pass(const Scene& scene)
 {
+	BEY_PROFILE_ZONE("geometry pass");
+	build_geometry_queue(scene.camera);
+
+	//the light volumes leave back faces culled, the first frame has to cull them too or its geometry buffer differs from the next ones
+	glEnable(GL_CULL_FACE);
+	glCullFace(GL_BACK);
+
+	if (geometry_path == GeometryPath::VISIBILITY_BUFFER)
+	{
+		visibility_pass(scene);
+		visibility_resolve_pass(scene);
+		geometry_buffer.copy_depth();
+		return;
+	}
+
 	geometry_buffer.bind(GeometryBuffer::BindType::WRITE);
-	const Shader& shader = *geometry_buffer.get_geometry_pass_shader();
 
 	glDepthMask(GL_TRUE);
 	glEnable(GL_DEPTH_TEST);
@@ -406,101 +820,1222 @@ void Renderer::geometry_pass(const Scene& scene)
 
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);	
 
-	RenderData* render_data = head;
-	while (render_data != nullptr)
-	{	
-		const StaticModel& static_model = *(render_data->model);
-		const ObjModel::MeshGroup* mesh_group = render_data->model->model->get_mesh_group(render_data->group_id);
-		const ObjModel::ObjMtl* material = (render_data->model)->model->get_material(render_data->group_id);
-		size_t indices_size = static_model.model->num_indices(render_data->group_id) * sizeof(unsigned int);
+	if (depth_pre_pass)
+	{
+		//depth only, then the geometry buffer is only written for the fragments that are visible
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		depth_pre_pass_shader.bind();
+		draw_geometry_queue(scene, depth_pre_pass_shader, true);
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+		glDepthMask(GL_FALSE);
+		glDepthFunc(GL_EQUAL);
+	}
+
+	const Shader& shader = *geometry_buffer.get_geometry_pass_shader();
+	shader.bind();
+	if (geometry_buffer.has_sun_light())
+	{
+		set_sun_light_uniforms(shader, scene);
+	}
+
+	//the fragments that pass the depth test, read back a frame later so the pass never waits for the query
+	if (geometry_samples_query_pending)
+	{
+		GLint available = 0;
+		glGetQueryObjectiv(geometry_samples_query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available)
+		{
+			GLuint samples_passed;
+			glGetQueryObjectuiv(geometry_samples_query, GL_QUERY_RESULT, &samples_passed);
+			geometry_pass_stats.num_samples = samples_passed;
+			geometry_pass_stats.overdraw = (float)samples_passed / (screen_width * screen_height);
+			geometry_samples_query_pending = false;
+		}
+	}
+
+	bool query = !geometry_samples_query_pending;
+	if (query)
+	{
+		glBeginQuery(GL_SAMPLES_PASSED, geometry_samples_query);
+	}
+
+	draw_geometry_queue(scene, shader, false);
+
+	if (query)
+	{
+		glEndQuery(GL_SAMPLES_PASSED);
+		geometry_samples_query_pending = true;
+	}
+
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+
+	geometry_buffer.unbind(GeometryBuffer::BindType::WRITE);
+	geometry_buffer.copy_depth();
+	
+	glDisable(GL_DEPTH_TEST);
+}
+
+void Renderer::visibility_pass(const Scene& scene)
+{
+	BEY_PROFILE_ZONE("visibility pass");
+	//the ids only need the positions, and the depth test already keeps the closest triangle of every pixel
+	visibility_buffer.bind();
+
+	glDepthMask(GL_TRUE);
+	glEnable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+
+	visibility_shader.bind();
+	for (size_t i = 0; i < geometry_queue.size(); i++)
+	{
+		const RenderData* render_data = geometry_queue[i];
+
+		bind_vertices(visibility_shader, *render_data, true);
+		set_uniforms(visibility_shader.program, *render_data, scene.camera);
+		visibility_buffer.set_draw(visibility_shader, render_data->visibility_id);
+
+		glDrawElements(GL_TRIANGLES, render_data->num_indices, GL_UNSIGNED_INT, 0);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	visibility_shader.unbind();
+
+	visibility_buffer.unbind();
+	glDisable(GL_DEPTH_TEST);
+}
+
+void Renderer::visibility_resolve_pass(const Scene& scene)
+{
+	BEY_PROFILE_ZONE("visibility resolve pass");
+	//the depth was written by the visibility pass, only the targets are cleared
+	geometry_buffer.bind(GeometryBuffer::BindType::WRITE);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+
+	RenderData* render_data = quad;
+	visibility_resolve_shader.bind();
+	set_uniforms(visibility_resolve_shader.program, *render_data, scene.camera);
+
+	GLint uni_compact = glGetUniformLocation(visibility_resolve_shader.program, "u_compact_g_buffer");
+	if (uni_compact != -1)
+	{
+		glUniform1i(uni_compact, geometry_buffer.is_compact());
+	}
+
+	//nothing of the geometry buffer is read, the resolve has every texture unit
+	visibility_buffer.bind_textures(visibility_resolve_shader, 0);
+
+	glBindBuffer(GL_ARRAY_BUFFER, render_data->vertices_id);
+	set_attributes(visibility_resolve_shader);
+
+	//every pixel reads the transform and material of its draw, so it is resolved once per batch of diffuse textures whatever the overdraw.
+	//the pixels of the other batches' draws are discarded
+	for (int batch = 0; batch < visibility_buffer.get_num_texture_batches(); batch++)
+	{
+		visibility_buffer.bind_texture_batch(visibility_resolve_shader, batch, VisibilityBuffer::NUM_BUFFER_TEXTURES);
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	visibility_resolve_shader.unbind();
+	geometry_buffer.unbind(GeometryBuffer::BindType::WRITE);
+}
+
+void Renderer::render( const Camera& camera, const Scene& scene )
+{
+	BEY_PROFILE_ZONE("render");
+	GlStats::begin_frame();
+	update_dynamic_models(scene);
+	FrameUpdate frame_update = calc_frame_update(camera, scene);
+	if (frame_update == FrameUpdate::FULL)
+	{
+		frame_update_stats.num_full++;
+	}
+	else if (frame_update == FrameUpdate::LIGHTS_ONLY)
+	{
+		frame_update_stats.num_lights_only++;
+	}
+	else
+	{
+		frame_update_stats.num_idle++;
+	}
+
+	//nothing changed since the last frame, it is shown again as it is. the temporal upscaler's history already holds it
+	if (frame_update == FrameUpdate::IDLE)
+	{
+		if (temporal_upscaling)
+		{
+			temporal_upscaler.present();
+		}
+		else
+		{
+			show_final_render(scene);
+		}
+		GlStats::end_frame();
+		return;
+	}
+
+	//gpu time of the whole frame for the quality governor, read back by update_quality once it is available
+	bool time_frame = quality_governor.is_enabled() && !frame_time_query_pending && !gpu_profiler.is_enabled();
+	if (time_frame)
+	{
+		glBeginQuery(GL_TIME_ELAPSED, frame_time_query);
+	}
+	gpu_profiler.begin_frame();
+
+	//the sun's shadow and the geometry buffer only depend on the camera, they are kept when only the lights changed
+	bool full_frame = frame_update == FrameUpdate::FULL;
+
+	//process directional light shadow. it comes before the geometry pass, which may already light the sun
+	if (full_frame)
+	{
+		begin_profile_section(GpuProfiler::Pass::SUN_SHADOW);
+		directional_light_shadow_pass(scene);
+		end_profile_section();
+	}
+	//render_shadow_map(scene);
+	////////////////////////
+
+	//process every spot light shadow up front, so the light pass below never has to be interrupted
+	spot_light_shadow_atlas_pass(scene);
+
+	glViewport(0, 0, screen_width, screen_height);
+	if (full_frame)
+	{
+		begin_profile_section(GpuProfiler::Pass::GEOMETRY);
+		geometry_pass(scene);
+		end_profile_section();
+	}
+
+	begin_light_pass(scene);
+	if (!full_frame)
+	{
+		geometry_buffer.clear_light_accumulation();
+	}
+
+	//the resolve pass does not light the sun, whatever the geometry buffer is set to
+	if (!geometry_buffer.has_sun_light() || geometry_path == GeometryPath::VISIBILITY_BUFFER || !full_frame)
+	{
+		begin_profile_section(GpuProfiler::Pass::SUN_LIGHT);
+		directional_light_pass(scene);
+		end_profile_section();
+	}
+
+	local_light_pass(scene);
+
+	end_light_pass(scene);
+
+	begin_profile_section(GpuProfiler::Pass::FINAL);
+	show_final_render(scene);
+	end_profile_section();
+
+	gpu_profiler.end_frame();
+	GlStats::end_frame();
+	if (time_frame)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		frame_time_query_pending = true;
+	}
+}
+
+Renderer::FrameUpdate Renderer::calc_frame_update(const Camera& camera, const Scene& scene)
+{
+	bool camera_changed = frame_invalid || camera.get_view_matrix() != last_view_mat || camera.get_unjittered_projection_matrix() != last_proj_mat;
+	//a spot light whose old shadow map no longer matches it still has to catch up with its light, as if the light had moved. the ones
+	//that were only skipped by the budget while their map is still right do not
+	bool lights_changed = scene.get_light_revision() != last_light_revision || shadow_scheduler.get_num_stale() > 0;
+
+	last_view_mat = camera.get_view_matrix();
+	last_proj_mat = camera.get_unjittered_projection_matrix();
+	last_light_revision = scene.get_light_revision();
+	frame_invalid = false;
+	num_converging_frames = camera_changed || lights_changed ? 0 : num_converging_frames + 1;
+
+	//the profiler measures whole frames, even when nothing moves
+	if (!idle_frame_skipping || camera_changed || gpu_profiler.is_enabled())
+	{
+		return FrameUpdate::FULL;
+	}
+
+	//every jitter offset needs its own geometry, the history is rendered in full until it has converged on the still image
+	if (temporal_upscaling)
+	{
+		return num_converging_frames < TemporalUpscaler::NUM_CONVERGENCE_FRAMES ? FrameUpdate::FULL : FrameUpdate::IDLE;
+	}
+
+	return lights_changed ? FrameUpdate::LIGHTS_ONLY : FrameUpdate::IDLE;
+}
+
+void Renderer::set_idle_frame_skipping(bool idle_frame_skipping)
+{
+	this->idle_frame_skipping = idle_frame_skipping;
+	frame_invalid = true;
+}
+
+bool Renderer::get_idle_frame_skipping() const
+{
+	return idle_frame_skipping;
+}
+
+void Renderer::invalidate_frame()
+{
+	frame_invalid = true;
+}
+
+const Renderer::FrameUpdateStats& Renderer::get_frame_update_stats() const
+{
+	return frame_update_stats;
+}
+
+GpuProfiler& Renderer::get_gpu_profiler()
+{
+	return gpu_profiler;
+}
+
+const GpuProfiler& Renderer::get_gpu_profiler() const
+{
+	return gpu_profiler;
+}
+
+void Renderer::local_light_pass(const Scene& scene)
+{
+	BEY_PROFILE_ZONE("local light pass");
+	//point and spot lights, either with one stencil volume per light, or in one pass over the light clusters
+	light_volume_stats = LightVolumeStats();
+	if (light_path == LightPath::CLUSTERED)
+	{
+		begin_profile_section(GpuProfiler::Pass::CLUSTERED_LIGHTS);
+		clustered_light_pass(scene, false);
+		end_profile_section();
+	}
+	else
+	{
+		stencil_light_pass(scene, false);
+	}
+
+	if (light_resolution_scale > 1)
+	{
+		low_resolution_light_pass(scene);
+	}
+}
+
+//the pixels of a full resolution rectangle in the low resolution light buffer
+static glm::ivec4 calc_low_resolution_rect(const glm::ivec4& rect, int scale)
+{
+	int x0 = rect.x / scale;
+	int y0 = rect.y / scale;
+	int x1 = (rect.x + rect.z + scale - 1) / scale;
+	int y1 = (rect.y + rect.w + scale - 1) / scale;
+	return glm::ivec4(x0, y0, x1 - x0, y1 - y0);
+}
+
+void Renderer::low_resolution_light_pass(const Scene& scene)
+{
+	BEY_PROFILE_ZONE("low resolution light pass");
+	int scale = light_resolution_scale;
+	RenderData* render_data = quad;
+
+	//depth of every block's first pixel, the light volumes are tested against it
+	begin_profile_section(GpuProfiler::Pass::LOW_RESOLUTION);
+	low_resolution_light_buffer.bind();
+	glViewport(0, 0, low_resolution_light_buffer.get_width(), low_resolution_light_buffer.get_height());
+	glDisable(GL_BLEND);
+	glDisable(GL_STENCIL_TEST);
+	glDisable(GL_SCISSOR_TEST);
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_ALWAYS);
+	glDepthMask(GL_TRUE);
+	glStencilMask(0xFF);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+	light_downsample_shader.bind();
+	GLint uni_downsample_scale = glGetUniformLocation(light_downsample_shader.program, "u_resolution_scale");
+	if (uni_downsample_scale != -1)
+	{
+		glUniform1i(uni_downsample_scale, scale);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, render_data->vertices_id);
+	set_attributes(light_downsample_shader);
+	geometry_buffer.bind_light_pass_textures(&light_downsample_shader);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	light_downsample_shader.unbind();
+
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_FALSE);
+	end_profile_section();
+
+	//the same light passes as at full resolution, with the same blending
+	glEnable(GL_BLEND);
+	glBlendEquation(GL_FUNC_ADD);
+	glBlendFunc(GL_ONE, GL_ONE);
+	if (light_path == LightPath::CLUSTERED)
+	{
+		begin_profile_section(GpuProfiler::Pass::CLUSTERED_LIGHTS);
+		clustered_light_pass(scene, true);
+		end_profile_section();
+	}
+	else
+	{
+		stencil_light_pass(scene, true);
+	}
+	low_resolution_light_buffer.unbind();
+
+	//back to the light accumulation, added to what the full resolution lights wrote
+	begin_profile_section(GpuProfiler::Pass::LOW_RESOLUTION);
+	glViewport(0, 0, screen_width, screen_height);
+	geometry_buffer.bind(GeometryBuffer::BindType::READ_AND_WRITE);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_STENCIL_TEST);
+	glDisable(GL_SCISSOR_TEST);
+	glEnable(GL_BLEND);
+
+	light_upsample_shader.bind();
+	GLint uni_upsample_scale = glGetUniformLocation(light_upsample_shader.program, "u_resolution_scale");
+	if (uni_upsample_scale != -1)
+	{
+		glUniform1i(uni_upsample_scale, scale);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, render_data->vertices_id);
+	set_attributes(light_upsample_shader);
+	set_uniforms(light_upsample_shader.program, *render_data, scene.camera);
+	geometry_buffer.bind_light_pass_textures(&light_upsample_shader);
+
+	//after the geometry buffer's textures and depth
+	low_resolution_light_buffer.bind_texture(light_upsample_shader, "u_low_resolution_light", GeometryBuffer::NUM_TEXTURES + 1);
+
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	light_upsample_shader.unbind();
+	end_profile_section();
+
+	glEnable(GL_DEPTH_TEST);
+}
+
+void Renderer::stencil_light_pass(const Scene& scene, bool low_resolution)
+{
+	BEY_PROFILE_ZONE("stencil light pass");
+	const Camera& camera = scene.camera;
+	Frustum frustum(camera.get_projection_matrix() * camera.get_view_matrix());
+	glm::vec3 cam_pos = camera.get_position();
+
+	//distance from the camera to the corners of the near plane. a volume closer than that may already clip the near plane
+	const glm::mat4& proj_mat = camera.get_projection_matrix();
+	float near_extent = camera.get_near_clip() * glm::sqrt(1.0f + 1.0f / (proj_mat[0][0] * proj_mat[0][0]) + 1.0f / (proj_mat[1][1] * proj_mat[1][1]));
+
+	//lights that need the stencil pass are drawn afterwards in batches. the other point lights are drawn with a single
+	//instanced draw, the other spot lights right away
+	std::vector<LightVolume> stencil_volumes;
+	std::vector<LightVolume> instanced_volumes;
+
+	//with a resolution scale, each light is drawn either in the full or in the low resolution pass
+	bool split_by_resolution = light_resolution_scale > 1;
+
+	size_t num_point_lights = scene.num_point_lights();
+	const PointLight* point_lights = scene.get_point_lights();
+	for (int i = 0; i < num_point_lights; i++)
+	{
+		const PointLight& point_light = point_lights[i];
+		if (split_by_resolution && point_light.low_resolution != low_resolution)
+		{
+			continue;
+		}
+
+		if (!frustum.intersect_sphere(point_light.position, point_light.cutoff))
+		{
+			count_light_volume(LightVolumeMode::CULLED);
+			continue;
+		}
+
+		LightVolume volume;
+		volume.point_light = &point_light;
+		volume.low_resolution = low_resolution;
+		volume.scissor_rect = calc_sphere_scissor_rect(camera, point_light.position, point_light.cutoff);
+		if (low_resolution)
+		{
+			volume.scissor_rect = calc_low_resolution_rect(volume.scissor_rect, light_resolution_scale);
+		}
+		if (volume.scissor_rect.z == 0 || volume.scissor_rect.w == 0)
+		{
+			count_light_volume(LightVolumeMode::CULLED);
+			continue;
+		}
+
+		bool camera_inside = glm::length(cam_pos - point_light.position) < point_light.cutoff + near_extent;
+		volume.mode = classify_light_volume(camera_inside, volume.scissor_rect);
+		count_light_volume(volume.mode);
+		if (volume.mode == LightVolumeMode::STENCIL)
+		{
+			stencil_volumes.push_back(volume);
+		}
+		else
+		{
+			instanced_volumes.push_back(volume);
+		}
+	}
+
+	//the point lights' parameters for the light pass, the lights drawn without stencil first
+	point_light_data.clear();
+	for (size_t i = 0; i < instanced_volumes.size(); i++)
+	{
+		pack_point_light(*instanced_volumes[i].point_light);
+	}
+	for (size_t i = 0; i < stencil_volumes.size(); i++)
+	{
+		stencil_volumes[i].point_light_index = (int)(point_light_data.size() / point_light_texels);
+		pack_point_light(*stencil_volumes[i].point_light);
+	}
+	point_light_buffer.upload(point_light_data.data(), point_light_data.size() * sizeof(glm::vec4));
+
+	//all the point lights without stencil share the same state, so they are drawn together without scissor,
+	//their back faces and the shader already limit them to the pixels they light
+	if (!instanced_volumes.empty())
+	{
+		begin_light_volume(instanced_volumes[0], 0);
+		glDisable(GL_SCISSOR_TEST);
+		if (gpu_profiler.is_enabled())
+		{
+			//one draw per light, so the profiler can tell them apart
+			for (size_t i = 0; i < instanced_volumes.size(); i++)
+			{
+				begin_profile_section(GpuProfiler::Pass::POINT_LIGHT, (int)(instanced_volumes[i].point_light - point_lights));
+				point_light_pass(scene, (int)i, 1, low_resolution);
+				end_profile_section();
+			}
+		}
+		else
+		{
+			point_light_pass(scene, 0, (int)instanced_volumes.size(), low_resolution);
+		}
+		end_light_volume();
+	}
+
+	size_t num_spot_lights = scene.num_spot_lights();
+	const SpotLight* spot_lights = scene.get_spot_lights();
+	for (int i = 0; i < num_spot_lights; i++)
+	{
+		const SpotLight& spot_light = spot_lights[i];
+		if (split_by_resolution && spot_light.low_resolution != low_resolution)
+		{
+			continue;
+		}
+
+		glm::vec3 direction = spot_light.get_direction();
+		float volume_radius = calc_spot_light_volume_radius(spot_light);
+		if (!frustum.intersect_cone(spot_light.position, direction, spot_light.cutoff, volume_radius))
+		{
+			count_light_volume(LightVolumeMode::CULLED);
+			continue;
+		}
+
+		LightVolume volume;
+		volume.spot_light = &spot_light;
+		volume.spot_light_index = i;
+		volume.low_resolution = low_resolution;
+		volume.scissor_rect = calc_cone_scissor_rect(camera, spot_light);
+		if (low_resolution)
+		{
+			volume.scissor_rect = calc_low_resolution_rect(volume.scissor_rect, light_resolution_scale);
+		}
+		if (volume.scissor_rect.z == 0 || volume.scissor_rect.w == 0)
+		{
+			count_light_volume(LightVolumeMode::CULLED);
+			continue;
+		}
+
+		//distance from the camera to the side of the cone, and along the cone's axis
+		glm::vec3 to_cam = cam_pos - spot_light.position;
+		float axial_distance = glm::dot(to_cam, direction);
+		float radial_distance = glm::length(to_cam - direction * axial_distance);
+		float slant = glm::sqrt(spot_light.cutoff * spot_light.cutoff + volume_radius * volume_radius);
+		float side_distance = (radial_distance * spot_light.cutoff - axial_distance * volume_radius) / slant;
+		bool camera_inside = side_distance < near_extent && axial_distance > -near_extent && axial_distance < spot_light.cutoff + near_extent;
+
+		volume.mode = classify_light_volume(camera_inside, volume.scissor_rect);
+		count_light_volume(volume.mode);
+		if (volume.mode == LightVolumeMode::STENCIL)
+		{
+			stencil_volumes.push_back(volume);
+			continue;
+		}
+
+		begin_profile_section(GpuProfiler::Pass::SPOT_LIGHT, i);
+		begin_light_volume(volume, 0);
+		light_volume_pass(scene, volume);
+		end_light_volume();
+		end_profile_section();
+	}
+
+	//every light of a batch marks its own stencil bit, so the stencil buffer is only cleared once per batch
+	for (size_t first = 0; first < stencil_volumes.size(); first += stencil_batch_size)
+	{
+		size_t last = glm::min(first + stencil_batch_size, stencil_volumes.size());
+
+		//clear the union of the batch's rectangles
+		glm::ivec2 min_pos = glm::ivec2(stencil_volumes[first].scissor_rect);
+		glm::ivec2 max_pos = min_pos;
+		for (size_t i = first; i < last; i++)
+		{
+			const glm::ivec4& rect = stencil_volumes[i].scissor_rect;
+			min_pos = glm::min(min_pos, glm::ivec2(rect.x, rect.y));
+			max_pos = glm::max(max_pos, glm::ivec2(rect.x + rect.z, rect.y + rect.w));
+		}
+		glEnable(GL_SCISSOR_TEST);
+		glScissor(min_pos.x, min_pos.y, max_pos.x - min_pos.x, max_pos.y - min_pos.y);
+		glStencilMask(0xFF);
+		glClear(GL_STENCIL_BUFFER_BIT);
+		light_volume_stats.num_stencil_clears++;
+
+		for (size_t i = first; i < last; i++)
+		{
+			const LightVolume& volume = stencil_volumes[i];
+			glScissor(volume.scissor_rect.x, volume.scissor_rect.y, volume.scissor_rect.z, volume.scissor_rect.w);
+			begin_light_volume_profile(volume, point_lights, true);
+			stencil_pass(scene, *set_light_volume_transform(volume), 1 << (i - first));
+			end_profile_section();
+		}
+
+		for (size_t i = first; i < last; i++)
+		{
+			const LightVolume& volume = stencil_volumes[i];
+			begin_light_volume_profile(volume, point_lights, false);
+			begin_light_volume(volume, 1 << (i - first));
+			light_volume_pass(scene, volume);
+			end_light_volume();
+			end_profile_section();
+		}
+	}
+}
+
+void Renderer::begin_profile_section(GpuProfiler::Pass pass, int light_index)
+{
+	//the profiler's query counts as a call of the pass
+	GlStats::begin(pass);
+	gpu_profiler.begin(pass, light_index);
+}
+
+void Renderer::end_profile_section()
+{
+	gpu_profiler.end();
+	GlStats::end();
+}
+
+void Renderer::begin_light_volume_profile(const LightVolume& volume, const PointLight* point_lights, bool stencil)
+{
+	if (volume.point_light != nullptr)
+	{
+		begin_profile_section(stencil ? GpuProfiler::Pass::POINT_STENCIL : GpuProfiler::Pass::POINT_LIGHT, (int)(volume.point_light - point_lights));
+	}
+	else
+	{
+		begin_profile_section(stencil ? GpuProfiler::Pass::SPOT_STENCIL : GpuProfiler::Pass::SPOT_LIGHT, volume.spot_light_index);
+	}
+}
+
+Renderer::LightVolumeMode Renderer::classify_light_volume(bool camera_inside, const glm::ivec4& scissor_rect) const
+{
+	//the back faces of the volume cover every pixel the light can reach, and the depth test removes what is behind the volume.
+	//the light shaders reject what is in front of it, so the stencil pass is only worth it when the volume covers many pixels
+	if (camera_inside)
+	{
+		return LightVolumeMode::INSIDE;
+	}
+
+	if (scissor_rect.z * scissor_rect.w <= light_scissor_max_pixels)
+	{
+		return LightVolumeMode::SCISSOR;
+	}
+
+	return LightVolumeMode::STENCIL;
+}
+
+glm::ivec4 Renderer::calc_sphere_scissor_rect(const Camera& camera, const glm::vec3& center, float radius) const
+{
+	glm::vec3 view_center = glm::vec3(camera.get_view_matrix() * glm::vec4(center, 1.0f));
+	float near_z = -camera.get_near_clip();
+	if (view_center.z - radius >= near_z)
+	{
+		return glm::ivec4(0); // behind the near plane
+	}
+
+	const glm::mat4& proj_mat = camera.get_projection_matrix();
+	glm::vec2 min_ndc;
+	glm::vec2 max_ndc;
+	calc_sphere_axis_bounds(glm::vec2(view_center.x, view_center.z), radius, near_z, proj_mat[0][0], min_ndc.x, max_ndc.x);
+	calc_sphere_axis_bounds(glm::vec2(view_center.y, view_center.z), radius, near_z, proj_mat[1][1], min_ndc.y, max_ndc.y);
+	return calc_scissor_rect(min_ndc, max_ndc, screen_width, screen_height);
+}
+
+glm::ivec4 Renderer::calc_cone_scissor_rect(const Camera& camera, const SpotLight& spot_light) const
+{
+	//the cone is the hull of its tip and its cap, so it is bounded by the tip and the sphere around the cap
+	glm::mat4 view_mat = camera.get_view_matrix();
+	float cap_radius = calc_spot_light_volume_radius(spot_light);
+	glm::vec3 view_apex = glm::vec3(view_mat * glm::vec4(spot_light.position, 1.0f));
+	glm::vec3 view_cap_center = glm::vec3(view_mat * glm::vec4(spot_light.position + spot_light.get_direction() * spot_light.cutoff, 1.0f));
+	float near_z = -camera.get_near_clip();
+	if (view_apex.z >= near_z || view_cap_center.z + cap_radius >= near_z)
+	{
+		//the cone crosses the near plane, the bounding sphere's bounds are clipped to it
+		glm::vec3 center;
+		float radius;
+		spot_light.calc_bounding_sphere(center, radius);
+		return calc_sphere_scissor_rect(camera, center, radius);
+	}
+
+	const glm::mat4& proj_mat = camera.get_projection_matrix();
+	glm::vec2 min_ndc;
+	glm::vec2 max_ndc;
+	calc_sphere_axis_bounds(glm::vec2(view_cap_center.x, view_cap_center.z), cap_radius, near_z, proj_mat[0][0], min_ndc.x, max_ndc.x);
+	calc_sphere_axis_bounds(glm::vec2(view_cap_center.y, view_cap_center.z), cap_radius, near_z, proj_mat[1][1], min_ndc.y, max_ndc.y);
+	glm::vec2 apex_ndc = glm::vec2(proj_mat[0][0] * view_apex.x, proj_mat[1][1] * view_apex.y) / -view_apex.z;
+	return calc_scissor_rect(glm::min(min_ndc, apex_ndc), glm::max(max_ndc, apex_ndc), screen_width, screen_height);
+}
+
+void Renderer::count_light_volume(LightVolumeMode mode)
+{
+	switch (mode)
+	{
+	case LightVolumeMode::CULLED:
+		light_volume_stats.num_culled++;
+		break;
+	case LightVolumeMode::INSIDE:
+		light_volume_stats.num_inside++;
+		break;
+	case LightVolumeMode::SCISSOR:
+		light_volume_stats.num_scissor++;
+		break;
+	case LightVolumeMode::STENCIL:
+		light_volume_stats.num_stencil++;
+		break;
+	}
+}
+
+void Renderer::begin_light_volume(const LightVolume& volume, GLuint stencil_bit)
+{
+	//the light pass only touches the light's rectangle
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(volume.scissor_rect.x, volume.scissor_rect.y, volume.scissor_rect.z, volume.scissor_rect.w);
+
+	glEnable(GL_CULL_FACE);
+	glCullFace(GL_FRONT); // if we are inside the light volume, if we cull back face, then we cant see the light
+
+	if (volume.mode == LightVolumeMode::STENCIL)
+	{
+		glDisable(GL_DEPTH_TEST);
+		glEnable(GL_STENCIL_TEST);
+		glStencilFunc(GL_EQUAL, stencil_bit, stencil_bit); // the light's bit was set by stencil_pass
+		return;
+	}
+
+	//only the pixels in front of the volume's back faces
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_GEQUAL);
+	glDisable(GL_STENCIL_TEST);
+}
+
+void Renderer::end_light_volume()
+{
+	glCullFace(GL_BACK);
+	glDisable(GL_STENCIL_TEST);
+	glDisable(GL_SCISSOR_TEST);
+	glDepthFunc(GL_LESS);
+	glEnable(GL_DEPTH_TEST);
+}
+
+RenderData* Renderer::set_light_volume_transform(const LightVolume& volume)
+{
+	if (volume.point_light != nullptr)
+	{
+		const PointLight& point_light = *volume.point_light;
+
+		//adjust the sphere for point light
+		sphere->world_mat = glm::scale(glm::mat4(), glm::vec3(point_light.cutoff, point_light.cutoff, point_light.cutoff));
+		sphere->world_mat = glm::translate(glm::mat4(), point_light.position) * sphere->world_mat;
+		return sphere;
+	}
+
+	const SpotLight& spot_light = *volume.spot_light;
+
+	//adjust the cone for spot light
+	float volume_radius = calc_spot_light_volume_radius(spot_light);
+	cone->world_mat = glm::scale(glm::mat4(), glm::vec3(volume_radius, volume_radius, spot_light.cutoff));
+	cone->world_mat = glm::toMat4(spot_light.orientation) * cone->world_mat;
+	cone->world_mat = glm::translate(glm::mat4(), spot_light.position) * cone->world_mat;
+	return cone;
+}
+
+void Renderer::light_volume_pass(const Scene& scene, const LightVolume& volume)
+{
+	set_light_volume_transform(volume);
+	if (volume.point_light != nullptr)
+	{
+		point_light_pass(scene, volume.point_light_index, 1, volume.low_resolution);
+	}
+	else
+	{
+		spot_light_pass(scene, *volume.spot_light, spot_light_shadows[volume.spot_light_index], volume.low_resolution);
+	}
+}
+
+void Renderer::pack_point_light(const PointLight& point_light)
+{
+	point_light_data.push_back(glm::vec4(point_light.position, point_light.cutoff));
+	point_light_data.push_back(glm::vec4(point_light.color, point_light.Kc));
+	point_light_data.push_back(glm::vec4(point_light.Kl, point_light.Kq, 0.0f, 0.0f));
+}
+
+void Renderer::clustered_light_pass(const Scene& scene, bool low_resolution)
+{
+	BEY_PROFILE_ZONE("clustered light pass");
+	//the spot light shadows come from the atlas, like in the stencil path
+	size_t num_spot_lights = scene.num_spot_lights();
+	std::vector<glm::vec4> spot_shadow_tiles(num_spot_lights);
+	std::vector<glm::mat4> spot_shadow_proj_views(num_spot_lights);
+	for (size_t i = 0; i < num_spot_lights; i++)
+	{
+		const SpotLightShadow& shadow = spot_light_shadows[i];
+		spot_shadow_tiles[i] = shadow.tile.size > 0 ? shadow_atlas.get_tile_transform(shadow.tile) : glm::vec4(0.0f);
+		spot_shadow_proj_views[i] = shadow.proj_view;
+	}
+
+	ClusteredLighting::LightSelection selection = ClusteredLighting::LightSelection::ALL;
+	if (light_resolution_scale > 1)
+	{
+		selection = low_resolution ? ClusteredLighting::LightSelection::LOW_RESOLUTION : ClusteredLighting::LightSelection::FULL_RESOLUTION;
+	}
+	clustered_lighting.update(scene.camera, scene, spot_shadow_tiles, spot_shadow_proj_views, selection);
+
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_STENCIL_TEST);
+
+	//render with quad, every pixel looks up the lights of its cluster
+	RenderData* render_data = quad;
+	const Shader& clustered_light_shader = get_clustered_light_shader(low_resolution);
+	clustered_light_shader.bind();
+
+	GLint uni_cam_direction = glGetUniformLocation(clustered_light_shader.program, "u_cam_direction");
+	if (uni_cam_direction != -1)
+	{
+		glm::vec3 cam_direction = scene.camera.get_direction();
+		glUniform3f(uni_cam_direction, cam_direction.x, cam_direction.y, cam_direction.z);
+	}
+
+	GLint uni_shadow_map = glGetUniformLocation(clustered_light_shader.program, "u_shadow_map");
+	if (uni_shadow_map != -1)
+	{
+		const int active_texture_id = 5;
+		glActiveTexture(GL_TEXTURE0 + active_texture_id); // watch out, bind it to other than the first 4, because it is already being used by geometry buffer
+		glBindTexture(GL_TEXTURE_2D, shadow_atlas.get_shadow_map().get_shadow_texture_id());
+		glUniform1i(uni_shadow_map, active_texture_id);
+	}
+
+	//after the geometry buffer's textures and depth
+	clustered_lighting.bind(clustered_light_shader, GeometryBuffer::NUM_TEXTURES + 1);
+
+	glBindBuffer(GL_ARRAY_BUFFER, render_data->vertices_id);
+
+	//set shader's attributes and uniforms		
+	set_attributes(clustered_light_shader);
+	set_uniforms(clustered_light_shader.program, *render_data, scene.camera);
+
+	geometry_buffer.bind_light_pass_textures(&clustered_light_shader);
+
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+	//unbind all previous binding
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	clustered_light_shader.unbind();
+}
+
+void Renderer::set_depth_pre_pass(bool depth_pre_pass)
+{
+	this->depth_pre_pass = depth_pre_pass;
+}
+
+bool Renderer::get_depth_pre_pass() const
+{
+	return depth_pre_pass;
+}
+
+void Renderer::set_sort_front_to_back(bool sort_front_to_back)
+{
+	this->sort_front_to_back = sort_front_to_back;
+}
+
+bool Renderer::get_sort_front_to_back() const
+{
+	return sort_front_to_back;
+}
+
+const Renderer::GeometryPassStats& Renderer::get_geometry_pass_stats() const
+{
+	return geometry_pass_stats;
+}
+
+void Renderer::set_light_resolution_scale(int scale)
+{
+	scale = scale >= 4 ? 4 : (scale >= 2 ? 2 : 1);
+	if (scale != light_resolution_scale)
+	{
+		light_resolution_scale = scale;
+		low_resolution_light_buffer.set_scale(scale);
+		invalidate_frame();
+	}
+}
+
+int Renderer::get_light_resolution_scale() const
+{
+	return light_resolution_scale;
+}
+
+void Renderer::compare_light_resolution(const Scene& scene, int num_frames)
+{
+	int low_scale = light_resolution_scale;
+	if (low_scale == 1)
+	{
+		std::cout << "local lights : every light is at full resolution" << std::endl;
+		return;
+	}
+
+	bool current_idle_frame_skipping = idle_frame_skipping;
+	idle_frame_skipping = false;
+	int scales[] = { 1, low_scale };
+	std::vector<glm::vec3> light_accumulations[2];
+	float light_pass_times[2];
+	for (int i = 0; i < 2; i++)
+	{
+		set_light_resolution_scale(scales[i]);
+		render(scene.camera, scene);
+
+		//what the frame shows, read before the timed passes below add to it again
+		light_accumulations[i].resize((size_t)screen_width * screen_height);
+		geometry_buffer.bind(GeometryBuffer::BindType::READ);
+		geometry_buffer.set_read_buffer(GeometryBuffer::TextureType::LIGHT_ACCUMULATION);
+		glReadPixels(0, 0, screen_width, screen_height, GL_RGB, GL_FLOAT, light_accumulations[i].data());
+		geometry_buffer.unbind(GeometryBuffer::BindType::READ);
+
+		sf::Clock clock;
+		float light_pass_time = 0.0f;
+		for (int frame = 0; frame < num_frames; frame++)
+		{
+			glFinish();
+			clock.restart();
+			begin_light_pass(scene);
+			local_light_pass(scene);
+			end_light_pass(scene);
+			glFinish();
+			light_pass_time += clock.restart().asSeconds();
+		}
+		light_pass_times[i] = light_pass_time * 1000.0f / num_frames;
+	}
+	set_light_resolution_scale(low_scale);
+	//the timed passes added to the light accumulation the last frame shows
+	idle_frame_skipping = current_idle_frame_skipping;
+	invalidate_frame();
+
+	//the error of what reaches the screen, where the light accumulation is clamped
+	double squared_error = 0.0;
+	for (size_t i = 0; i < light_accumulations[0].size(); i++)
+	{
+		glm::vec3 difference = glm::clamp(light_accumulations[0][i], 0.0f, 1.0f) - glm::clamp(light_accumulations[1][i], 0.0f, 1.0f);
+		squared_error += glm::dot(difference, difference);
+	}
+	float rmse = (float)glm::sqrt(squared_error / (light_accumulations[0].size() * 3));
+
+	std::cout << "local lights : full resolution " << light_pass_times[0] << " ms, 1/" << low_scale << " resolution " << light_pass_times[1]
+		<< " ms (" << num_frames << " frames), rmse " << rmse << " (" << rmse * 255.0f << " / 255)" << std::endl;
+}
+
+void Renderer::set_geometry_path(GeometryPath geometry_path)
+{
+	if (geometry_path == GeometryPath::VISIBILITY_BUFFER && !visibility_buffer.is_complete())
+	{
+		return;
+	}
+	this->geometry_path = geometry_path;
+	invalidate_frame();
+}
+
+Renderer::GeometryPath Renderer::get_geometry_path() const
+{
+	return geometry_path;
+}
+
+void Renderer::benchmark_geometry_paths(const Scene& scene, int num_frames)
+{
+	//every frame is timed in full, even when nothing moves
+	bool current_idle_frame_skipping = idle_frame_skipping;
+	idle_frame_skipping = false;
+	GeometryPath current_path = geometry_path;
+	GeometryPath paths[] = { GeometryPath::GEOMETRY_BUFFER, GeometryPath::VISIBILITY_BUFFER };
+	const char* names[] = { "geometry buffer", "visibility buffer" };
+	for (int i = 0; i < 2; i++)
+	{
+		set_geometry_path(paths[i]);
+		if (geometry_path != paths[i])
+		{
+			std::cout << "benchmark " << names[i] << " : not available" << std::endl;
+			continue;
+		}
+
+		//the first frames pay for the first use of the shaders and the buffers
+		for (int frame = 0; frame < 5; frame++)
+		{
+			render(scene.camera, scene);
+		}
+
+		sf::Clock clock;
+		float geometry_pass_time = 0.0f;
+		float frame_time = 0.0f;
+		for (int frame = 0; frame < num_frames; frame++)
+		{
+			glFinish();
+			clock.restart();
+			glViewport(0, 0, screen_width, screen_height);
+			geometry_pass(scene);
+			glFinish();
+			geometry_pass_time += clock.restart().asSeconds();
+
+			render(scene.camera, scene);
+			glFinish();
+			frame_time += clock.restart().asSeconds();
+		}
+
+		std::cout << "benchmark " << names[i] << " : geometry pass " << geometry_pass_time * 1000.0f / num_frames << " ms, frame "
+			<< frame_time * 1000.0f / num_frames << " ms (" << num_frames << " frames";
+		//the resolve covers the screen once per batch of diffuse textures
+		if (paths[i] == GeometryPath::VISIBILITY_BUFFER)
+		{
+			std::cout << ", " << visibility_buffer.get_num_texture_batches() << " resolve passes";
+		}
+		std::cout << ")" << std::endl;
+		if (GlStats::is_compiled())
+		{
+			std::cout << "benchmark " << names[i] << " : ";
+			GlStats::print_frame(std::cout);
+		}
+	}
+	set_geometry_path(current_path);
+	idle_frame_skipping = current_idle_frame_skipping;
+}
+
+void Renderer::set_fused_sun_light(bool fused_sun_light)
+{
+	geometry_buffer.set_sun_light(fused_sun_light);
+	invalidate_frame();
+}
+
+bool Renderer::get_fused_sun_light() const
+{
+	return geometry_buffer.has_sun_light();
+}
+
+void Renderer::set_light_path(LightPath light_path)
+{
+	this->light_path = light_path;
+	invalidate_frame();
+}
+
+Renderer::LightPath Renderer::get_light_path() const
+{
+	return light_path;
+}
+
+const Renderer::LightVolumeStats& Renderer::get_light_volume_stats() const
+{
+	return light_volume_stats;
+}
+
+void Renderer::set_stencil_batch_size(int batch_size)
+{
+	stencil_batch_size = glm::clamp(batch_size, 1, max_stencil_batch_size);
+}
+
+int Renderer::get_stencil_batch_size() const
+{
+	return stencil_batch_size;
+}
+
+void Renderer::show_final_render(const Scene& scene)
+{
+	BEY_PROFILE_ZONE("final render");
+	if (temporal_upscaling)
+	{
+		temporal_upscale_pass(scene);
+		return;
+	}
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	geometry_buffer.bind(GeometryBuffer::BindType::READ);
+
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	geometry_buffer.set_read_buffer(GeometryBuffer::TextureType::LIGHT_ACCUMULATION);
+	glBlitFramebuffer(0, 0, screen_width, screen_height, 0, 0, window_width, window_height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+	geometry_buffer.unbind(GeometryBuffer::BindType::READ);
+}
+
+void Renderer::temporal_upscale_pass(const Scene& scene)
+{
+	BEY_PROFILE_ZONE("temporal upscale pass");
+	//render with quad, one fragment per window pixel
+	RenderData* render_data = quad;
+	const Camera& camera = scene.camera;
+
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_STENCIL_TEST);
+	glDisable(GL_SCISSOR_TEST);
+	glDisable(GL_BLEND);
 
-		glBindBuffer(GL_ARRAY_BUFFER, render_data->vertices_id);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, render_data->indices_id);
+	temporal_upscale_shader.bind();
+	glBindBuffer(GL_ARRAY_BUFFER, render_data->vertices_id);
+	set_attributes(temporal_upscale_shader);
+	set_uniforms(temporal_upscale_shader.program, *render_data, camera);
+	geometry_buffer.bind_light_pass_textures(&temporal_upscale_shader);
+	geometry_buffer.bind_texture(&temporal_upscale_shader, "u_light", GeometryBuffer::LIGHT_ACCUMULATION);
 
-		//set shader's attributes and uniforms		
-		set_attributes(shader);
-		set_uniforms(shader.program, *render_data, scene.camera);
+	GLint uni_jitter = glGetUniformLocation(temporal_upscale_shader.program, "u_jitter");
+	if (uni_jitter != -1)
+	{
+		glm::vec2 jitter = camera.get_jitter() * 0.5f * glm::vec2(screen_width, screen_height);
+		glUniform2f(uni_jitter, jitter.x, jitter.y);
+	}
 
-		glDrawElements(GL_TRIANGLES, indices_size, GL_UNSIGNED_INT, 0);
+	//after the geometry buffer's textures and depth
+	temporal_upscaler.begin_resolve(temporal_upscale_shader, GeometryBuffer::NUM_TEXTURES + 1);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	temporal_upscaler.end_resolve(camera.get_unjittered_projection_matrix() * camera.get_view_matrix());
 
-		render_data = render_data->next;
-	}
-	//unbind all previous binding
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	temporal_upscale_shader.unbind();
 
-	geometry_buffer.unbind(GeometryBuffer::BindType::WRITE);
-	
-	glDisable(GL_DEPTH_TEST);
+	temporal_upscaler.present();
+	glViewport(0, 0, screen_width, screen_height);
 }
 
-void Renderer::render( const Camera& camera, const Scene& scene )
+void Renderer::set_temporal_upscaling(bool temporal_upscaling)
 {
-	geometry_pass(scene);
+	if (temporal_upscaling && !this->temporal_upscaling)
+	{
+		temporal_upscaler.reset();
+	}
+	this->temporal_upscaling = temporal_upscaling;
+	invalidate_frame();
+}
 
-	//process directional light shadow
-	shadow_map.bind_first_pass();
-	directional_light_shadow_pass(scene);
-	shadow_map.unbind_first_pass();
-	//render_shadow_map(scene);
-	////////////////////////
+bool Renderer::get_temporal_upscaling() const
+{
+	return temporal_upscaling;
+}
 
-	begin_light_pass(scene);
-	directional_light_pass(scene);	
+void Renderer::resize(int window_width, int window_height)
+{
+	this->window_width = glm::max(window_width, 1);
+	this->window_height = glm::max(window_height, 1);
+	temporal_upscaler.resize(this->window_width, this->window_height);
+	resize_render_targets();
+	invalidate_frame();
+}
 
-	size_t num_point_lights = scene.num_point_lights();
-	const PointLight* point_lights = scene.get_point_lights();
-	for (int i = 0; i < num_point_lights; i++)
-	{
-		const PointLight& point_light = point_lights[i];
+void Renderer::set_render_scale(float render_scale)
+{
+	this->render_scale = glm::clamp(render_scale, min_render_scale, 1.0f);
+	resize_render_targets();
+}
 
-		//adjust the sphere for point light
-		sphere->world_mat = glm::scale(glm::mat4(), glm::vec3(point_light.cutoff, point_light.cutoff, point_light.cutoff));
-		sphere->world_mat = glm::translate(glm::mat4(), point_light.position) * sphere->world_mat;
+float Renderer::get_render_scale() const
+{
+	return render_scale;
+}
 
-		stencil_pass(scene, *sphere);
-		point_light_pass(scene, point_light);
+void Renderer::resize_render_targets()
+{
+	int width = calc_render_size(window_width, render_scale);
+	int height = calc_render_size(window_height, render_scale);
+	if (width == screen_width && height == screen_height)
+	{
+		return;
 	}
 
-	size_t num_spot_lights = scene.num_spot_lights();
-	const SpotLight* spot_lights = scene.get_spot_lights();
-	for (int i = 0; i < num_spot_lights; i++)
-	{
-		const SpotLight& spot_light = spot_lights[i];
+	screen_width = width;
+	screen_height = height;
+	geometry_buffer.resize(screen_width, screen_height);
+	visibility_buffer.resize(screen_width, screen_height);
+	low_resolution_light_buffer.resize(screen_width, screen_height);
+	invalidate_frame();
+	std::cout << "geometry buffer : " << screen_width << "x" << screen_height << " for a " << window_width << "x" << window_height << " window, "
+		<< geometry_buffer.get_memory_size() / (1024.0f * 1024.0f) << " MB" << std::endl;
+}
 
-		//adjust the cone for spot light
-		cone->world_mat = glm::scale(glm::mat4(), glm::vec3(spot_light.base_radius, spot_light.base_radius, spot_light.cutoff));
-		cone->world_mat = glm::toMat4(spot_light.orientation) * cone->world_mat;
-		cone->world_mat = glm::translate(glm::mat4(), spot_light.position) * cone->world_mat;
+void Renderer::set_target_frame_time(float milliseconds)
+{
+	quality_governor.set_target(milliseconds);
+}
 
-		stencil_pass(scene, *cone);
-		end_light_pass(scene); // temporarily switch off light pass
+float Renderer::get_target_frame_time() const
+{
+	return quality_governor.get_target();
+}
 
-		//process shadow
-		shadow_map.bind_first_pass();
-		spot_light_shadow_pass(scene, spot_light);
-		shadow_map.unbind_first_pass();
-		//render_shadow_map(scene); //for debug only, remember this is inside the loop, so debug only when spotlight count is one
+const QualityGovernor& Renderer::get_quality_governor() const
+{
+	return quality_governor;
+}
 
-		begin_light_pass(scene);
-		spot_light_pass(scene, spot_light); // turn it back on again after shadow pass
+void Renderer::update_quality(Scene& scene)
+{
+	BEY_PROFILE_ZONE("quality update");
+	//while the profiler runs, its sections add up to the frame time
+	if (gpu_profiler.is_enabled() && gpu_profiler.get_num_frames() > 0 && gpu_profiler.get_num_frames() != num_profiled_frames)
+	{
+		num_profiled_frames = gpu_profiler.get_num_frames();
+		quality_governor.add_frame_time(gpu_profiler.get_frame_time());
 	}
 
-	end_light_pass(scene);
+	//the query is read a frame or two late, so the cpu never waits for the gpu
+	if (frame_time_query_pending)
+	{
+		GLint available = 0;
+		glGetQueryObjectiv(frame_time_query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available)
+		{
+			GLuint64 elapsed_nanoseconds;
+			glGetQueryObjectui64v(frame_time_query, GL_QUERY_RESULT, &elapsed_nanoseconds);
+			frame_time_query_pending = false;
+			quality_governor.add_frame_time(elapsed_nanoseconds / 1000000.0f);
+		}
+	}
 
-	show_final_render(scene);
+	if (quality_governor.get_level_index() != quality_level)
+	{
+		apply_quality_level(scene);
+	}
 }
 
-void Renderer::show_final_render(const Scene& scene)
+void Renderer::apply_quality_level(Scene& scene)
 {
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-	geometry_buffer.bind(GeometryBuffer::BindType::READ);
-
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	geometry_buffer.set_read_buffer(GeometryBuffer::TextureType::LIGHT_ACCUMULATION);
-	glBlitFramebuffer(0, 0, screen_width, screen_height, 0, 0, screen_width, screen_height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
-
-	geometry_buffer.unbind(GeometryBuffer::BindType::READ);
+	const QualityGovernor::Level& level = quality_governor.get_level();
+	quality_level = quality_governor.get_level_index();
+
+	set_render_scale(level.render_scale);
+	shadow_atlas.set_max_tile_size(level.shadow_tile_size);
+	sun_shadow_map.set_resolution(level.sun_shadow_resolution);
+	//the spot lights' shadow matrices follow their new cutoff, the scheduler picks that up as a moved light
+	scene.set_light_cutoff_threshold(level.light_cutoff_threshold);
+
+	ShadowScheduler::Budget budget = shadow_scheduler.get_budget();
+	budget.max_updates = level.shadow_updates;
+	shadow_scheduler.set_budget(budget);
+	invalidate_frame();
 }
 
 void Renderer::render_all_models(const Camera& camera, const Scene& scene)
@@ -526,9 +2061,7 @@ void Renderer::render_model(const Camera& camera, const Scene& scene, const Rend
 {
 	shader.bind();
 
-	const StaticModel& static_model = *(render_data.model);
 	const ObjModel::MeshGroup* mesh_group = render_data.model->model->get_mesh_group(render_data.group_id);
-	size_t indices_size = static_model.model->num_indices(render_data.group_id) * sizeof(unsigned int);
 
 	glBindBuffer(GL_ARRAY_BUFFER, render_data.vertices_id);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, render_data.indices_id);
@@ -537,7 +2070,7 @@ void Renderer::render_model(const Camera& camera, const Scene& scene, const Rend
 	set_attributes(shader);
 	set_uniforms(shader.program, render_data, scene.camera);
 
-	glDrawElements(GL_TRIANGLES, indices_size, GL_UNSIGNED_INT, 0);
+	glDrawElements(GL_TRIANGLES, render_data.num_indices, GL_UNSIGNED_INT, 0);
 
 	//unbind all previous binding
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -567,47 +2100,85 @@ void Renderer::end_light_pass(const Scene& scene)
 	glDepthMask(GL_TRUE); // enable back depth mask writing
 }
 
-void Renderer::directional_light_pass(const Scene& scene)
+void Renderer::set_sun_light_uniforms(const Shader& shader, const Scene& scene)
 {
-	//render with quad (all pixels in the screen will be affected by sunlight)
-	RenderData* render_data = quad;
-	const DirectionalLight& sunlight = scene.get_sunlight();	
-
-	glm::vec3 center = glm::vec3((scene.bounding_box.min.x + scene.bounding_box.max.x) * 0.5f, (scene.bounding_box.min.y + scene.bounding_box.max.y) * 0.5f, (scene.bounding_box.min.z + scene.bounding_box.max.z) * 0.5f);
-
-	glm::mat4 light_projection = glm::ortho<float>(scene.bounding_box.min.x, scene.bounding_box.max.x, scene.bounding_box.min.y, scene.bounding_box.max.y, scene.bounding_box.min.z, scene.bounding_box.max.z);
-	glm::mat4 light_view = glm::lookAt(-sunlight.direction, center, glm::vec3(0, 1, 0));
-	glm::mat4 light_model = glm::mat4(1.0);
-
-	directional_light_shader.bind();			
+	const DirectionalLight& sunlight = scene.get_sunlight();
 
 	//set directional light's uniform
-	GLuint uni_light_direction = glGetUniformLocation(directional_light_shader.program, "u_light_direction"); // assume it exists
+	GLuint uni_light_direction = glGetUniformLocation(shader.program, "u_light_direction"); // assume it exists
 	if (uni_light_direction != -1)
 	{
 		glUniform3f(uni_light_direction, sunlight.direction.x, sunlight.direction.y, sunlight.direction.z);
 	}
 
-	GLuint uni_light_color = glGetUniformLocation(directional_light_shader.program, "u_light_color");
+	GLuint uni_light_color = glGetUniformLocation(shader.program, "u_light_color");
 	if (uni_light_color != -1)
 	{
 		glUniform3f(uni_light_color, sunlight.color.r, sunlight.color.g, sunlight.color.b);
 	}
 
-	GLuint uni_light_pv = glGetUniformLocation(directional_light_shader.program, "u_light_pv");
-	if (uni_light_pv != -1)
+	//the cascades of the sun shadow, the shader picks one per pixel from its view depth
+	int num_cascades = sun_shadow_map.get_num_cascades();
+	glm::mat4 cascade_proj_views[CascadedShadowMap::MAX_CASCADES];
+	glm::vec4 cascade_tiles[CascadedShadowMap::MAX_CASCADES];
+	glm::vec4 cascade_splits = glm::vec4(0.0f);
+	for (int i = 0; i < num_cascades; i++)
+	{
+		cascade_proj_views[i] = sun_shadow_map.get_proj_view(i);
+		cascade_tiles[i] = sun_shadow_map.get_tile_transform(i);
+		cascade_splits[i] = sun_shadow_map.get_split_distance(i);
+	}
+
+	GLuint uni_num_cascades = glGetUniformLocation(shader.program, "u_num_cascades");
+	if (uni_num_cascades != -1)
+	{
+		glUniform1i(uni_num_cascades, num_cascades);
+	}
+
+	GLuint uni_cascade_pv = glGetUniformLocation(shader.program, "u_cascade_pv");
+	if (uni_cascade_pv != -1)
+	{
+		glUniformMatrix4fv(uni_cascade_pv, num_cascades, GL_FALSE, glm::value_ptr(cascade_proj_views[0]));
+	}
+
+	GLuint uni_cascade_tiles = glGetUniformLocation(shader.program, "u_cascade_tiles");
+	if (uni_cascade_tiles != -1)
+	{
+		glUniform4fv(uni_cascade_tiles, num_cascades, glm::value_ptr(cascade_tiles[0]));
+	}
+
+	GLuint uni_cascade_splits = glGetUniformLocation(shader.program, "u_cascade_splits");
+	if (uni_cascade_splits != -1)
+	{
+		glUniform4fv(uni_cascade_splits, 1, glm::value_ptr(cascade_splits));
+	}
+
+	GLuint uni_cam_direction = glGetUniformLocation(shader.program, "u_cam_direction");
+	if (uni_cam_direction != -1)
 	{
-		glUniformMatrix4fv(uni_light_pv, 1, GL_FALSE, glm::value_ptr(light_projection * light_view * light_model * render_data->world_mat));
+		glm::vec3 cam_direction = scene.camera.get_direction();
+		glUniform3f(uni_cam_direction, cam_direction.x, cam_direction.y, cam_direction.z);
 	}
 
-	GLuint uni_shadow_map = glGetUniformLocation(directional_light_shader.program, "u_shadow_map");
+	GLuint uni_shadow_map = glGetUniformLocation(shader.program, "u_shadow_map");
 	if (uni_shadow_map != -1)
 	{
 		const int active_texture_id = 5;
 		glActiveTexture(GL_TEXTURE0 + active_texture_id); // watch out, bind it to other than the first 4, because it is already being used by geometry buffer
-		glBindTexture(GL_TEXTURE_2D, shadow_map.get_shadow_texture_id());
+		glBindTexture(GL_TEXTURE_2D, sun_shadow_map.get_shadow_map().get_shadow_texture_id());
 		glUniform1i(uni_shadow_map, active_texture_id);
 	}
+}
+
+void Renderer::directional_light_pass(const Scene& scene)
+{
+	BEY_PROFILE_ZONE("sun light pass");
+	//render with quad (all pixels in the screen will be affected by sunlight)
+	RenderData* render_data = quad;
+
+	directional_light_shader.bind();			
+
+	set_sun_light_uniforms(directional_light_shader, scene);
 
 	glBindBuffer(GL_ARRAY_BUFFER, render_data->vertices_id);
 
@@ -616,10 +2187,7 @@ void Renderer::directional_light_pass(const Scene& scene)
 	set_uniforms(directional_light_shader.program, *render_data, scene.camera);
 
 	//bind geometry buffers to be sampled
-	geometry_buffer.bind_texture(&directional_light_shader, "u_g_position", GeometryBuffer::TextureType::POSITION);
-	geometry_buffer.bind_texture(&directional_light_shader, "u_g_specular", GeometryBuffer::TextureType::SPECULAR);
-	geometry_buffer.bind_texture(&directional_light_shader, "u_g_diffuse", GeometryBuffer::TextureType::DIFFUSE);
-	geometry_buffer.bind_texture(&directional_light_shader, "u_g_normal", GeometryBuffer::TextureType::NORMAL);
+	geometry_buffer.bind_light_pass_textures(&directional_light_shader);
 
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 
@@ -630,7 +2198,7 @@ void Renderer::directional_light_pass(const Scene& scene)
 	directional_light_shader.unbind();	
 }
 
-void Renderer::stencil_pass(const Scene& scene, const RenderData& render_data)
+void Renderer::stencil_pass(const Scene& scene, const RenderData& render_data, GLuint stencil_bit)
 {
 	glEnable(GL_DEPTH_TEST);
 	glEnable(GL_STENCIL_TEST);
@@ -638,55 +2206,81 @@ void Renderer::stencil_pass(const Scene& scene, const RenderData& render_data)
 	stencil_shader.bind();
 	glDrawBuffer(GL_NONE); // disable draw buffer for stencil pass, we dont wanna output black color to the color buffer. this will disable the draw buffer set up by the geometry buffer.
 
-	//stencil preparation
-	glClear(GL_STENCIL_BUFFER_BIT);
+	//stencil preparation. every face behind the geometry flips the light's bit, the geometry is inside the volume where
+	//an odd number of faces flipped it (a back face only, or a back face and a front face clipped by the near plane).
+	//the bit is expected to be cleared by the caller
+	glStencilMask(stencil_bit);
 	glStencilFunc(GL_ALWAYS, 0, 0); // always success
-	glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
-	glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+	glStencilOp(GL_KEEP, GL_INVERT, GL_KEEP);
 
-	size_t indices_size = render_data.model->model->num_indices(sphere->group_id) * sizeof(unsigned int);
 
 	//bind vertices and indices
-	glBindBuffer(GL_ARRAY_BUFFER, render_data.vertices_id);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, render_data.indices_id);
-
-	set_attributes(stencil_shader);
+	bind_vertices(stencil_shader, render_data, true);
 	set_uniforms(stencil_shader.program, render_data, scene.camera);
 
-	glDrawElements(GL_TRIANGLES, indices_size, GL_UNSIGNED_INT, 0);
+	glDrawElements(GL_TRIANGLES, render_data.num_indices, GL_UNSIGNED_INT, 0);
 
 	//unbind all previous binding
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	
-	//bring back geometry draw buffer
-	geometry_buffer.setup_draw_buffers();
+	//bring back the light accumulation draw buffer
+	geometry_buffer.setup_light_draw_buffer();
 	stencil_shader.unbind();
+	glStencilMask(0xFF);
 	glDisable(GL_STENCIL_TEST);
 	glDisable(GL_DEPTH_TEST);
 }
 
-void Renderer::point_light_pass(const Scene& scene, const PointLight& point_light)
+ShaderDefines Renderer::get_local_light_defines(bool spot_light, bool shadows, bool low_resolution) const
 {
-	glDisable(GL_DEPTH_TEST);	
-	
-	glEnable(GL_STENCIL_TEST);	
-	glStencilFunc(GL_NOTEQUAL, 0, 0xFF);
+	ShaderDefines defines;
+	defines.set(spot_light ? "SPOT_LIGHT" : "POINT_LIGHT");
+	if (shadows)
+	{
+		defines.set("SHADOWS");
+		defines.set("PCF_SIZE", spot_shadow_pcf_size);
+	}
+	defines.set("COMPACT_G_BUFFER", geometry_buffer.is_compact() ? 1 : 0);
+	if (low_resolution)
+	{
+		defines.set("RESOLUTION_SCALE", light_resolution_scale);
+	}
+	return defines;
+}
 
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_FRONT); // if we are inside the light volume, if we cull back face, then we cant see the light
+const Shader& Renderer::get_local_light_shader(bool spot_light, bool shadows, bool low_resolution)
+{
+	return local_light_shaders.get_variant(get_local_light_defines(spot_light, shadows, low_resolution));
+}
+
+ShaderDefines Renderer::get_clustered_light_defines(bool low_resolution) const
+{
+	//the spot shadows are filtered like in the local light shader, whichever path draws them
+	ShaderDefines defines;
+	defines.set("PCF_SIZE", spot_shadow_pcf_size);
+	if (low_resolution)
+	{
+		defines.set("RESOLUTION_SCALE", light_resolution_scale);
+	}
+	return defines;
+}
 
+const Shader& Renderer::get_clustered_light_shader(bool low_resolution)
+{
+	return clustered_light_shaders.get_variant(get_clustered_light_defines(low_resolution));
+}
+
+void Renderer::point_light_pass(const Scene& scene, int first_light, int num_lights, bool low_resolution)
+{
+	//depth, stencil and face culling are set up by begin_light_volume
 	glEnable(GL_BLEND);
 	glBlendEquation(GL_FUNC_ADD);
 	glBlendFunc(GL_ONE, GL_ONE);
 
+	const Shader& point_light_shader = get_local_light_shader(false, false, low_resolution);
 	point_light_shader.bind();
 
-	size_t indices_size = sphere->model->model->num_indices(sphere->group_id) * sizeof(unsigned int);
-
-	//world mat is already calculated outside of this function
-	//sphere->world_mat = glm::scale(glm::mat4(), glm::vec3(point_light.cutoff, point_light.cutoff, point_light.cutoff));
-	//sphere->world_mat = glm::translate(glm::mat4(), point_light.position) * sphere->world_mat;
 
 	//bind vertices and indices
 	glBindBuffer(GL_ARRAY_BUFFER, sphere->vertices_id);
@@ -696,83 +2290,44 @@ void Renderer::point_light_pass(const Scene& scene, const PointLight& point_ligh
 	set_attributes(point_light_shader);
 	set_uniforms(point_light_shader.program, *sphere, scene.camera);
 
-	//set light specific properties
-	GLuint uni_light_color = glGetUniformLocation(point_light_shader.program, "u_light_color");
-	if (uni_light_color != -1)
-	{
-		glUniform3f(uni_light_color, point_light.color.r, point_light.color.g, point_light.color.b);
-	}
-
-	GLuint uni_light_position = glGetUniformLocation(point_light_shader.program, "u_light_position");
-	if (uni_light_position != -1)
-	{
-		glUniform3f(uni_light_position, point_light.position.x, point_light.position.y, point_light.position.z);
-	}		
-
-	GLuint uni_light_const_att = glGetUniformLocation(point_light_shader.program, "u_light_const_attenuation");
-	if (uni_light_const_att != -1)
-	{
-		glUniform1f(uni_light_const_att, point_light.Kc);
-	}
-
-	GLuint uni_light_linear_att = glGetUniformLocation(point_light_shader.program, "u_light_linear_attenuation");
-	if (uni_light_linear_att != -1)
+	//every instance places the sphere on one light and reads its properties from the point light buffer
+	GLuint uni_first_light = glGetUniformLocation(point_light_shader.program, "u_first_light");
+	if (uni_first_light != -1)
 	{
-		glUniform1f(uni_light_linear_att, point_light.Kl);
+		glUniform1i(uni_first_light, first_light);
 	}
 
-	GLuint uni_light_quad_att = glGetUniformLocation(point_light_shader.program, "u_light_quadratic_attenuation");
-	if (uni_light_quad_att != -1)
-	{
-		glUniform1f(uni_light_quad_att, point_light.Kq);
-	}
+	//after the geometry buffer's textures and depth
+	point_light_buffer.bind(point_light_shader, "u_point_lights", GeometryBuffer::NUM_TEXTURES + 1);
 
 	//bind geometry buffers to be sampled
-	geometry_buffer.bind_texture(&point_light_shader, "u_g_position", GeometryBuffer::TextureType::POSITION);
-	geometry_buffer.bind_texture(&point_light_shader, "u_g_specular", GeometryBuffer::TextureType::SPECULAR);
-	geometry_buffer.bind_texture(&point_light_shader, "u_g_diffuse", GeometryBuffer::TextureType::DIFFUSE);
-	geometry_buffer.bind_texture(&point_light_shader, "u_g_normal", GeometryBuffer::TextureType::NORMAL);
+	geometry_buffer.bind_light_pass_textures(&point_light_shader);
 
-	glDrawElements(GL_TRIANGLES, indices_size, GL_UNSIGNED_INT, 0);
+	glDrawElementsInstanced(GL_TRIANGLES, sphere->num_indices, GL_UNSIGNED_INT, 0, num_lights);
 
 	//unbind all previous binding
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
 	point_light_shader.unbind();	
-
-	glCullFace(GL_BACK);
-	glDisable(GL_STENCIL_TEST);
-	glEnable(GL_DEPTH_TEST);
 }
 
-void Renderer::spot_light_pass(const Scene& scene, const SpotLight& spot_light)
+void Renderer::spot_light_pass(const Scene& scene, const SpotLight& spot_light, const SpotLightShadow& shadow, bool low_resolution)
 {
-	//fixme : duplicate from spot_light_shadow_pass, will get it out of this functions later
-	glm::vec3 direction = spot_light.orientation * glm::vec3(0, 0, 1);
-	glm::vec3 up = spot_light.orientation * glm::vec3(0, 1, 0);
-	glm::mat4 light_view_mat = glm::lookAt(spot_light.position, spot_light.position + direction, up);
-	glm::mat4 light_proj_mat = glm::perspective(2 * spot_light.angle, 1.0f, 0.01f, spot_light.cutoff);
-	glm::mat4 light_proj_view_mat = light_proj_mat * light_view_mat;
-
-	glDisable(GL_DEPTH_TEST);
-	
-	glEnable(GL_STENCIL_TEST);
-	glStencilFunc(GL_NOTEQUAL, 0, 0xFF);
-
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_FRONT); // if we are inside the light volume, if we cull back face, then we cant see the light
+	const glm::mat4& light_proj_view_mat = shadow.proj_view;
 
+	//depth, stencil and face culling are set up by begin_light_volume
 	glEnable(GL_BLEND);
 	glBlendEquation(GL_FUNC_ADD);
 	glBlendFunc(GL_ONE, GL_ONE);
 
+	//a light without a tile in the shadow atlas uses the variant without the shadow lookup
+	const Shader& spot_light_shader = get_local_light_shader(true, shadow.tile.size > 0, low_resolution);
 	spot_light_shader.bind();
 
-	size_t indices_size = cone->model->model->num_indices(cone->group_id) * sizeof(unsigned int);
 
 	//cone calculation is already calculated outside this function
-	//cone->world_mat = glm::scale(glm::mat4(), glm::vec3(spot_light.base_radius, spot_light.base_radius, spot_light.cutoff));
+	//cone->world_mat = glm::scale(glm::mat4(), glm::vec3(volume_radius, volume_radius, spot_light.cutoff));
 	//cone->world_mat = glm::toMat4(spot_light.orientation) * cone->world_mat;
 	//cone->world_mat = glm::translate(glm::mat4(), spot_light.position) * cone->world_mat;
 
@@ -821,6 +2376,26 @@ void Renderer::spot_light_pass(const Scene& scene, const SpotLight& spot_light)
 		glUniform1f(uni_light_correction, spot_light.correction);
 	}
 
+	//the shape of the light volume, the shader rejects pixels outside of it when there is no stencil
+	GLuint uni_light_direction = glGetUniformLocation(spot_light_shader.program, "u_light_direction");
+	if (uni_light_direction != -1)
+	{
+		glm::vec3 direction = spot_light.get_direction();
+		glUniform3f(uni_light_direction, direction.x, direction.y, direction.z);
+	}
+
+	GLuint uni_light_cutoff = glGetUniformLocation(spot_light_shader.program, "u_light_cutoff");
+	if (uni_light_cutoff != -1)
+	{
+		glUniform1f(uni_light_cutoff, spot_light.cutoff);
+	}
+
+	GLuint uni_light_cos_angle = glGetUniformLocation(spot_light_shader.program, "u_light_cos_angle");
+	if (uni_light_cos_angle != -1)
+	{
+		glUniform1f(uni_light_cos_angle, glm::cos(glm::radians(glm::min(spot_light.angle, max_spot_light_volume_angle))));
+	}
+
 	GLuint uni_light_pv = glGetUniformLocation(spot_light_shader.program, "u_light_pv");
 	if (uni_light_pv != -1)
 	{
@@ -832,70 +2407,94 @@ void Renderer::spot_light_pass(const Scene& scene, const SpotLight& spot_light)
 	{
 		const int active_texture_id = 5;
 		glActiveTexture(GL_TEXTURE0 + active_texture_id); // watch out, bind it to other than the first 4, because it is already being used by geometry buffer
-		glBindTexture(GL_TEXTURE_2D, shadow_map.get_shadow_texture_id());
+		glBindTexture(GL_TEXTURE_2D, shadow_atlas.get_shadow_map().get_shadow_texture_id());
 		glUniform1i(uni_shadow_map, active_texture_id);
 	}
 
+	GLuint uni_shadow_tile = glGetUniformLocation(spot_light_shader.program, "u_shadow_tile");
+	if (uni_shadow_tile != -1)
+	{
+		glm::vec4 tile_transform = shadow_atlas.get_tile_transform(shadow.tile);
+		glUniform4f(uni_shadow_tile, tile_transform.x, tile_transform.y, tile_transform.z, tile_transform.w);
+	}
+
 	//bind geometry buffers to be sampled
-	geometry_buffer.bind_texture(&spot_light_shader, "u_g_position", GeometryBuffer::TextureType::POSITION);
-	geometry_buffer.bind_texture(&spot_light_shader, "u_g_specular", GeometryBuffer::TextureType::SPECULAR);
-	geometry_buffer.bind_texture(&spot_light_shader, "u_g_diffuse", GeometryBuffer::TextureType::DIFFUSE);
-	geometry_buffer.bind_texture(&spot_light_shader, "u_g_normal", GeometryBuffer::TextureType::NORMAL);
+	geometry_buffer.bind_light_pass_textures(&spot_light_shader);
 
-	glDrawElements(GL_TRIANGLES, indices_size, GL_UNSIGNED_INT, 0);
+	glDrawElements(GL_TRIANGLES, cone->num_indices, GL_UNSIGNED_INT, 0);
 
 	//unbind all previous binding
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
 	spot_light_shader.unbind();
-
-	glCullFace(GL_BACK);
-	glDisable(GL_STENCIL_TEST);
-	glEnable(GL_DEPTH_TEST);
 }
 
 void Renderer::directional_light_shadow_pass(const Scene& scene)
 {
-	glDepthMask(GL_TRUE);
+	BEY_PROFILE_ZONE("sun shadow pass");
+	sun_shadow_map.update(scene.camera, scene.get_sunlight(), scene_bounding_box);
+
 	glEnable(GL_DEPTH_TEST);
 	glDisable(GL_STENCIL_TEST);
 
-	const DirectionalLight& sunlight = scene.get_sunlight();
+	//static casters are only drawn again when the sun changed or a cascade had to be refitted
+	if (sun_shadow_map.begin_static_pass())
+	{
+		const Shader& shadow_shader = sun_shadow_map.get_static_shadow_map().get_first_pass_shader();
+		for (int i = 0; i < sun_shadow_map.get_num_cascades(); i++)
+		{
+			if (!sun_shadow_map.is_static_dirty(i))
+			{
+				continue;
+			}
 
-	glm::vec3 center = glm::vec3((scene.bounding_box.min.x + scene.bounding_box.max.x) * 0.5f, (scene.bounding_box.min.y + scene.bounding_box.max.y) * 0.5f, (scene.bounding_box.min.z + scene.bounding_box.max.z) * 0.5f);
+			sun_shadow_map.bind_static_cascade(i);
+			sun_shadow_caster_pass(scene, shadow_shader, sun_shadow_map.get_proj_view(i), false);
+		}
+		sun_shadow_map.end_static_pass();
+	}
 
-	glm::mat4 light_projection = glm::ortho<float>(scene.bounding_box.min.x, scene.bounding_box.max.x, scene.bounding_box.min.y, scene.bounding_box.max.y, scene.bounding_box.min.z, scene.bounding_box.max.z);
-	glm::mat4 light_view = glm::lookAt(-sunlight.direction, center, glm::vec3(0, 1, 0));
-	glm::mat4 light_model = glm::mat4(1.0);
+	//dynamic casters are drawn every frame, on top of the static depth
+	if (sun_shadow_map.has_dynamic_layer())
+	{
+		const Shader& shadow_shader = sun_shadow_map.get_shadow_map().get_first_pass_shader();
+		sun_shadow_map.begin_shadow_pass();
+		for (int i = 0; i < sun_shadow_map.get_num_cascades(); i++)
+		{
+			sun_shadow_map.bind_cascade(i);
+			sun_shadow_caster_pass(scene, shadow_shader, sun_shadow_map.get_proj_view(i), true);
+		}
+		sun_shadow_map.end_shadow_pass();
+	}
+}
 
-	const Shader& shadow_shader = shadow_map.get_first_pass_shader();
+void Renderer::sun_shadow_caster_pass(const Scene& scene, const Shader& shadow_shader, const glm::mat4& light_proj_view_mat, bool dynamic)
+{
+	Frustum cascade_frustum(light_proj_view_mat);
+	bool positions_only = !sun_shadow_map.get_shadow_map().is_debug(); // the debug color needs the texture coordinates
 
 	RenderData* render_data = head;
 	while (render_data != nullptr)
 	{
-		const StaticModel& static_model = *(render_data->model);
-		const ObjModel::MeshGroup* mesh_group = render_data->model->model->get_mesh_group(render_data->group_id);
-		size_t indices_size = static_model.model->num_indices(render_data->group_id) * sizeof(unsigned int);
-
-		glBindBuffer(GL_ARRAY_BUFFER, render_data->vertices_id);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, render_data->indices_id);
+		//every cascade only draws the casters inside its own box
+		if (render_data->model->dynamic != dynamic || !cascade_frustum.intersect_box(render_data->bounding_box))
+		{
+			render_data = render_data->next;
+			continue;
+		}
 
 		//set shader's attributes and uniforms					
-		set_attributes(shadow_shader);
+		bind_vertices(shadow_shader, *render_data, positions_only);
 		set_uniforms(shadow_shader.program, *render_data, scene.camera); // u_proj_view_world will get replaced with the light_proj_view_mat
 
 		GLint uni_proj_view_world = glGetUniformLocation(shadow_shader.program, "u_proj_view_world");
 		if (uni_proj_view_world != -1)
 		{
-			glUniformMatrix4fv(uni_proj_view_world, 1, GL_FALSE, glm::value_ptr(light_projection * light_view * light_model * render_data->world_mat));
+			glUniformMatrix4fv(uni_proj_view_world, 1, GL_FALSE, glm::value_ptr(light_proj_view_mat * render_data->world_mat));
 		}
 
-		glDrawElements(GL_TRIANGLES, indices_size, GL_UNSIGNED_INT, 0);
-
-		//unbind all previous binding
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		glDrawElements(GL_TRIANGLES, render_data->num_indices, GL_UNSIGNED_INT, 0);
 
 		render_data = render_data->next;
 	}
@@ -904,32 +2503,22 @@ void Renderer::directional_light_shadow_pass(const Scene& scene)
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
-void Renderer::spot_light_shadow_pass(const Scene& scene, const SpotLight& spot_light)
+void Renderer::spot_light_shadow_pass(const Scene& scene, const glm::mat4& light_proj_view_mat)
 {
 	glDepthMask(GL_TRUE);
 	glEnable(GL_DEPTH_TEST);
 	glDisable(GL_STENCIL_TEST);
 
-	glm::vec3 direction = spot_light.orientation * glm::vec3(0, 0, 1);
-	glm::vec3 up = spot_light.orientation * glm::vec3(0, 1, 0);
-	glm::mat4 light_view_mat = glm::lookAt(spot_light.position, spot_light.position + direction, up);
-	glm::mat4 light_proj_mat = glm::perspective(2 * spot_light.angle, 1.0f, 0.01f, spot_light.cutoff);	
-	glm::mat4 light_proj_view_mat = light_proj_mat * light_view_mat;
-
-	const Shader& shadow_shader = shadow_map.get_first_pass_shader();
+	const Shader& shadow_shader = shadow_atlas.get_shadow_map().get_first_pass_shader();
+	bool positions_only = !shadow_atlas.get_shadow_map().is_debug(); // the debug color needs the texture coordinates
 
 	RenderData* render_data = head;
 	while (render_data != nullptr)
 	{
-		const StaticModel& static_model = *(render_data->model);
 		const ObjModel::MeshGroup* mesh_group = render_data->model->model->get_mesh_group(render_data->group_id);
-		size_t indices_size = static_model.model->num_indices(render_data->group_id) * sizeof(unsigned int);
-
-		glBindBuffer(GL_ARRAY_BUFFER, render_data->vertices_id);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, render_data->indices_id);
 
 		//set shader's attributes and uniforms					
-		set_attributes(shadow_shader);
+		bind_vertices(shadow_shader, *render_data, positions_only);
 		set_uniforms(shadow_shader.program, *render_data, scene.camera); // u_proj_view_world will get replaced with the light_proj_view_mat
 
 		GLint uni_proj_view_world = glGetUniformLocation(shadow_shader.program, "u_proj_view_world");
@@ -938,7 +2527,7 @@ void Renderer::spot_light_shadow_pass(const Scene& scene, const SpotLight& spot_
 			glUniformMatrix4fv(uni_proj_view_world, 1, GL_FALSE, glm::value_ptr(light_proj_view_mat * render_data->world_mat));
 		}
 
-		glDrawElements(GL_TRIANGLES, indices_size, GL_UNSIGNED_INT, 0);
+		glDrawElements(GL_TRIANGLES, render_data->num_indices, GL_UNSIGNED_INT, 0);
 
 		//unbind all previous binding
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -951,15 +2540,128 @@ void Renderer::spot_light_shadow_pass(const Scene& scene, const SpotLight& spot_
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
+void Renderer::spot_light_shadow_atlas_pass(const Scene& scene)
+{
+	BEY_PROFILE_ZONE("spot shadow pass");
+	size_t num_spot_lights = scene.num_spot_lights();
+	const SpotLight* spot_lights = scene.get_spot_lights();
+	const glm::mat4& proj_mat = scene.camera.get_projection_matrix();
+	Frustum frustum(proj_mat * scene.camera.get_view_matrix());
+	float tan_half_fov = 1.0f / proj_mat[1][1];
+
+	shadow_scheduler.begin_frame(num_spot_lights);
+
+	//lights that cover more of the screen get bigger tiles, lights outside the view frustum or without shadow get none
+	std::vector<ShadowScheduler::Candidate> candidates;
+	std::vector<int> requested_sizes(num_spot_lights, 0);
+	for (int i = 0; i < num_spot_lights; i++)
+	{
+		glm::vec3 center;
+		float radius;
+		spot_lights[i].calc_bounding_sphere(center, radius);
+		if (!spot_lights[i].casts_shadow || !frustum.intersect_sphere(center, radius))
+		{
+			continue;
+		}
+
+		ShadowScheduler::Candidate candidate;
+		candidate.light_index = i;
+		candidate.distance = glm::length(center - scene.camera.get_position());
+		candidate.screen_coverage = candidate.distance > radius ? glm::min(radius / (candidate.distance * tan_half_fov), 1.0f) : 1.0f;
+		candidate.proj_view = calc_spot_light_proj_view(spot_lights[i]);
+		candidate.num_triangles = num_shadow_caster_triangles;
+		candidates.push_back(candidate);
+
+		requested_sizes[i] = shadow_scheduler.stabilize_tile_size(i, shadow_atlas.calc_tile_size(candidate.screen_coverage));
+	}
+
+	std::vector<ShadowAtlas::Tile> tiles;
+	shadow_atlas.allocate_tiles(requested_sizes, tiles);
+	for (size_t i = 0; i < candidates.size(); i++)
+	{
+		candidates[i].tile = tiles[candidates[i].light_index];
+	}
+
+	//re-render the most important shadow maps until the budget runs out, the rest keep what their tile already holds
+	shadow_scheduler.schedule(candidates);
+
+	sf::Clock clock;
+	shadow_atlas.begin_shadow_pass();
+	for (size_t i = 0; i < candidates.size(); i++)
+	{
+		const ShadowScheduler::Candidate& candidate = candidates[i];
+		if (candidate.tile.size == 0)
+		{
+			continue;
+		}
+
+		if (!shadow_scheduler.is_mandatory(candidate) && !shadow_scheduler.has_budget_left(clock.getElapsedTime().asSeconds() * 1000.0f))
+		{
+			break;
+		}
+
+		begin_profile_section(GpuProfiler::Pass::SPOT_SHADOW, candidate.light_index);
+		shadow_atlas.bind_tile(candidate.tile);
+		spot_light_shadow_pass(scene, candidate.proj_view);
+		end_profile_section();
+		shadow_scheduler.mark_updated(candidate);
+	}
+	shadow_atlas.end_shadow_pass();
+
+	shadow_scheduler.end_frame(candidates);
+
+	spot_light_shadows.assign(num_spot_lights, SpotLightShadow());
+	for (size_t i = 0; i < candidates.size(); i++)
+	{
+		SpotLightShadow& shadow = spot_light_shadows[candidates[i].light_index];
+		shadow.tile = candidates[i].tile;
+		shadow.proj_view = shadow_scheduler.get_shadow_proj_view(candidates[i].light_index);
+	}
+}
+
+void Renderer::set_shadow_budget(const ShadowScheduler::Budget& budget)
+{
+	shadow_scheduler.set_budget(budget);
+}
+
+const ShadowScheduler& Renderer::get_shadow_scheduler() const
+{
+	return shadow_scheduler;
+}
+
 void Renderer::release()
 {
 }
 
+void Renderer::print_shadow_memory() const
+{
+	//memory of the shadow maps, and what a depth only framebuffer saves compared to the debug color attachment.
+	//the debug attachment costs the same amount of memory and of writes on every shadow update, plus one diffuse texture fetch per fragment
+	const ShadowMap* shadow_maps[] = { &sun_shadow_map.get_static_shadow_map(), &shadow_atlas.get_shadow_map(), &sun_shadow_map.get_shadow_map() };
+	const char* names[] = { "sun cascades", "spot light atlas", "sun cascades dynamic layer" };
+	int num_shadow_maps = sun_shadow_map.has_dynamic_layer() ? 3 : 2;
+	for (int i = 0; i < num_shadow_maps; i++)
+	{
+		const ShadowMap& shadow_map = *shadow_maps[i];
+		std::cout << "shadow map (" << names[i] << ") : " << shadow_map.get_width() << "x" << shadow_map.get_height() << " "
+			<< ShadowMap::get_depth_format_name(shadow_map.get_depth_format()) << (shadow_map.is_debug() ? " + debug color" : "")
+			<< ", " << shadow_map.get_memory_size() / (1024.0f * 1024.0f) << " MB" << std::endl;
+	}
+
+	//a light rendered into the biggest atlas tile
+	size_t tile_texels = (size_t)shadow_atlas_max_tile_size * shadow_atlas_max_tile_size;
+	const ShadowMap& atlas_map = shadow_atlas.get_shadow_map();
+	std::cout << "shadow map per light (" << shadow_atlas_max_tile_size << "x" << shadow_atlas_max_tile_size << " tile) : depth "
+		<< tile_texels * ShadowMap::get_bytes_per_texel(atlas_map.get_depth_format()) / (1024.0f * 1024.0f) << " MB, depth only saves "
+		<< tile_texels * ShadowMap::debug_color_bytes_per_texel / (1024.0f * 1024.0f) << " MB of memory and of writes per update" << std::endl;
+}
+
 void Renderer::render_shadow_map(const Scene& scene)
 {
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+	const ShadowMap& shadow_map = sun_shadow_map.get_shadow_map();
 	const Shader& shadow_second_pass = shadow_map.get_second_pass_shader();
 
 	shadow_map.bind_second_pass();
@@ -984,6 +2686,12 @@ void Renderer::render_shadow_map(const Scene& scene)
 
 void Renderer::update(float frameTime, Scene& scene)
 {
+	BEY_PROFILE_ZONE("renderer update");
+	update_quality(scene);
+
+	//the next frame is rendered with the next offset of the sequence, after the render size the governor may have just changed
+	scene.camera.set_jitter(temporal_upscaling ? temporal_upscaler.next_jitter(screen_width, screen_height) : glm::vec2(0.0f));
+
 	static const float speed = 10;
 	static float t = 0;
 	static bool dir = true;
@@ -1001,26 +2709,33 @@ void Renderer::update(float frameTime, Scene& scene)
 			dir = !dir;
 	}
 
+	//the lights are only taken for writing when one of them moves, so a still scene keeps its light revision
 	size_t num_point_lights = scene.num_point_lights();
-	PointLight* point_lights = scene.get_mutable_point_lights();
-
-	for (int i = 0; i < num_point_lights; i++)
+	if (has_moving_point_lights(scene))
 	{
-		if (point_lights[i].velocity != 0)
+		PointLight* point_lights = scene.get_mutable_point_lights();
+
+		for (int i = 0; i < num_point_lights; i++)
 		{
-			// this light is moving	randomly around x-z		
-			point_lights[i].position.z += point_lights[i].velocity * frameTime * speed;					
+			if (point_lights[i].velocity != 0)
+			{
+				// this light is moving	randomly around x-z		
+				point_lights[i].position.z += point_lights[i].velocity * frameTime * speed;					
+			}
 		}
 	}
 
 	size_t num_spot_lights = scene.num_spot_lights();
-	SpotLight* spot_lights = scene.get_mutable_spot_lights();
-
-	for (int i = 0; i < num_spot_lights; i++)
+	if (has_slerping_spot_lights(scene))
 	{
-		if (spot_lights[i].is_slerping)
+		SpotLight* spot_lights = scene.get_mutable_spot_lights();
+
+		for (int i = 0; i < num_spot_lights; i++)
 		{
-			spot_lights[i].orientation = glm::slerp(spot_lights[i].from, spot_lights[i].to, t);
+			if (spot_lights[i].is_slerping)
+			{
+				spot_lights[i].orientation = glm::slerp(spot_lights[i].from, spot_lights[i].to, t);
+			}
 		}
 	}
 }
\ No newline at end of file
@@ -6,6 +6,16 @@
 #include "renderer/RendererInitData.hpp"
 #include "renderer/GeometryBuffer.hpp"
 #include "renderer/ShadowMap.hpp"
+#include "renderer/CascadedShadowMap.hpp"
+#include "renderer/ShadowAtlas.hpp"
+#include "renderer/ShadowScheduler.hpp"
+#include "renderer/ClusteredLighting.hpp"
+#include "renderer/TextureBuffer.hpp"
+#include "renderer/VisibilityBuffer.hpp"
+#include "renderer/LowResolutionLightBuffer.hpp"
+#include "renderer/QualityGovernor.hpp"
+#include "renderer/TemporalUpscaler.hpp"
+#include "renderer/GpuProfiler.hpp"
 #include "scene/scene.hpp"
 #include <vector>
 #include <GL/glew.h>
@@ -15,19 +25,106 @@ namespace bey
 	struct RenderData
 	{
 		GLuint vertices_id;
+		GLuint positions_id; // the positions of vertices_id alone, tightly packed, for the passes that only need depth
 		GLuint indices_id;
 		const StaticModel* model;
 		GLuint diffuse_texture_id;
 		const ObjModel::ObjMtl* material;
 		glm::mat4x4 world_mat;
 		int group_id; // every vertices in a group is guaranteed to have the same material id
+		GLuint visibility_id; // draw id in the visibility buffer, 0 when the draw is not in it
+		size_t num_indices;
 		BoundingBox bounding_box; // in world position
 		RenderData* next;		
 
-		RenderData() : vertices_id(0), indices_id(0), model(nullptr), group_id(-1), next(nullptr) {}
+		RenderData() : vertices_id(0), positions_id(0), indices_id(0), model(nullptr), group_id(-1), visibility_id(0), num_indices(0), next(nullptr) {}
+	};
+
+	// where a spot light's shadow lives for the current frame
+	struct SpotLightShadow
+	{
+		ShadowAtlas::Tile tile;
+		glm::mat4 proj_view; // the matrix the tile was rendered with. it lags behind the light while the light's updates are deferred
 	};
 
 	class Renderer {
+	public:
+		// how the geometry buffer is filled
+		enum class GeometryPath
+		{
+			GEOMETRY_BUFFER = 0, // every draw writes all the targets of the geometry buffer
+			VISIBILITY_BUFFER, // every draw only writes depth and a triangle id, the targets are then resolved from the ids, see VisibilityBuffer
+		};
+
+		// how point and spot lights are shaded
+		enum class LightPath
+		{
+			STENCIL = 0, // one stencil volume and one light volume draw per light
+			CLUSTERED, // lights are binned into view frustum clusters, one full screen pass shades all of them
+		};
+
+		// how a light volume is drawn in the stencil light path. every drawn volume is limited to its scissor rectangle
+		enum class LightVolumeMode
+		{
+			CULLED = 0, // outside the view frustum, not drawn at all
+			INSIDE, // the camera is inside the volume, its back faces are drawn with a depth test and without stencil
+			SCISSOR, // small on screen, its back faces are drawn without stencil
+			STENCIL, // stencil pass, then the light volume
+		};
+
+		// a point or spot light that survived culling in the stencil light path
+		struct LightVolume
+		{
+			const PointLight* point_light; // null for a spot light
+			const SpotLight* spot_light;
+			int point_light_index; // in the point light buffer
+			int spot_light_index;
+			LightVolumeMode mode;
+			glm::ivec4 scissor_rect; // in the pixels of the buffer the light is drawn into
+			bool low_resolution; // drawn into the low resolution light buffer
+
+			LightVolume() : point_light(nullptr), spot_light(nullptr), point_light_index(-1), spot_light_index(-1), mode(LightVolumeMode::CULLED), low_resolution(false) {}
+		};
+
+		// light volumes of the last frame in each mode
+		struct LightVolumeStats
+		{
+			int num_culled;
+			int num_inside;
+			int num_scissor;
+			int num_stencil;
+			int num_stencil_clears;
+
+			LightVolumeStats() : num_culled(0), num_inside(0), num_scissor(0), num_stencil(0), num_stencil_clears(0) {}
+		};
+
+		// fragments written to the geometry buffer by the last geometry pass that was measured
+		struct GeometryPassStats
+		{
+			GLuint num_samples;
+			float overdraw; // samples per screen pixel
+
+			GeometryPassStats() : num_samples(0), overdraw(0.0f) {}
+		};
+
+		// how much of a frame render has to redo, from what changed since the last frame
+		enum class FrameUpdate
+		{
+			FULL = 0, // the camera moved, or something that invalidated the geometry buffer changed
+			LIGHTS_ONLY, // only the lights changed, the geometry buffer and the sun shadow are reused
+			IDLE, // nothing changed, the last frame is shown again
+		};
+
+		// frames of each kind since the renderer was initialized
+		struct FrameUpdateStats
+		{
+			int num_full;
+			int num_lights_only;
+			int num_idle;
+
+			FrameUpdateStats() : num_full(0), num_lights_only(0), num_idle(0) {}
+		};
+
 	private:
 
 		std::vector< std::vector< RenderData> > render_datas; // each model and each group has its own render_data
@@ -35,14 +132,62 @@ namespace bey
 		std::unordered_map<std::string, GLuint> texture_ids;
 		RenderData* head;
 		GeometryBuffer geometry_buffer;
-		ShadowMap shadow_map;
+		CascadedShadowMap sun_shadow_map;
+		BoundingBox scene_bounding_box; // union of the bounding boxes of all models, in world position
+		ShadowAtlas shadow_atlas; // shadow maps of all the spot lights
+		ShadowScheduler shadow_scheduler; // picks which spot light shadows are re-rendered each frame
+		std::vector<SpotLightShadow> spot_light_shadows; // one for each spot light
+		size_t num_shadow_caster_triangles;
 		Shader directional_light_shader;
-		Shader point_light_shader;
-		Shader spot_light_shader;
+		ShaderVariants local_light_shaders; // point and spot lights, see get_local_light_shader
+		int spot_shadow_pcf_size;
 		Shader stencil_shader;		
+		Shader depth_pre_pass_shader; // geometry_pass.vs with a depth only fragment shader
+		ShaderVariants clustered_light_shaders; // see get_clustered_light_shader
+		ClusteredLighting clustered_lighting;
+		TextureBuffer point_light_buffer; // position, color and attenuation of the point lights drawn this frame
+		std::vector<glm::vec4> point_light_data;
+		LightPath light_path;
+		LightVolumeStats light_volume_stats;
+		int stencil_batch_size; // lights marked in the stencil buffer between two clears
+		std::vector<const RenderData*> geometry_queue; // draw order of the geometry pass
+		bool depth_pre_pass;
+		bool sort_front_to_back;
+		GLuint geometry_samples_query;
+		bool geometry_samples_query_pending;
+		GeometryPassStats geometry_pass_stats;
+		GeometryPath geometry_path;
+		VisibilityBuffer visibility_buffer;
+		Shader visibility_shader; // geometry_pass.vs with the triangle id fragment shader
+		Shader visibility_resolve_shader;
+		int light_resolution_scale;
+		LowResolutionLightBuffer low_resolution_light_buffer;
+		Shader light_downsample_shader; // depth of the low resolution light buffer
+		Shader light_upsample_shader; // low resolution light buffer into the light accumulation
 
-		int screen_width;
+		bool temporal_upscaling;
+		TemporalUpscaler temporal_upscaler;
+		Shader temporal_upscale_shader;
+		QualityGovernor quality_governor;
+		int quality_level; // the governor's level the renderer and the scene are set to
+		GLuint frame_time_query;
+		bool frame_time_query_pending;
+		bool idle_frame_skipping;
+		bool frame_invalid; // the next frame is rendered in full, whatever changed
+		glm::mat4 last_view_mat; // of the camera the last rendered frame was rendered with
+		glm::mat4 last_proj_mat; // unjittered
+		unsigned int last_light_revision;
+		unsigned int last_model_revision; // of the scene the render data's transforms were taken from
+		int num_converging_frames; // frames the temporal upscaler's history has accumulated since the last change
+		FrameUpdateStats frame_update_stats;
+		GpuProfiler gpu_profiler;
+		int num_profiled_frames; // the profiler's frames the quality governor has been fed
+
+		int screen_width; // of the geometry buffer, every pass before show_final_render draws at this size
 		int screen_height;
+		int window_width;
+		int window_height;
+		float render_scale; // screen size / window size
 
 		RenderData* quad;
 		RenderData* sphere;
@@ -52,13 +197,19 @@ namespace bey
 
 		// You may want to build some scene-specific OpenGL data before the first frame
 		bool initialize(const Scene& scene, const RendererInitData& data);
-		void initialize_primitives();
+		void initialize_primitives(const RendererInitData& data);
 		void initialize_shaders();
+		bool has_dynamic_models(const Scene& scene) const;
 		void initialize_static_models(const StaticModel* static_models, size_t num_static_models);
+		// moves the dynamic models to where the scene has them, when its model revision changed since the last frame
+		void update_dynamic_models(const Scene& scene);
 		void initialize_material(const StaticModel& static_model, int group_index, RenderData& render_data);
 
 		//general shader
 		void set_attributes(const Shader& shader);
+		void set_position_attribute(const Shader& shader); // for positions_id, the other attributes are disabled
+		// binds the vertex and index buffers of render_data, either the whole vertices or only the positions
+		void bind_vertices(const Shader& shader, const RenderData& render_data, bool positions_only);
 		void set_uniforms(GLuint shader_program, const RenderData& render_data, const Camera& camera);
 
 		/*
@@ -67,27 +218,135 @@ namespace bey
 		 * This function should not modify the scene or camera.
 		 */
 		void render(const Camera& camera, const Scene& scene);		
+		void build_geometry_queue(const Camera& camera);
+		void draw_geometry_queue(const Scene& scene, const Shader& shader, bool positions_only);
 		void geometry_pass(const Scene& scene);
+		void visibility_pass(const Scene& scene); // depth and triangle ids of the geometry queue
+		void visibility_resolve_pass(const Scene& scene); // the geometry buffer's targets from the triangle ids, one scissored quad per draw
 		void begin_light_pass(const Scene& scene);
 		void end_light_pass(const Scene& scene);
-		void stencil_pass(const Scene& scene, const RenderData& render_data);
+		void stencil_pass(const Scene& scene, const RenderData& render_data, GLuint stencil_bit);
 		void directional_light_pass(const Scene& scene);		
-		void point_light_pass(const Scene& scene, const PointLight& point_light);
-		void spot_light_pass(const Scene& scene, const SpotLight& spot_light);
+		void set_sun_light_uniforms(const Shader& shader, const Scene& scene); // direction, color and shadow cascades of the sun
+		ShaderDefines get_local_light_defines(bool spot_light, bool shadows, bool low_resolution) const;
+		// the variant with only the features the light uses
+		const Shader& get_local_light_shader(bool spot_light, bool shadows, bool low_resolution);
+		ShaderDefines get_clustered_light_defines(bool low_resolution) const;
+		const Shader& get_clustered_light_shader(bool low_resolution);
+		// lights of the point light buffer, as instances of the sphere
+		void point_light_pass(const Scene& scene, int first_light, int num_lights, bool low_resolution);
+		void spot_light_pass(const Scene& scene, const SpotLight& spot_light, const SpotLightShadow& shadow, bool low_resolution);
+		// point and spot lights into the light accumulation, then the low resolution ones into their own buffer when the scale is above 1
+		void local_light_pass(const Scene& scene);
+		// every visible point and spot light through its light pass, with stencil_pass when needed. when lights are split by resolution,
+		// only the ones that match low_resolution
+		void stencil_light_pass(const Scene& scene, bool low_resolution);
+		// depth of the low resolution light buffer, its lights, and the upsample into the light accumulation
+		void low_resolution_light_pass(const Scene& scene);
+		// a pass of the gpu profiler and of the gl call counts
+		void begin_profile_section(GpuProfiler::Pass pass, int light_index = -1);
+		void end_profile_section();
+		// the profiler's section of the light's stencil pass or light pass, point_lights is the scene's
+		void begin_light_volume_profile(const LightVolume& volume, const PointLight* point_lights, bool stencil);
+		LightVolumeMode classify_light_volume(bool camera_inside, const glm::ivec4& scissor_rect) const;
+		void count_light_volume(LightVolumeMode mode);
+		// screen rectangles (x, y, width, height) of light volumes, empty when the volume is behind the camera
+		glm::ivec4 calc_sphere_scissor_rect(const Camera& camera, const glm::vec3& center, float radius) const;
+		glm::ivec4 calc_cone_scissor_rect(const Camera& camera, const SpotLight& spot_light) const;
+		void begin_light_volume(const LightVolume& volume, GLuint stencil_bit);
+		// restores what begin_light_volume set, the same for every volume
+		void end_light_volume();
+		RenderData* set_light_volume_transform(const LightVolume& volume); // places the sphere or the cone on the light
+		void light_volume_pass(const Scene& scene, const LightVolume& volume);
+		void pack_point_light(const PointLight& point_light);
+		void clustered_light_pass(const Scene& scene, bool low_resolution);
+
+		// depth only pass before the geometry pass, which then only shades the visible fragments
+		void set_depth_pre_pass(bool depth_pre_pass);
+		bool get_depth_pre_pass() const;
+		// the geometry pass draws the closest models first, so the depth test rejects more of the hidden fragments
+		void set_sort_front_to_back(bool sort_front_to_back);
+		bool get_sort_front_to_back() const;
+		const GeometryPassStats& get_geometry_pass_stats() const;
+		// 1 shades every local light at full resolution. 2 or 4 shades the lights flagged low_resolution at half or quarter resolution,
+		// and upsamples them with their depth and normal
+		void set_light_resolution_scale(int scale);
+		int get_light_resolution_scale() const;
+		// times num_frames local light passes at full resolution and at the current scale, and prints them with the rmse of the final
+		// light accumulation against full resolution
+		void compare_light_resolution(const Scene& scene, int num_frames);
+		// the visibility buffer path is only available when every static draw fits in it, see VisibilityBuffer::is_complete
+		void set_geometry_path(GeometryPath geometry_path);
+		GeometryPath get_geometry_path() const;
+		// renders num_frames frames with each geometry path and prints the average time of the geometry pass alone and of the whole frame.
+		// every timed section is ended with glFinish, the current path is restored afterwards
+		void benchmark_geometry_paths(const Scene& scene, int num_frames);
+		// the sun is lit by the geometry pass instead of a full screen pass that reads the geometry buffer again
+		void set_fused_sun_light(bool fused_sun_light);
+		bool get_fused_sun_light() const;
+		void set_light_path(LightPath light_path);
+		LightPath get_light_path() const;
+		const LightVolumeStats& get_light_volume_stats() const;
+		// 1 clears the stencil buffer for every light, up to 8 lights share a clear
+		void set_stencil_batch_size(int batch_size);
+		int get_stencil_batch_size() const;
 		void render_model(const Camera& camera, const Scene& scene, const RenderData& render_data, const Shader& shader);				
+		// upscales the light accumulation to the window, with temporal_upscale_pass or a plain blit
 		void show_final_render(const Scene& scene);
+		// resolves this frame into the temporal upscaler's history and shows it
+		void temporal_upscale_pass(const Scene& scene);
+		// every frame is rendered with a different sub-pixel jitter, and accumulated at the window's resolution. it works best with a
+		// render scale under 1, see TemporalUpscaler
+		void set_temporal_upscaling(bool temporal_upscaling);
+		bool get_temporal_upscaling() const;
+
+		// compares the camera and the scene's light revision with the last frame's, and decides how much of the frame is rendered
+		FrameUpdate calc_frame_update(const Camera& camera, const Scene& scene);
+		// render skips the geometry pass when only the lights changed, and everything but the final blit when nothing changed
+		void set_idle_frame_skipping(bool idle_frame_skipping);
+		bool get_idle_frame_skipping() const;
+		// the next frame is rendered in full. for any change render cannot see in the camera or the lights
+		void invalidate_frame();
+		const FrameUpdateStats& get_frame_update_stats() const;
+		// times every pass and every light while it is enabled, every frame is then rendered in full. the governor's frame query can not overlap the profiler's,
+		// the governor is fed the profiler's frames instead. the point lights that are usually drawn in one instanced draw
+		// are drawn one by one, so each of them gets its own time
+		GpuProfiler& get_gpu_profiler();
+		const GpuProfiler& get_gpu_profiler() const;
+
+		// the window's new size, the geometry buffer follows it at the render scale
+		void resize(int window_width, int window_height);
+		// the geometry buffer is rendered at scale x the window size, and stretched over the window by show_final_render
+		void set_render_scale(float render_scale);
+		float get_render_scale() const;
+		void resize_render_targets();
+		// a target frame time in milliseconds lets the quality governor trade the render scale, the shadow resolution, the light cutoffs
+		// and the shadow budget for gpu time. 0 turns it off and restores the full quality
+		void set_target_frame_time(float milliseconds);
+		float get_target_frame_time() const;
+		const QualityGovernor& get_quality_governor() const;
+		// reads back the gpu frame time when it is available, and applies the level the governor picks from it
+		void update_quality(Scene& scene);
+		void apply_quality_level(Scene& scene);
 
 		void render_all_models(const Camera& camera, const Scene& scene);
 
 		//shadow passes
 		void directional_light_shadow_pass(const Scene& scene);
-		void spot_light_shadow_pass(const Scene& scene, const SpotLight& spot_light);
+		void sun_shadow_caster_pass(const Scene& scene, const Shader& shadow_shader, const glm::mat4& light_proj_view_mat, bool dynamic);
+		void spot_light_shadow_pass(const Scene& scene, const glm::mat4& light_proj_view_mat);
+		void spot_light_shadow_atlas_pass(const Scene& scene);
+
+		void set_shadow_budget(const ShadowScheduler::Budget& budget);
+		const ShadowScheduler& get_shadow_scheduler() const;
 
 		void render_shadow_map(const Scene& scene);
+		void print_shadow_memory() const;
 
 		RenderData* create_quad();
-		RenderData* create_sphere();
-		RenderData* create_cone();
+		RenderData* create_mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
+		RenderData* create_sphere(int subdivisions); // icosphere around the unit sphere
+		RenderData* create_cone(int segments); // cone around the round cone with its tip at the origin and a cap of radius 1 at z = 1
 
 		// release all OpenGL data and allocated memory
 		// you can do this in the destructor instead, but a callable function lets you swap scenes at runtime
@@ -1,4 +1,5 @@
 #include "objmodel.hpp"
+#include "util/CpuProfiler.hpp"
 #include <SFML/System/Err.hpp>
 #include <fstream>
 #include <limits>
@@ -13,6 +14,7 @@ using namespace bey;
 // private helper function - reads a .mtl file and adds to the material table
 bool ObjModel::loadMTL( std::string path, std::string filename )
 {
+	BEY_PROFILE_ZONE("mtl load");
 	std::string token;
 	std::string mat_name;
 	std::ifstream istream( path + filename );
@@ -85,6 +87,7 @@ bool ObjModel::loadMTL( std::string path, std::string filename )
 			// load only one copy of each texture
 			if ( textureIDs.count( token ) == 0 )
 			{
+				BEY_PROFILE_ZONE("texture decode");
 				textures.push_back( sf::Image() );
 				if ( !textures.back().loadFromFile( path + token ) )
 				{
@@ -104,6 +107,7 @@ bool ObjModel::loadMTL( std::string path, std::string filename )
 			istream >> token;
 			if ( textureIDs.count( token ) == 0 )
 			{
+				BEY_PROFILE_ZONE("texture decode");
 				textures.push_back( sf::Image( ) );
 				if ( !textures.back( ).loadFromFile( path + token ) )
 				{
@@ -204,6 +208,7 @@ void compute_normals(Vertex* vertices, size_t num_vertices, std::vector<ObjModel
  */
 bool ObjModel::loadFromFile( std::string path, std::string filename )
 {
+	BEY_PROFILE_ZONE("obj load");
 	int total_triangles_count = 0;
 	has_normal = true; // assume first that we have normal
 	name = filename;
@@ -233,6 +238,7 @@ bool ObjModel::loadFromFile( std::string path, std::string filename )
 	static const char* scan_vertex_normal = "%d//%d";
 	static const char* scan_vertex_uv_normal = "%d/%d/%d";
 
+	BEY_PROFILE_ZONE_NAMED(parse_zone, "obj parse");
 	while ( istream.good() && (istream.peek() != EOF) )
 	{
 		istream >> token;
@@ -454,6 +460,7 @@ bool ObjModel::loadFromFile( std::string path, std::string filename )
 		total_triangles_count += group.triangles.size();
 		group.triangles.clear();
 	}
+	BEY_PROFILE_ZONE_END(parse_zone);
 	
 	if ( istream.fail() && !istream.eof() )
 	{
@@ -462,6 +469,7 @@ bool ObjModel::loadFromFile( std::string path, std::string filename )
 	}
 
 	//start turning it into a more renderer-friendly data structure
+	BEY_PROFILE_ZONE("obj weld");
 	typedef std::map< TriangleIndex, unsigned int > VertexMap;
 	unsigned int vertex_last_idx = 0;
 	VertexMap vertex_map;
@@ -1,4 +1,5 @@
 #include "scene.hpp"
+#include "util/CpuProfiler.hpp"
 #include "glm/gtc/quaternion.hpp"
 #include <SFML/System/Err.hpp>
 #include <fstream>
@@ -15,12 +16,13 @@ using namespace bey;
  */
 #define SKIP_THRU_CHAR( s , x ) if ( s.good() ) s.ignore( std::numeric_limits<std::streamsize>::max(), x )
 
-Scene::Scene()
+Scene::Scene() : light_cutoff_threshold(PointLight::default_cutoff_threshold), light_revision(0), model_revision(0)
 {
 }
 
 bool Scene::loadFromFile( std::string filename )
 {
+	BEY_PROFILE_ZONE("scene load");
 	std::string path;
 	size_t pathlen = filename.find_last_of( "\\/", filename.npos );
 	if ( pathlen < filename.npos )
@@ -140,6 +142,18 @@ bool Scene::loadFromFile( std::string filename )
 				{
 					istream >> spotlight.correction;
 				}
+				else if (token == "shadow")
+				{
+					int casts_shadow;
+					istream >> casts_shadow;
+					spotlight.casts_shadow = casts_shadow != 0;
+				}
+				else if (token == "low_resolution")
+				{
+					int low_resolution;
+					istream >> low_resolution;
+					spotlight.low_resolution = low_resolution != 0;
+				}
 				else if (token == "slerp")
 				{
 					float a, x, y, z;
@@ -162,7 +176,7 @@ bool Scene::loadFromFile( std::string filename )
 			}
 
 			//calculate the cutoff radius
-			spotlight.cutoff = PointLight::calc_bounding_sphere_scale(spotlight.Kc, spotlight.Kl, spotlight.Kq, spotlight.color);
+			spotlight.cutoff = PointLight::calc_bounding_sphere_scale(spotlight.Kc, spotlight.Kl, spotlight.Kq, spotlight.color, light_cutoff_threshold);
 			spotlight.base_radius = spotlight.cutoff * glm::sin(glm::radians(spotlight.angle));
 			spotlights.push_back( spotlight );
 			SKIP_THRU_CHAR( istream, '\n' );			
@@ -207,11 +221,17 @@ bool Scene::loadFromFile( std::string filename )
 					istream >> pointlight.Kl;
 					istream >> pointlight.Kq;
 				}
+				else if ( token == "low_resolution" )
+				{
+					int low_resolution;
+					istream >> low_resolution;
+					pointlight.low_resolution = low_resolution != 0;
+				}
 				SKIP_THRU_CHAR( istream, '\n' );
 			}
 
 			//calculate the cutoff radius
-			pointlight.cutoff = PointLight::calc_bounding_sphere_scale(pointlight.Kc, pointlight.Kl, pointlight.Kq, pointlight.color);
+			pointlight.cutoff = PointLight::calc_bounding_sphere_scale(pointlight.Kc, pointlight.Kl, pointlight.Kq, pointlight.color, light_cutoff_threshold);
 
 			pointlights.push_back( pointlight );
 			SKIP_THRU_CHAR( istream, '\n' );
@@ -251,6 +271,12 @@ bool Scene::loadFromFile( std::string filename )
 					istream >> z;
 					model.scale = glm::vec3( x, y, z );
 				}
+				else if ( token == "dynamic" )
+				{
+					int dynamic;
+					istream >> dynamic;
+					model.dynamic = dynamic != 0;
+				}
 				else if ( token == "file" )
 				{
 					SKIP_THRU_CHAR( istream, '\"' );
@@ -367,11 +393,24 @@ const StaticModel* Scene::get_static_models() const
 	return &(models[0]);	
 }
 
+StaticModel* Scene::get_mutable_static_models()
+{
+	model_revision++;
+	if (models.size() == 0)
+		return nullptr;
+	return &(models[0]);
+}
+
 size_t Scene::num_static_models() const
 {
 	return models.size();
 }
 
+unsigned int Scene::get_model_revision() const
+{
+	return model_revision;
+}
+
 const DirectionalLight& Scene::get_sunlight() const
 {
 	return sunlight;
@@ -386,6 +425,7 @@ const PointLight* Scene::get_point_lights() const
 
 PointLight* Scene::get_mutable_point_lights()
 {
+	light_revision++;
 	if (pointlights.size() == 0)
 		return nullptr;
 	return &pointlights[0];
@@ -405,6 +445,7 @@ const SpotLight* Scene::get_spot_lights() const
 
 SpotLight* Scene::get_mutable_spot_lights()
 {
+	light_revision++;
 	if (spotlights.size() == 0)
 		return nullptr;
 	return &spotlights[0];
@@ -415,23 +456,85 @@ size_t Scene::num_spot_lights() const
 	return spotlights.size();
 }
 
+void Scene::set_light_cutoff_threshold(float threshold)
+{
+	light_cutoff_threshold = threshold;
+	light_revision++;
+	for (size_t i = 0; i < spotlights.size(); i++)
+	{
+		SpotLight& spotlight = spotlights[i];
+		spotlight.cutoff = PointLight::calc_bounding_sphere_scale(spotlight.Kc, spotlight.Kl, spotlight.Kq, spotlight.color, threshold);
+		spotlight.base_radius = spotlight.cutoff * glm::sin(glm::radians(spotlight.angle));
+	}
+
+	for (size_t i = 0; i < pointlights.size(); i++)
+	{
+		PointLight& pointlight = pointlights[i];
+		pointlight.cutoff = PointLight::calc_bounding_sphere_scale(pointlight.Kc, pointlight.Kl, pointlight.Kq, pointlight.color, threshold);
+	}
+}
+
+float Scene::get_light_cutoff_threshold() const
+{
+	return light_cutoff_threshold;
+}
+
+unsigned int Scene::get_light_revision() const
+{
+	return light_revision;
+}
+
+
+const float PointLight::default_cutoff_threshold = 1.0f / 256.0f;
 
-float PointLight::calc_bounding_sphere_scale(float Kc, float Kl, float Kq, const glm::vec3& color)
+float PointLight::calc_bounding_sphere_scale(float Kc, float Kl, float Kq, const glm::vec3& color, float threshold)
 {
 	float max_channel = fmax(fmax(color.x, color.y), color.z);
+	float max_attenuation = max_channel / threshold;
 
 	if (Kq <= 0)
 	{
-		return (256 * max_channel - Kc) / Kl;
+		return (max_attenuation - Kc) / Kl;
 	}
 
 	//quadratic equation solution
-	float ret = (-Kl + sqrtf((Kl * Kl) - (4 * Kq * (Kc - 256 * max_channel))))
+	float ret = (-Kl + sqrtf((Kl * Kl) - (4 * Kq * (Kc - max_attenuation))))
 		/
 		(2 * Kq);
 	return ret;
 }
 
+glm::vec3 SpotLight::get_direction() const
+{
+	return orientation * glm::vec3(0, 0, 1);
+}
+
+void SpotLight::calc_bounding_sphere(glm::vec3& center, float& radius) const
+{
+	glm::vec3 direction = get_direction();
+
+	if (angle >= 90.0f)
+	{
+		center = position;
+		radius = cutoff;
+		return;
+	}
+
+	float angle_radians = glm::radians(angle);
+	if (angle <= 45.0f)
+	{
+		// sphere going through the light position and the rim of the cone's cap
+		radius = cutoff / (2.0f * glm::cos(angle_radians));
+		center = position + direction * radius;
+	}
+	else
+	{
+		// sphere around the rim of the cone's cap, the light position is already inside it
+		radius = cutoff * glm::sin(angle_radians);
+		center = position + direction * (cutoff * glm::cos(angle_radians));
+	}
+}
+
 BoundingBox StaticModel::get_bounding_box() const
 {
 	BoundingBox ret;
@@ -27,7 +27,11 @@ namespace bey
 		// you may want to change this when you build meshes
 		const ObjModel * model;
 
-		StaticModel() : scale(1.0, 1.0, 1.0)
+		// the model may move. the renderer follows the position, orientation and scale of dynamic models when they change, see
+		// Scene::get_mutable_static_models, and redraws them into the sun shadow every frame. the others are placed once and cached
+		bool dynamic;
+
+		StaticModel() : scale(1.0, 1.0, 1.0), dynamic(false)
 		{
 		}
 
@@ -52,6 +56,8 @@ namespace bey
 		float Kc, Kl, Kq; // attenuation constants
 		float cutoff;
 		float correction;
+		bool casts_shadow; // lights without a shadow skip the shadow atlas and the shadow lookup
+		bool low_resolution; // a soft light the scene lets be shaded at a lower resolution, see Renderer::set_light_resolution_scale
 
 		//animation
 		glm::quat from;
@@ -66,9 +72,15 @@ namespace bey
 			base_radius(0.0f),
 			Kc(0.0f), Kl(0.0f), Kq(0.0f), 
 			correction(1.0f), 
+			casts_shadow(true),
+			low_resolution(false),
 			is_slerping(false)
 		{
 		};
+
+		glm::vec3 get_direction() const;
+		// smallest sphere around the lit volume (the part of the cone within cutoff distance from the light)
+		void calc_bounding_sphere(glm::vec3& center, float& radius) const;
 	};
 
 	struct PointLight
@@ -80,8 +92,14 @@ namespace bey
 		float Kl; // linear component of attenuation
 		float Kq; // quadrat component of attenuation
 		float cutoff; // calculate this only once based on the attenuation values
+		bool low_resolution; // a soft light the scene lets be shaded at a lower resolution, see Renderer::set_light_resolution_scale
+
+		PointLight() : position(glm::vec3(0.0f)), color(glm::vec3(0.0f)), velocity(0.0f), Kc(0.0f), Kl(0.0f), Kq(0.0f), cutoff(0.0f), low_resolution(false) {}
+
+		static const float default_cutoff_threshold; // 1 / 256, the light's contribution past its cutoff would not change an 8 bit color
 
-		static float calc_bounding_sphere_scale(float Kc, float Kl, float Kq, const glm::vec3& color);
+		// distance at which the light's brightest channel falls under threshold
+		static float calc_bounding_sphere_scale(float Kc, float Kl, float Kq, const glm::vec3& color, float threshold = default_cutoff_threshold);
 	};
 
 	class Scene {
@@ -93,6 +111,9 @@ namespace bey
 		DirectionalLight sunlight;
 		std::vector<SpotLight> spotlights;
 		std::vector<PointLight> pointlights;		
+		float light_cutoff_threshold;
+		unsigned int light_revision;
+		unsigned int model_revision;
 
 	public:
 		Scene();
@@ -102,14 +123,24 @@ namespace bey
 		Camera camera;
 
 		const StaticModel* get_static_models() const;
+		// the mutable accessor counts as a move of the dynamic models, see get_model_revision. only the dynamic ones may be moved
+		StaticModel* get_mutable_static_models();
 		size_t num_static_models() const;
+		// goes up every time the dynamic models may have moved, the renderer then refreshes their transforms and bounds
+		unsigned int get_model_revision() const;
 		const DirectionalLight& get_sunlight() const;
 		const PointLight* get_point_lights() const;
+		// the mutable accessors count as a change of the lights, see get_light_revision
 		PointLight* get_mutable_point_lights();
 		size_t num_point_lights() const;
 		const SpotLight* get_spot_lights() const;
 		SpotLight* get_mutable_spot_lights();
 		size_t num_spot_lights() const;
+		// goes up every time the lights may have changed, the renderer skips the lighting of frames where it did not
+		unsigned int get_light_revision() const;
+		// recomputes the cutoff of every point and spot light, a higher threshold gives smaller light volumes
+		void set_light_cutoff_threshold(float threshold);
+		float get_light_cutoff_threshold() const;
 
 		BoundingBox bounding_box;
 	};
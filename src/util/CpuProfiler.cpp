@@ -0,0 +1,172 @@
+#include "util/CpuProfiler.hpp"
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+using namespace bey;
+
+namespace
+{
+	struct Event
+	{
+		const char* name;
+		unsigned long long begin;
+		unsigned long long end;
+	};
+
+	// only its own thread writes to it. it is never freed, so a thread's zones can still be written once it is gone
+	struct ThreadBuffer
+	{
+		std::vector<Event> events; // allocated on the thread's first zone
+		unsigned long long num_events; // ever recorded, the ring keeps the last RING_SIZE
+		std::string name;
+		int id;
+	};
+}
+
+static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+static std::atomic<bool> recording(false);
+static std::mutex buffers_mutex;
+static std::vector<ThreadBuffer*> buffers;
+static thread_local ThreadBuffer* thread_buffer = nullptr;
+
+static ThreadBuffer* get_thread_buffer()
+{
+	if (thread_buffer == nullptr)
+	{
+		std::lock_guard<std::mutex> lock(buffers_mutex);
+		thread_buffer = new ThreadBuffer();
+		thread_buffer->num_events = 0;
+		thread_buffer->id = (int)buffers.size() + 1;
+		buffers.push_back(thread_buffer);
+	}
+	return thread_buffer;
+}
+
+//the names are string literals, but nothing stops a quote or a backslash in one
+static void write_string(std::ostream& out, const char* s)
+{
+	out << '"';
+	for (; *s != '\0'; s++)
+	{
+		if (*s == '"' || *s == '\\')
+		{
+			out << '\\' << *s;
+		}
+		else if ((unsigned char)*s >= 0x20)
+		{
+			out << *s;
+		}
+	}
+	out << '"';
+}
+
+void CpuProfiler::start()
+{
+	std::lock_guard<std::mutex> lock(buffers_mutex);
+	for (size_t i = 0; i < buffers.size(); i++)
+	{
+		buffers[i]->num_events = 0;
+	}
+	recording = true;
+}
+
+void CpuProfiler::stop()
+{
+	recording = false;
+}
+
+bool CpuProfiler::is_recording()
+{
+	return recording.load(std::memory_order_relaxed);
+}
+
+void CpuProfiler::set_thread_name(const char* name)
+{
+	get_thread_buffer()->name = name;
+}
+
+unsigned long long CpuProfiler::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void CpuProfiler::record(const char* name, unsigned long long begin, unsigned long long end)
+{
+	ThreadBuffer* buffer = get_thread_buffer();
+	if (buffer->events.empty())
+	{
+		buffer->events.resize(RING_SIZE);
+	}
+	Event& event = buffer->events[buffer->num_events % RING_SIZE];
+	event.name = name;
+	event.begin = begin;
+	event.end = end;
+	buffer->num_events++;
+}
+
+bool CpuProfiler::write_trace(const std::string& filename)
+{
+	std::ofstream file(filename.c_str());
+	if (!file.is_open())
+	{
+		std::cerr << "cpu profiler : can not write " << filename << std::endl;
+		return false;
+	}
+
+	//complete events, in microseconds. the viewers sort them, and nest the ones of a thread by their times
+	std::lock_guard<std::mutex> lock(buffers_mutex);
+	file << std::fixed << std::setprecision(3);
+	file << "{ \"displayTimeUnit\" : \"ms\", \"traceEvents\" : [" << std::endl;
+	bool first = true;
+	for (size_t i = 0; i < buffers.size(); i++)
+	{
+		const ThreadBuffer& buffer = *buffers[i];
+		if (!buffer.name.empty())
+		{
+			file << (first ? "" : ",\n") << "  { \"name\" : \"thread_name\", \"ph\" : \"M\", \"pid\" : 1, \"tid\" : " << buffer.id << ", \"args\" : { \"name\" : ";
+			write_string(file, buffer.name.c_str());
+			file << " } }";
+			first = false;
+		}
+
+		unsigned long long begin = buffer.num_events > RING_SIZE ? buffer.num_events - RING_SIZE : 0;
+		for (unsigned long long j = begin; j < buffer.num_events; j++)
+		{
+			const Event& event = buffer.events[j % RING_SIZE];
+			file << (first ? "" : ",\n") << "  { \"name\" : ";
+			write_string(file, event.name);
+			file << ", \"cat\" : \"cpu\", \"ph\" : \"X\", \"ts\" : " << event.begin / 1000.0 << ", \"dur\" : " << (event.end - event.begin) / 1000.0
+				<< ", \"pid\" : 1, \"tid\" : " << buffer.id << " }";
+			first = false;
+		}
+	}
+	file << std::endl << "] }" << std::endl;
+	return true;
+}
+
+CpuProfileZone::CpuProfileZone(const char* name) : name(name), begin(0), open(CpuProfiler::is_recording())
+{
+	if (open)
+	{
+		begin = CpuProfiler::now();
+	}
+}
+
+CpuProfileZone::~CpuProfileZone()
+{
+	end();
+}
+
+void CpuProfileZone::end()
+{
+	if (open)
+	{
+		CpuProfiler::record(name, begin, CpuProfiler::now());
+		open = false;
+	}
+}
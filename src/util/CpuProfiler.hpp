@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+
+// scoped cpu zones. BEY_PROFILE_ZONE("name") times the rest of the enclosing scope, BEY_PROFILE_ZONE_NAMED / BEY_PROFILE_ZONE_END
+// time a part of it. names must outlive the trace, string literals are. without BEY_CPU_PROFILER the macros compile to nothing
+#ifdef BEY_CPU_PROFILER
+#define BEY_PROFILE_CONCAT_INNER(a, b) a##b
+#define BEY_PROFILE_CONCAT(a, b) BEY_PROFILE_CONCAT_INNER(a, b)
+#define BEY_PROFILE_ZONE(name) bey::CpuProfileZone BEY_PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+#define BEY_PROFILE_ZONE_NAMED(zone, name) bey::CpuProfileZone zone(name)
+#define BEY_PROFILE_ZONE_END(zone) zone.end()
+#define BEY_PROFILE_THREAD_NAME(name) bey::CpuProfiler::set_thread_name(name)
+#else
+#define BEY_PROFILE_ZONE(name)
+#define BEY_PROFILE_ZONE_NAMED(zone, name)
+#define BEY_PROFILE_ZONE_END(zone)
+#define BEY_PROFILE_THREAD_NAME(name)
+#endif
+
+namespace bey
+{
+	// records the zones of every thread into a ring buffer of that thread, and writes them as a chrome trace, which
+	// chrome://tracing and ui.perfetto.dev open. zones are only recorded between start and stop, otherwise a zone costs a branch
+	class CpuProfiler
+	{
+	public:
+		static const unsigned int RING_SIZE = 1 << 16; // zones kept per thread, the oldest are overwritten
+
+		static void start();
+		static void stop();
+		static bool is_recording();
+
+		// the zones of every thread that are still in their ring. the other threads should not be recording meanwhile
+		static bool write_trace(const std::string& filename);
+
+		static void set_thread_name(const char* name);
+		static unsigned long long now(); // nanoseconds since the program started
+		static void record(const char* name, unsigned long long begin, unsigned long long end);
+	};
+
+	class CpuProfileZone
+	{
+	public:
+		explicit CpuProfileZone(const char* name);
+		~CpuProfileZone();
+		// ends the zone before the end of its scope
+		void end();
+
+	private:
+		const char* name;
+		unsigned long long begin;
+		bool open;
+	};
+}